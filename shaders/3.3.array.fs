@@ -0,0 +1,29 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+flat in uint Material;
+
+// where the two images of each material sit in the texture array: rect xy scales and zw offsets the
+// texture coordinate within the layer, layers.x and layers.y are the base and overlay layer
+struct MaterialRegions
+{
+    vec4 baseRect;
+    vec4 overlayRect;
+    vec4 layers;
+};
+
+layout (std140) uniform MaterialData
+{
+    MaterialRegions materials[256];
+};
+
+uniform sampler2DArray textures;
+
+void main()
+{
+    MaterialRegions m = materials[Material];
+    vec4 base = texture(textures, vec3(TexCoord * m.baseRect.xy + m.baseRect.zw, m.layers.x));
+    vec4 overlay = texture(textures, vec3(TexCoord * m.overlayRect.xy + m.overlayRect.zw, m.layers.y));
+    FragColor = mix(base, overlay, 0.2);
+}
\ No newline at end of file
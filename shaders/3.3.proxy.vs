@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;     // unit cube corner, 0 or 1 per axis
+
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+};
+
+// the world space bounding box this draw stands in for
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+
+void main()
+{
+    gl_Position = viewProjection * vec4(mix(boxMin, boxMax, aPos), 1.0f);
+}
\ No newline at end of file
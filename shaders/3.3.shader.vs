@@ -1,15 +1,30 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+layout (location = 0) in vec4 aPos;         // quantized relative to the mesh bounds in packed vertex layouts
 layout (location = 1) in vec2 aTexCoord;
+layout (location = 6) in uint aMaterial;     // per-object material index, used by 3.3.array.fs
 
 out vec2 TexCoord;
+flat out uint Material;
+
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+};
+
+// dequantization of aPos, the same for every object drawn with the mesh (identity for float positions)
+layout (std140) uniform MeshData
+{
+    vec4 positionScale;
+    vec4 positionOffset;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    gl_Position = viewProjection * model * vec4(aPos.xyz * positionScale.xyz + positionOffset.xyz, 1.0f);
     TexCoord = vec2(aTexCoord.x, 1.0 - aTexCoord.y);
+    Material = aMaterial;
 }
\ No newline at end of file
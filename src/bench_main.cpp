@@ -0,0 +1,295 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "headless_context.h"
+#include "renderer.h"
+#include "bench_suite.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Benchmark suite front end on the headless renderer: runs the scenarios of benchScenarios() as repeated trials,
+// each in a fresh process so no scenario inherits the memory, caches or driver state of another, writes frame time
+// percentiles, draw calls and memory per scenario as JSON and optionally checks them against a stored baseline.
+// Exits with 1 if a metric regressed beyond its threshold and 2 if a trial failed or the arguments are wrong.
+
+// one trial, in the process started for it: warm-up frames, then the measured ones, printed as a "trial: " line
+int runTrial(const BenchScenario& scenario, unsigned int warmup, unsigned int frames, int width, int height, unsigned int jobThreads)
+{
+    HeadlessContext context;
+    if (!context.create(width, height))
+    {
+        context.destroy();
+        return 2;
+    }
+    RenderSettings settings = scenario.settings;
+    settings.jobThreads = jobThreads;
+    BenchTrial trial;
+    trial.renderer = context.renderer();
+
+    CubeRenderer renderer;
+    auto initStart = std::chrono::steady_clock::now();
+    renderer.init(settings);
+    trial.initMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - initStart).count();
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
+    RenderQueue::Totals before = renderer.renderQueue().totals();
+    LodStats lodBefore = renderer.lodStats();
+    // the camera goes along the whole path during the warm-up and again while measuring
+    for (unsigned int frame = 0; frame < warmup + frames; frame++)
+    {
+        bool measured = frame >= warmup;
+        unsigned int step = measured ? frame - warmup : frame, steps = measured ? frames : warmup;
+        float t = steps > 1 ? (float)step / (float)(steps - 1) : 0.0f;
+        if (frame == warmup)
+        {
+            before = renderer.renderQueue().totals();
+            lodBefore = renderer.lodStats();
+        }
+        auto frameStart = std::chrono::steady_clock::now();
+        glBindFramebuffer(GL_FRAMEBUFFER, context.framebuffer);
+        renderer.render(projection, cameraPathView(scenario.camera, t));
+        glFinish();
+        if (measured)
+            trial.frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+    }
+    RenderQueue::Totals after = renderer.renderQueue().totals();
+    double measuredFrames = (double)std::max(1ull, after.frames - before.frames);
+    trial.drawCalls = (double)(after.drawCalls - before.drawCalls) / measuredFrames;
+    trial.stateChanges = (double)(after.stateChanges - before.stateChanges) / measuredFrames;
+    trial.triangles = (double)(renderer.lodStats().trianglesDrawn - lodBefore.trianglesDrawn) / measuredFrames;
+
+    struct rusage usage;
+    trial.peakRssMB = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss / 1024.0 : 0.0;
+
+    renderer.destroy();
+    context.destroy();
+    std::cout << "trial: ";
+    trial.write(std::cout);
+    std::cout << std::endl;
+    return 0;
+}
+
+// run one trial in a child process (this executable with --trial) and read back its line
+bool spawnTrial(const std::string& self, const std::string& arguments, BenchTrial& trial)
+{
+    std::string command = "'" + self + "' " + arguments;
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe)
+        return false;
+    std::string output;
+    char buffer[4096];
+    while (std::fgets(buffer, sizeof(buffer), pipe))
+        output += buffer;
+    int status = pclose(pipe);
+    bool found = false;
+    std::istringstream lines(output);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        if (line.compare(0, 7, "trial: ") == 0)
+            found = trial.read(line.substr(7));
+    }
+    if (!found || status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        std::cout << output;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<BenchScenario> scenarios = benchScenarios();
+    std::vector<std::string> selected;
+    unsigned int trials = 3, warmup = 10, frames = 0, jobThreads = 0;
+    int width = 800, height = 600;
+    std::string outputPath = "viewer_bench.json", baselinePath, trialScenario;
+    std::vector<BenchThreshold> thresholds = defaultBenchThresholds();
+    double minDeltaMs = 0.5;
+
+    // command line options
+    // --------------------
+    bool usage = false;
+    for (int i = 1; i < argc && !usage; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--scenarios" && i + 1 < argc)
+        {
+            std::istringstream names(argv[++i]);
+            std::string name;
+            while (std::getline(names, name, ','))
+                selected.push_back(name);
+        }
+        else if (arg == "--trials" && i + 1 < argc)
+            trials = std::max(1u, static_cast<unsigned int>(std::strtoul(argv[++i], NULL, 10)));
+        else if (arg == "--warmup" && i + 1 < argc)
+            warmup = static_cast<unsigned int>(std::strtoul(argv[++i], NULL, 10));
+        else if (arg == "--frames" && i + 1 < argc)
+            frames = static_cast<unsigned int>(std::strtoul(argv[++i], NULL, 10));
+        else if (arg == "--size" && i + 1 < argc && std::sscanf(argv[++i], "%dx%d", &width, &height) == 2 && width > 0 && height > 0)
+            continue;
+        else if (arg == "--jobs" && i + 1 < argc)
+            jobThreads = static_cast<unsigned int>(std::strtoul(argv[++i], NULL, 10));
+        else if (arg == "--output" && i + 1 < argc)
+            outputPath = argv[++i];
+        else if (arg == "--baseline" && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (arg == "--min-delta-ms" && i + 1 < argc)
+            minDeltaMs = std::strtod(argv[++i], NULL);
+        else if (arg == "--threshold" && i + 1 < argc)
+        {
+            // METRIC=PERCENT replaces the metric's threshold or adds one
+            std::string value = argv[++i];
+            size_t equals = value.find('=');
+            double unused;
+            std::string metric = value.substr(0, equals);
+            if (equals == std::string::npos || !BenchResult().metric(metric, unused))
+            {
+                usage = true;
+                continue;
+            }
+            double percent = std::strtod(value.c_str() + equals + 1, NULL);
+            bool replaced = false;
+            for (BenchThreshold& threshold : thresholds)
+            {
+                if (threshold.metric == metric)
+                {
+                    threshold.percent = percent;
+                    replaced = true;
+                }
+            }
+            if (!replaced)
+                thresholds.push_back(BenchThreshold{ metric, percent });
+        }
+        else if (arg == "--trial" && i + 1 < argc)
+            trialScenario = argv[++i];
+        else if (arg == "--list")
+        {
+            for (const BenchScenario& scenario : scenarios)
+                std::cout << scenario.name << ": " << scenario.description << ", " << scenario.frames << " frames" << std::endl;
+            return 0;
+        }
+        else
+            usage = true;
+    }
+    if (usage)
+    {
+        std::cout << "Usage: " << argv[0] << " [--scenarios a,b,...] [--trials N] [--warmup N] [--frames N] [--size WxH] [--jobs N]"
+                  << " [--output results.json] [--baseline baseline.json] [--threshold p50|p90|p95|p99|drawCalls|stateChanges|memory=PERCENT]"
+                  << " [--min-delta-ms MS] [--list]" << std::endl;
+        return 2;
+    }
+
+    auto find = [&scenarios](const std::string& name) -> const BenchScenario*
+    {
+        for (const BenchScenario& scenario : scenarios)
+        {
+            if (scenario.name == name)
+                return &scenario;
+        }
+        return nullptr;
+    };
+    if (!trialScenario.empty())
+    {
+        const BenchScenario* scenario = find(trialScenario);
+        return scenario ? runTrial(*scenario, warmup, frames ? frames : scenario->frames, width, height, jobThreads) : 2;
+    }
+
+    std::vector<const BenchScenario*> runs;
+    if (selected.empty())
+    {
+        for (const BenchScenario& scenario : scenarios)
+            runs.push_back(&scenario);
+    }
+    for (const std::string& name : selected)
+    {
+        if (!find(name))
+        {
+            std::cout << "Unknown scenario " << name << " (--list shows them)" << std::endl;
+            return 2;
+        }
+        runs.push_back(find(name));
+    }
+
+    // read the baseline first, so a bad path fails before minutes of measuring
+    BenchReport baseline;
+    std::string error;
+    if (!baselinePath.empty() && !baseline.read(baselinePath, error))
+    {
+        std::cout << error << std::endl;
+        return 2;
+    }
+
+    char path[4096];
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    std::string self = length > 0 ? std::string(path, (size_t)length) : std::string(argv[0]);
+
+    BenchReport report;
+    report.width = width;
+    report.height = height;
+    report.trials = trials;
+    report.warmupFrames = warmup;
+    report.jobThreads = jobThreads;
+    std::cout << std::left << std::setw(14) << "scenario" << std::right << std::setw(8) << "frames" << std::setw(10) << "p50 ms"
+              << std::setw(10) << "p95 ms" << std::setw(10) << "p99 ms" << std::setw(12) << "draw calls" << std::setw(14) << "state changes"
+              << std::setw(12) << "peak MB" << std::endl;
+    // trials go round the scenarios instead of running back to back, so a stretch where the machine is slower
+    // (other load, clock changes) is spread over all scenarios instead of shifting one of them
+    std::vector<std::vector<BenchTrial>> results(runs.size(), std::vector<BenchTrial>(trials));
+    for (unsigned int t = 0; t < trials; t++)
+    {
+        for (size_t r = 0; r < runs.size(); r++)
+        {
+            const BenchScenario* scenario = runs[r];
+            std::ostringstream arguments;
+            arguments << "--trial " << scenario->name << " --warmup " << warmup << " --frames " << (frames ? frames : scenario->frames)
+                      << " --size " << width << "x" << height << " --jobs " << jobThreads;
+            if (!spawnTrial(self, arguments.str(), results[r][t]))
+            {
+                std::cout << scenario->name << ": trial " << t + 1 << " failed" << std::endl;
+                return 2;
+            }
+        }
+    }
+    for (size_t r = 0; r < runs.size(); r++)
+    {
+        report.renderer = results[r][0].renderer;
+        BenchResult result = BenchResult::combine(*runs[r], results[r]);
+        std::cout << std::left << std::setw(14) << result.name << std::right << std::setw(8) << result.frames << std::fixed
+                  << std::setprecision(3) << std::setw(10) << result.p50Ms << std::setw(10) << result.p95Ms << std::setw(10)
+                  << result.p99Ms << std::setprecision(1) << std::setw(12) << result.drawCalls << std::setw(14) << result.stateChanges
+                  << std::setw(12) << result.peakRssMB << std::defaultfloat << std::setprecision(6) << std::endl;
+        report.results.push_back(result);
+    }
+    std::cout << "renderer: " << report.renderer << ", " << width << "x" << height << ", " << trials << " trials of "
+              << warmup << " warm-up frames and the measured ones" << std::endl;
+
+    std::ofstream output(outputPath);
+    report.write(output);
+    if (!output)
+    {
+        std::cout << "Failed to write " << outputPath << std::endl;
+        return 2;
+    }
+    std::cout << "wrote " << outputPath << std::endl;
+
+    if (baselinePath.empty())
+        return 0;
+    unsigned int regressions = compareToBaseline(report, baseline, thresholds, minDeltaMs, std::cout);
+    std::cout << regressions << " regression" << (regressions == 1 ? "" : "s") << " against " << baselinePath << std::endl;
+    return regressions > 0 ? 1 : 0;
+}
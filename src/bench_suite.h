@@ -0,0 +1,352 @@
+#ifndef BENCH_SUITE_H
+#define BENCH_SUITE_H
+
+#include "camera_path.h"
+#include "frame_stats.h"
+#include "json.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// One fixed benchmark: a generated scene, a camera path and how many frames a trial measures.
+// Everything that could make two runs differ is pinned: textures are decoded before the first frame, no cache
+// directory is read or written, and the camera position depends only on the frame number.
+struct BenchScenario
+{
+    std::string name;
+    std::string description;
+    RenderSettings settings;
+    CameraPath camera;
+    unsigned int frames;
+};
+
+inline std::vector<BenchScenario> benchScenarios()
+{
+    auto scene = [](DrawPath drawPath, unsigned int cubeCount)
+    {
+        RenderSettings settings;
+        settings.drawPath = drawPath;
+        settings.cubeCount = cubeCount;
+        settings.asyncTextures = false;
+        settings.textureCache.clear();
+        settings.shaderCache.clear();
+        settings.meshCache.clear();
+        return settings;
+    };
+    std::vector<BenchScenario> scenarios;
+    scenarios.push_back(BenchScenario{ "cubes-10", "10 cubes, legacy path, orbit", scene(DrawPath::Legacy, 10), CameraPath::Orbit, 120 });
+    scenarios.push_back(BenchScenario{ "cubes-1k", "1000 cubes, uniform buffer path, flythrough", scene(DrawPath::UniformBuffer, 1000),
+                                       CameraPath::Flythrough, 120 });
+    scenarios.push_back(BenchScenario{ "cubes-100k", "100000 cubes, instanced path, flythrough", scene(DrawPath::Instanced, 100000),
+                                       CameraPath::Flythrough, 60 });
+    scenarios.push_back(BenchScenario{ "cubes-1m", "1000000 cubes, instanced path, flythrough", scene(DrawPath::Instanced, 1000000),
+                                       CameraPath::Flythrough, 30 });
+
+    // every draw switches texture pairs: 9 materials in object order, unsorted
+    BenchScenario textures{ "textures", "10000 cubes, 9 materials unsorted, uniform buffer path, flythrough",
+                            scene(DrawPath::UniformBuffer, 10000), CameraPath::Flythrough, 120 };
+    textures.settings.materials = 9;
+    textures.settings.sortDraws = false;
+    scenarios.push_back(textures);
+
+    // full detail spheres through the texture array shaders: shading bound rather than submission bound
+    BenchScenario shaders{ "shaders", "1000 full detail spheres, texture arrays, instanced path, flythrough",
+                           scene(DrawPath::Instanced, 1000), CameraPath::Flythrough, 60 };
+    shaders.settings.mesh = MeshShape::Sphere;
+    shaders.settings.lodPixelError = 0.0f;
+    shaders.settings.textureArrays = true;
+    shaders.settings.materials = 9;
+    scenarios.push_back(shaders);
+    return scenarios;
+}
+
+// What one trial (one process) measured
+struct BenchTrial
+{
+    std::vector<double> frameMs;    // the measured frames, warm-up excluded
+    double drawCalls = 0.0;         // per measured frame
+    double stateChanges = 0.0;
+    double triangles = 0.0;
+    double initMs = 0.0;            // CubeRenderer::init
+    double peakRssMB = 0.0;
+    std::string renderer;
+
+    // one line of JSON
+    void write(std::ostream& out) const
+    {
+        out << std::setprecision(9) << "{\"renderer\": \"" << jsonEscape(renderer) << "\", \"initMs\": " << initMs
+            << ", \"drawCalls\": " << drawCalls << ", \"stateChanges\": " << stateChanges << ", \"triangles\": " << triangles
+            << ", \"peakRssMB\": " << peakRssMB << ", \"frameMs\": [";
+        for (size_t k = 0; k < frameMs.size(); k++)
+            out << (k ? ", " : "") << frameMs[k];
+        out << "]}";
+    }
+
+    bool read(const std::string& line)
+    {
+        JsonValue value;
+        if (!JsonValue::parse(line.data(), line.data() + line.size(), value) || value["frameMs"].size() == 0)
+            return false;
+        renderer = value["renderer"].string;
+        initMs = value["initMs"].asNumber();
+        drawCalls = value["drawCalls"].asNumber();
+        stateChanges = value["stateChanges"].asNumber();
+        triangles = value["triangles"].asNumber();
+        peakRssMB = value["peakRssMB"].asNumber();
+        frameMs.clear();
+        for (size_t k = 0; k < value["frameMs"].size(); k++)
+            frameMs.push_back(value["frameMs"][k].asNumber());
+        return true;
+    }
+};
+
+// A scenario's trials combined: frame time percentiles over every measured frame of every trial, the spread of the
+// trial medians, and the counters, which are the same in every trial
+struct BenchResult
+{
+    std::string name;
+    std::string description;
+    size_t frames = 0;
+    double meanMs = 0.0, minMs = 0.0, p50Ms = 0.0, p90Ms = 0.0, p95Ms = 0.0, p99Ms = 0.0, maxMs = 0.0;
+    std::vector<double> trialP50Ms;
+    double drawCalls = 0.0, stateChanges = 0.0, triangles = 0.0;
+    double initMs = 0.0;            // median over the trials
+    double peakRssMB = 0.0;         // largest over the trials
+
+    static BenchResult combine(const BenchScenario& scenario, const std::vector<BenchTrial>& trials)
+    {
+        BenchResult result;
+        result.name = scenario.name;
+        result.description = scenario.description;
+        FrameStats all;
+        std::vector<double> inits;
+        for (const BenchTrial& trial : trials)
+        {
+            FrameStats one;
+            for (double ms : trial.frameMs)
+            {
+                all.add(ms);
+                one.add(ms);
+            }
+            result.trialP50Ms.push_back(one.percentile(50));
+            inits.push_back(trial.initMs);
+            result.peakRssMB = std::max(result.peakRssMB, trial.peakRssMB);
+        }
+        if (!trials.empty())
+        {
+            result.drawCalls = trials[0].drawCalls;
+            result.stateChanges = trials[0].stateChanges;
+            result.triangles = trials[0].triangles;
+            std::sort(inits.begin(), inits.end());
+            result.initMs = inits[inits.size() / 2];
+        }
+        result.frames = all.count();
+        result.meanMs = all.mean();
+        result.minMs = all.min();
+        result.p50Ms = all.percentile(50);
+        result.p90Ms = all.percentile(90);
+        result.p95Ms = all.percentile(95);
+        result.p99Ms = all.percentile(99);
+        result.maxMs = all.max();
+        return result;
+    }
+
+    // the value a baseline threshold applies to; false for an unknown metric
+    bool metric(const std::string& name, double& value) const
+    {
+        if (name == "p50")
+            value = p50Ms;
+        else if (name == "p90")
+            value = p90Ms;
+        else if (name == "p95")
+            value = p95Ms;
+        else if (name == "p99")
+            value = p99Ms;
+        else if (name == "drawCalls")
+            value = drawCalls;
+        else if (name == "stateChanges")
+            value = stateChanges;
+        else if (name == "memory")
+            value = peakRssMB;
+        else
+            return false;
+        return true;
+    }
+
+    void write(std::ostream& out, const char* indent) const
+    {
+        out << indent << "{\n"
+            << indent << "  \"name\": \"" << jsonEscape(name) << "\",\n"
+            << indent << "  \"description\": \"" << jsonEscape(description) << "\",\n"
+            << indent << "  \"frames\": " << frames << ",\n"
+            << indent << "  \"frameMs\": { \"mean\": " << meanMs << ", \"min\": " << minMs << ", \"p50\": " << p50Ms
+            << ", \"p90\": " << p90Ms << ", \"p95\": " << p95Ms << ", \"p99\": " << p99Ms << ", \"max\": " << maxMs << " },\n"
+            << indent << "  \"trialP50Ms\": [";
+        for (size_t k = 0; k < trialP50Ms.size(); k++)
+            out << (k ? ", " : "") << trialP50Ms[k];
+        out << "],\n"
+            << indent << "  \"drawCalls\": " << drawCalls << ",\n"
+            << indent << "  \"stateChanges\": " << stateChanges << ",\n"
+            << indent << "  \"triangles\": " << triangles << ",\n"
+            << indent << "  \"initMs\": " << initMs << ",\n"
+            << indent << "  \"peakRssMB\": " << peakRssMB << "\n"
+            << indent << "}";
+    }
+
+    // the metrics of a scenario in a written report
+    static bool read(const JsonValue& scenario, BenchResult& result)
+    {
+        const JsonValue& frameMs = scenario["frameMs"];
+        if (scenario["name"].string.empty() || frameMs.isNull())
+            return false;
+        result.name = scenario["name"].string;
+        result.description = scenario["description"].string;
+        result.frames = (size_t)scenario["frames"].asInt(0);
+        result.meanMs = frameMs["mean"].asNumber();
+        result.minMs = frameMs["min"].asNumber();
+        result.p50Ms = frameMs["p50"].asNumber();
+        result.p90Ms = frameMs["p90"].asNumber();
+        result.p95Ms = frameMs["p95"].asNumber();
+        result.p99Ms = frameMs["p99"].asNumber();
+        result.maxMs = frameMs["max"].asNumber();
+        for (size_t k = 0; k < scenario["trialP50Ms"].size(); k++)
+            result.trialP50Ms.push_back(scenario["trialP50Ms"][k].asNumber());
+        result.drawCalls = scenario["drawCalls"].asNumber();
+        result.stateChanges = scenario["stateChanges"].asNumber();
+        result.triangles = scenario["triangles"].asNumber();
+        result.initMs = scenario["initMs"].asNumber();
+        result.peakRssMB = scenario["peakRssMB"].asNumber();
+        return true;
+    }
+};
+
+// The whole report: how it was measured and one result per scenario
+struct BenchReport
+{
+    std::string renderer;
+    int width = 0, height = 0;
+    unsigned int trials = 0, warmupFrames = 0, jobThreads = 0;
+    std::vector<BenchResult> results;
+
+    void write(std::ostream& out) const
+    {
+        // as many digits as the trial lines, so a report read back as a baseline compares equal to itself
+        out << std::setprecision(9) << "{\n"
+            << "  \"version\": 1,\n"
+            << "  \"renderer\": \"" << jsonEscape(renderer) << "\",\n"
+            << "  \"size\": [" << width << ", " << height << "],\n"
+            << "  \"trials\": " << trials << ",\n"
+            << "  \"warmupFrames\": " << warmupFrames << ",\n"
+            << "  \"jobThreads\": " << jobThreads << ",\n"
+            << "  \"scenarios\": [\n";
+        for (size_t k = 0; k < results.size(); k++)
+        {
+            results[k].write(out, "    ");
+            out << (k + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+    }
+
+    bool read(const std::string& path, std::string& error)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream text;
+        text << file.rdbuf();
+        std::string json = text.str();
+        JsonValue document;
+        if (!file || !JsonValue::parse(json.data(), json.data() + json.size(), document))
+        {
+            error = "cannot read " + path + " as JSON";
+            return false;
+        }
+        renderer = document["renderer"].string;
+        width = (int)document["size"][0].asInt(0);
+        height = (int)document["size"][1].asInt(0);
+        trials = (unsigned int)document["trials"].asInt(0);
+        warmupFrames = (unsigned int)document["warmupFrames"].asInt(0);
+        jobThreads = (unsigned int)document["jobThreads"].asInt(0);
+        const JsonValue& scenarios = document["scenarios"];
+        for (size_t k = 0; k < scenarios.size(); k++)
+        {
+            BenchResult result;
+            if (BenchResult::read(scenarios[k], result))
+                results.push_back(result);
+        }
+        return true;
+    }
+
+    const BenchResult* find(const std::string& name) const
+    {
+        for (const BenchResult& result : results)
+        {
+            if (result.name == name)
+                return &result;
+        }
+        return nullptr;
+    }
+};
+
+// How much worse than the baseline a metric may get before it counts as a regression
+struct BenchThreshold
+{
+    std::string metric;     // a BenchResult::metric name
+    double percent;
+};
+
+inline std::vector<BenchThreshold> defaultBenchThresholds()
+{
+    return { { "p50", 25.0 }, { "p95", 30.0 }, { "p99", 40.0 }, { "drawCalls", 0.0 }, { "memory", 10.0 } };
+}
+
+// Compare every scenario of the report that the baseline also has against the thresholds, print a line per
+// scenario and metric, and return the number of regressions. Frame times also have to grow by more than
+// minDeltaMs, so noise on very short frames does not fail the check.
+inline unsigned int compareToBaseline(const BenchReport& report, const BenchReport& baseline, const std::vector<BenchThreshold>& thresholds,
+                                      double minDeltaMs, std::ostream& out)
+{
+    if (baseline.renderer != report.renderer || baseline.width != report.width || baseline.height != report.height)
+        out << "warning: the baseline was measured on " << baseline.renderer << " at " << baseline.width << "x" << baseline.height
+            << ", this run on " << report.renderer << " at " << report.width << "x" << report.height << std::endl;
+    unsigned int regressions = 0;
+    out << std::left << std::setw(14) << "scenario" << std::setw(14) << "metric" << std::right << std::setw(14) << "baseline"
+        << std::setw(14) << "current" << std::setw(10) << "change" << std::setw(8) << "limit" << std::endl;
+    for (const BenchResult& result : report.results)
+    {
+        const BenchResult* before = baseline.find(result.name);
+        if (!before)
+        {
+            out << std::left << std::setw(14) << result.name << "not in the baseline" << std::endl;
+            continue;
+        }
+        // other frame counts put the camera elsewhere, so even the counters differ
+        if (before->frames * report.trials != result.frames * baseline.trials)
+            out << std::left << std::setw(14) << result.name << "measured " << result.frames / std::max(1u, report.trials)
+                << " frames per trial, the baseline " << before->frames / std::max(1u, baseline.trials) << std::endl;
+        for (const BenchThreshold& threshold : thresholds)
+        {
+            double was = 0.0, now = 0.0;
+            if (!before->metric(threshold.metric, was) || !result.metric(threshold.metric, now))
+                continue;
+            double change = was > 0.0 ? 100.0 * (now - was) / was : (now > 0.0 ? 100.0 : 0.0);
+            bool time = threshold.metric[0] == 'p';
+            // the baseline went through a report, which keeps 9 significant digits: a counter equal to it may still
+            // differ in the last ones, so a 0% limit needs a tolerance above that rounding (5e-7%)
+            bool regressed = change > threshold.percent + 1e-4 && (!time || now - was > minDeltaMs);
+            regressions += regressed ? 1 : 0;
+            out << std::left << std::setw(14) << result.name << std::setw(14) << threshold.metric << std::right << std::fixed
+                << std::setprecision(3) << std::setw(14) << was << std::setw(14) << now << std::setprecision(1) << std::setw(9)
+                << change << "%" << std::setw(7) << threshold.percent << "%" << (regressed ? "  REGRESSION" : "")
+                << std::defaultfloat << std::setprecision(6) << std::endl;
+        }
+    }
+    return regressions;
+}
+#endif
@@ -0,0 +1,549 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "camera_path.h"
+#include "shader_s.h"
+#include "program_cache.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Per-call cost of uploading a mat4 uniform: glGetUniformLocation every call (the old Shader behaviour),
+// a lookup in the shader's uniform cache by name, and a pre-resolved UniformHandle
+inline void benchmarkUniforms(Shader& shader)
+{
+    const unsigned int iterations = 1000000;
+    const glm::mat4 matrix = glm::mat4(1.0f);
+    const std::string name = "model";
+    if (shader.getLocation(name) < 0)
+    {
+        std::cout << "the program has no \"" << name << "\" uniform, run the uniform benchmark on the legacy path" << std::endl;
+        return;
+    }
+    UniformHandle handle = shader.uniform(name);
+    shader.use();
+
+    auto measure = [&](const char* label, auto&& setUniform)
+    {
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < iterations; i++)
+            setUniform();
+        glFinish();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << label << ": " << elapsed * 1e9 / iterations << " ns/call" << std::endl;
+    };
+
+    measure("glGetUniformLocation per call", [&]() {
+        glUniformMatrix4fv(glGetUniformLocation(shader.ID, name.c_str()), 1, GL_FALSE, &matrix[0][0]);
+    });
+    measure("cached lookup by name", [&]() { shader.setMat4(name, matrix); });
+    measure("UniformHandle", [&]() { shader.setMat4(handle, matrix); });
+}
+
+// Startup cost of one program with the binary cache cold (compile, link and store) and warm (glProgramBinary).
+// Every cold iteration appends a unique comment to the sources, so neither our cache nor a driver-side shader
+// cache (Mesa keeps one in ~/.cache/mesa_shader_cache) can serve it.
+inline void benchmarkShaderStartup(const char* vertexPath, const char* fragmentPath, const std::string& cacheDirectory)
+{
+    const unsigned int iterations = 20;
+    ProgramBinaryCache cache(cacheDirectory);
+    if (!cache.enabled())
+    {
+        std::cout << "program binaries are not supported by this driver (or no cache directory), nothing to compare" << std::endl;
+        return;
+    }
+    std::string vertexCode, fragmentCode;
+    if (!Shader::readSource(vertexPath, vertexCode) || !Shader::readSource(fragmentPath, fragmentCode))
+        return;
+
+    auto median = [](std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    };
+    auto elapsedMs = [](std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::vector<double> cold, warm;
+    unsigned long long salt = (unsigned long long)std::chrono::steady_clock::now().time_since_epoch().count();
+    for (unsigned int i = 0; i < iterations; i++)
+    {
+        std::string unique = "\n// cold run " + std::to_string(salt) + "." + std::to_string(i) + "\n";
+        std::string vertex = vertexCode + unique, fragment = fragmentCode + unique;
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        GLuint program = cache.load(vertex, fragment);   // misses, but pays for the lookup like a real cold start
+        if (!program)
+        {
+            Shader::PendingProgram pending = Shader::beginProgram(vertex, fragment, true);
+            Shader::finishProgram(pending);
+            cache.store(vertex, fragment, pending.program);
+            program = pending.program;
+        }
+        glFinish();
+        cold.push_back(elapsedMs(start));
+        glDeleteProgram(program);
+        std::remove(cache.entryPath(vertex, fragment).c_str());
+    }
+
+    // make sure the warm entry exists
+    GLuint program = cache.load(vertexCode, fragmentCode);
+    if (!program)
+    {
+        Shader::PendingProgram pending = Shader::beginProgram(vertexCode, fragmentCode, true);
+        Shader::finishProgram(pending);
+        cache.store(vertexCode, fragmentCode, pending.program);
+        program = pending.program;
+    }
+    glDeleteProgram(program);
+    for (unsigned int i = 0; i < iterations; i++)
+    {
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        program = cache.load(vertexCode, fragmentCode);
+        glFinish();
+        warm.push_back(elapsedMs(start));
+        glDeleteProgram(program);
+    }
+
+    std::cout << vertexPath << " + " << fragmentPath << " (median of " << iterations << "):" << std::endl;
+    std::cout << "  cold cache (compile + link + store): " << median(cold) << " ms" << std::endl;
+    std::cout << "  warm cache (glProgramBinary): " << median(warm) << " ms" << std::endl;
+}
+
+// Per-frame cost of each draw path as the cube count grows: the CPU time render() takes to issue its GL calls
+// (mostly driver overhead) and the time until glFinish returns. Culling is off so every cube is drawn.
+inline void benchmarkDrawPaths(RenderSettings settings, GLuint framebuffer, float aspect)
+{
+    const unsigned int counts[] = { 100, 1000, 10000, 100000 };
+    const DrawPath paths[] = { DrawPath::Legacy, DrawPath::UniformBuffer, DrawPath::Instanced };
+    const unsigned int frames = 10;
+    settings.culling = false;
+    settings.asyncTextures = false;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    auto median = [](std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    };
+
+    std::cout << "median of " << frames << " frames (ms)" << std::endl;
+    std::cout << std::left << std::setw(10) << "cubes" << std::setw(16) << "path" << std::right
+              << std::setw(12) << "submit" << std::setw(12) << "frame" << std::setw(16) << "submit/cube us" << std::endl;
+    for (unsigned int count : counts)
+    {
+        for (DrawPath path : paths)
+        {
+            settings.cubeCount = count;
+            settings.drawPath = path;
+            CubeRenderer renderer;
+            renderer.init(settings);
+            std::vector<double> submit, frame;
+            for (unsigned int i = 0; i < frames + 2; i++)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+                auto start = std::chrono::steady_clock::now();
+                renderer.render(projection, view);
+                auto submitted = std::chrono::steady_clock::now();
+                glFinish();
+                auto finished = std::chrono::steady_clock::now();
+                // the first two frames warm up the driver and the caches
+                if (i < 2)
+                    continue;
+                submit.push_back(std::chrono::duration<double, std::milli>(submitted - start).count());
+                frame.push_back(std::chrono::duration<double, std::milli>(finished - start).count());
+            }
+            double submitMs = median(submit);
+            std::cout << std::left << std::setw(10) << count << std::setw(16) << drawPathName(path) << std::right << std::fixed
+                      << std::setprecision(3) << std::setw(12) << submitMs << std::setw(12) << median(frame)
+                      << std::setw(16) << submitMs * 1000.0 / count
+                      << std::defaultfloat << std::setprecision(6) << std::endl;
+            renderer.destroy();
+        }
+    }
+}
+
+// Per-frame CPU time of the work the job system spreads over the cores (frustum and occlusion culling, LOD selection,
+// packet building and the stream buffer gathers) from one thread up to one per hardware thread. The instanced path
+// issues a handful of GL calls per frame, so the time render() takes is almost all that work; the GPU finishes each
+// frame before the next starts. Every thread count renders the same flythrough frames.
+inline void benchmarkJobScaling(RenderSettings settings, GLuint framebuffer, float aspect)
+{
+    const unsigned int counts[] = { 10000, 100000, 1000000 };
+    const unsigned int frames = 10;
+    settings.drawPath = DrawPath::Instanced;
+    settings.asyncTextures = false;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
+
+    std::vector<unsigned int> threadCounts;
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int threads = 1; threads < cores; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(cores);
+
+    auto median = [](std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    };
+
+    std::cout << "median of " << frames << " frames, " << cores << " hardware threads" << std::endl;
+    std::cout << std::left << std::setw(10) << "cubes" << std::setw(10) << "threads" << std::right
+              << std::setw(12) << "submit ms" << std::setw(10) << "speedup" << std::setw(12) << "efficiency"
+              << std::setw(14) << "steals/frame" << std::endl;
+    for (unsigned int count : counts)
+    {
+        double single = 0.0;
+        for (unsigned int threads : threadCounts)
+        {
+            settings.cubeCount = count;
+            settings.jobThreads = threads;
+            CubeRenderer renderer;
+            renderer.init(settings);
+            std::vector<double> submit;
+            unsigned long long stolenBefore = 0;
+            for (unsigned int i = 0; i < frames + 2; i++)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+                glm::mat4 view = cameraPathView(CameraPath::Flythrough, (float)i / (float)(frames + 1));
+                auto start = std::chrono::steady_clock::now();
+                renderer.render(projection, view);
+                auto submitted = std::chrono::steady_clock::now();
+                glFinish();
+                // the first two frames warm up the driver, the caches and the workers
+                if (i < 2)
+                {
+                    stolenBefore = renderer.jobSystem().jobStats().stolen;
+                    continue;
+                }
+                submit.push_back(std::chrono::duration<double, std::milli>(submitted - start).count());
+            }
+            double submitMs = median(submit);
+            if (threads == 1)
+                single = submitMs;
+            double speedup = submitMs > 0.0 ? single / submitMs : 0.0;
+            std::cout << std::left << std::setw(10) << count << std::setw(10) << threads << std::right << std::fixed
+                      << std::setprecision(3) << std::setw(12) << submitMs << std::setprecision(2) << std::setw(10) << speedup
+                      << std::setw(11) << 100.0 * speedup / threads << "%" << std::setprecision(1) << std::setw(14)
+                      << (double)(renderer.jobSystem().jobStats().stolen - stolenBefore) / frames
+                      << std::defaultfloat << std::setprecision(6) << std::endl;
+            renderer.destroy();
+        }
+    }
+}
+
+// Cost of keeping the world matrices of a 1000000 node hierarchy current: a CAD-like tree of 100 assemblies below
+// one root, with parts nested about ten levels deep. update() with nothing changed, one part moved, one assembly (1% of
+// the nodes) moved, 1% of the parts scattered over the tree moved and the root moved, against recomputing every
+// world matrix from its TRS with glm::translate, glm::rotate and glm::scale each frame.
+inline void benchmarkTransforms()
+{
+    const uint32_t nodeCount = 1000000, assemblies = 100;
+    const unsigned int repeats = 9;
+    uint32_t seed = 12345;
+    auto random = [&seed](uint32_t range)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (uint32_t)(((uint64_t)(seed >> 8) * range) >> 24);
+    };
+    auto randomTransform = [&random]()
+    {
+        Transform t;
+        t.translation = glm::vec3((float)random(1000), (float)random(1000), (float)random(1000)) * 0.001f;
+        t.rotation = glm::angleAxis(glm::radians((float)random(360)), glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f)));
+        t.scale = glm::vec3(1.0f + 0.001f * (float)random(100));
+        return t;
+    };
+
+    // parents and locals by id, every parent before its children
+    std::vector<uint32_t> parents(nodeCount, TransformHierarchy::NoParent);
+    std::vector<Transform> locals(nodeCount);
+    std::vector<std::vector<uint32_t>> members(assemblies);
+    for (uint32_t id = 0; id < nodeCount; id++)
+    {
+        locals[id] = randomTransform();
+        if (id == 0)
+            continue;
+        if (id <= assemblies)
+        {
+            parents[id] = 0;
+            members[id - 1].push_back(id);
+            continue;
+        }
+        // below any part of a random assembly, which nests them about ln(parts) levels deep
+        std::vector<uint32_t>& assembly = members[random(assemblies)];
+        parents[id] = assembly[random((uint32_t)assembly.size())];
+        assembly.push_back(id);
+    }
+
+    auto median = [](std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    };
+    auto time = [&](const std::function<void()>& prepare, const std::function<size_t()>& run, size_t& matrices)
+    {
+        std::vector<double> ms;
+        for (unsigned int r = 0; r < repeats; r++)
+        {
+            prepare();
+            auto start = std::chrono::steady_clock::now();
+            matrices = run();
+            ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return median(ms);
+    };
+
+    TransformHierarchy transforms;
+    auto buildStart = std::chrono::steady_clock::now();
+    for (uint32_t id = 0; id < nodeCount; id++)
+        transforms.add(locals[id], parents[id]);
+    transforms.build();
+    double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+
+    std::vector<uint32_t> scattered;
+    for (uint32_t k = 0; k < nodeCount / 100; k++)
+        scattered.push_back(assemblies + 1 + random(nodeCount - assemblies - 1));
+    const std::function<size_t()> update = [&transforms]() { return transforms.update(); };
+
+    std::cout << "median of " << repeats << " updates, " << nodeCount << " nodes in " << assemblies << " assemblies, build "
+              << std::fixed << std::setprecision(1) << buildMs << " ms" << std::defaultfloat << std::endl;
+    std::cout << std::left << std::setw(34) << "moved" << std::right << std::setw(12) << "matrices" << std::setw(12) << "ms"
+              << std::endl;
+    auto row = [](const char* name, size_t matrices, double ms)
+    {
+        std::cout << std::left << std::setw(34) << name << std::right << std::setw(12) << matrices << std::fixed
+                  << std::setprecision(3) << std::setw(12) << ms << std::defaultfloat << std::setprecision(6) << std::endl;
+    };
+    size_t matrices = 0;
+    double ms = time([]() {}, update, matrices);
+    row("nothing", matrices, ms);
+    ms = time([&]() { transforms.setLocal(nodeCount - 1, randomTransform()); }, update, matrices);
+    row("one part", matrices, ms);
+    ms = time([&]() { transforms.setLocal(1 + random(assemblies), randomTransform()); }, update, matrices);
+    row("one assembly", matrices, ms);
+    ms = time([&]() { for (uint32_t id : scattered) transforms.setLocal(id, randomTransform()); }, update, matrices);
+    row("1% of the parts, scattered", matrices, ms);
+    ms = time([&]() { transforms.setLocal(0, randomTransform()); }, update, matrices);
+    row("root", matrices, ms);
+
+    // every matrix from scratch in id order, as if nothing were known about what changed
+    std::vector<glm::mat4> world(nodeCount);
+    ms = time([]() {}, [&]()
+    {
+        for (uint32_t id = 0; id < nodeCount; id++)
+        {
+            const Transform& t = locals[id];
+            glm::mat4 local = glm::translate(glm::mat4(1.0f), t.translation) * glm::mat4_cast(t.rotation) *
+                              glm::scale(glm::mat4(1.0f), t.scale);
+            world[id] = parents[id] == TransformHierarchy::NoParent ? local : world[parents[id]] * local;
+        }
+        return (size_t)nodeCount;
+    }, matrices);
+    row("everything, recomputed per frame", matrices, ms);
+}
+
+// Matrices per second for a batch of 4096 objects: glm::translate * glm::rotate * glm::scale per object (how the cube
+// matrices used to be built) against composeMatrices with each kernel the CPU runs, for model matrices and for MVP
+// matrices (view projection * model), written at the 64 byte stride of the instance data.
+inline void benchmarkMatrices()
+{
+    const size_t count = 4096;
+    const unsigned int trials = 7;
+    std::vector<glm::vec3> translations(count), scales(count), axes(count);
+    std::vector<float> angles(count);
+    std::vector<glm::quat> rotations(count);
+    for (size_t k = 0; k < count; k++)
+    {
+        translations[k] = glm::vec3((float)(k % 17), (float)(k % 13), -(float)(k % 11));
+        scales[k] = glm::vec3(1.0f + 0.01f * (float)(k % 7));
+        axes[k] = glm::normalize(glm::vec3(1.0f, 0.3f + 0.01f * (float)(k % 5), 0.5f));
+        angles[k] = glm::radians(20.0f * (float)k);
+        rotations[k] = glm::angleAxis(angles[k], axes[k]);
+    }
+    glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f) *
+                               glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    std::vector<glm::mat4> out(count);
+
+    // median over the trials of matrices per second, each trial repeating the batch for at least 20 ms
+    auto rate = [&](const std::function<void()>& batch)
+    {
+        std::vector<double> rates;
+        for (unsigned int t = 0; t < trials; t++)
+        {
+            size_t batches = 0;
+            auto start = std::chrono::steady_clock::now();
+            double seconds = 0.0;
+            do
+            {
+                batch();
+                batches++;
+                seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            } while (seconds < 0.02);
+            rates.push_back((double)(batches * count) / seconds);
+        }
+        std::sort(rates.begin(), rates.end());
+        return rates[rates.size() / 2];
+    };
+
+    std::cout << "median of " << trials << " trials, " << count << " objects per batch" << std::endl;
+    std::cout << std::left << std::setw(34) << "path" << std::right << std::setw(16) << "model M/s" << std::setw(16) << "MVP M/s"
+              << std::endl;
+    auto row = [](const std::string& name, double model, double mvp)
+    {
+        std::cout << std::left << std::setw(34) << name << std::right << std::fixed << std::setprecision(1) << std::setw(16)
+                  << model / 1e6 << std::setw(16) << mvp / 1e6 << std::defaultfloat << std::setprecision(6) << std::endl;
+    };
+    double glmModel = rate([&]()
+    {
+        for (size_t k = 0; k < count; k++)
+            out[k] = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), translations[k]), angles[k], axes[k]), scales[k]);
+    });
+    double glmMvp = rate([&]()
+    {
+        for (size_t k = 0; k < count; k++)
+        {
+            glm::mat4 model = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), translations[k]), angles[k], axes[k]), scales[k]);
+            out[k] = viewProjection * model;
+        }
+    });
+    row("glm::translate/rotate/scale", glmModel, glmMvp);
+    for (MatrixKernel kernel : { MatrixKernel::Scalar, MatrixKernel::SSE, MatrixKernel::AVX2 })
+    {
+        if (!matrixKernelSupported(kernel))
+            continue;
+        double model = rate([&]()
+        {
+            composeMatrices(count, translations.data(), rotations.data(), scales.data(), nullptr, out.data(), sizeof(glm::mat4),
+                            kernel);
+        });
+        double mvp = rate([&]()
+        {
+            composeMatrices(count, translations.data(), rotations.data(), scales.data(), &viewProjection, out.data(),
+                            sizeof(glm::mat4), kernel);
+        });
+        std::string name = std::string("composeMatrices, ") + matrixKernelName(kernel);
+        row(kernel == bestMatrixKernel() ? name + " (used)" : name, model, mvp);
+    }
+}
+// The --bench-* options both front ends accept. Like parseRenderSetting, parseBenchmarkOption consumes argv[i] if it
+// is one of them; runBenchmarks then runs the selected ones in the order they are listed here.
+struct BenchmarkSelection
+{
+    bool uniforms = false;
+    bool shaders = false;
+    bool drawPaths = false;
+    bool jobs = false;
+    bool transforms = false;
+    bool matrices = false;
+
+    bool any() const
+    {
+        return uniforms || shaders || drawPaths || jobs || transforms || matrices;
+    }
+};
+
+inline bool parseBenchmarkOption(const std::string& arg, BenchmarkSelection& selection)
+{
+    if (arg == "--bench-uniforms")
+        selection.uniforms = true;
+    else if (arg == "--bench-shaders")
+        selection.shaders = true;
+    else if (arg == "--bench-draw-paths")
+        selection.drawPaths = true;
+    else if (arg == "--bench-jobs")
+        selection.jobs = true;
+    else if (arg == "--bench-transforms")
+        selection.transforms = true;
+    else if (arg == "--bench-matrices")
+        selection.matrices = true;
+    else
+        return false;
+    return true;
+}
+
+inline const char* benchmarkUsage()
+{
+    return "[--bench-uniforms] [--bench-shaders] [--bench-draw-paths] [--bench-jobs] [--bench-transforms] [--bench-matrices]";
+}
+
+// framebuffer and aspect describe what the draw path and job benchmarks render into
+inline void runBenchmarks(const BenchmarkSelection& selection, CubeRenderer& renderer, const RenderSettings& settings,
+                          GLuint framebuffer, float aspect)
+{
+    if (selection.uniforms)
+        benchmarkUniforms(*renderer.shader);
+    if (selection.shaders)
+    {
+        std::string cacheDirectory = settings.shaderCache.empty() ? "shader_cache" : settings.shaderCache;
+        benchmarkShaderStartup("shaders/3.3.shader.vs", "shaders/3.3.shader.fs", cacheDirectory);
+        benchmarkShaderStartup("shaders/3.3.instanced.vs", "shaders/3.3.shader.fs", cacheDirectory);
+    }
+    if (selection.drawPaths)
+        benchmarkDrawPaths(settings, framebuffer, aspect);
+    if (selection.jobs)
+        benchmarkJobScaling(settings, framebuffer, aspect);
+    if (selection.transforms)
+        benchmarkTransforms();
+    if (selection.matrices)
+        benchmarkMatrices();
+}
+
+// what init() built and loaded: the mesh, its levels of detail or the glb scene, and the texture and shader caches
+inline void printStartupStats(const CubeRenderer& renderer, const RenderSettings& settings, std::ostream& out)
+{
+    renderer.meshStats().print(out);
+    if (renderer.glbScene())
+        renderer.glbScene()->glbStats().print(out);
+    else
+        renderer.lodChain().print(out);
+    if (renderer.arrayTextures())
+        renderer.arrayTextures()->printStats(out);
+    if (renderer.textures() && !settings.textureCache.empty())
+        out << "texture cache: " << renderer.textures()->cacheHitCount() << " hits, "
+            << renderer.textures()->cacheMissCount() << " misses" << std::endl;
+    if (const ProgramBinaryCache* binaries = renderer.shaders->binaryCache())
+        out << "shader cache: " << binaries->hitCount() << " hits, " << binaries->missCount() + binaries->rejectedCount()
+            << " misses" << (binaries->enabled() ? "" : " (program binaries not supported)") << std::endl;
+}
+
+// the counters of every stage of the frames rendered, printed on exit
+inline void printRenderStats(const CubeRenderer& renderer, std::ostream& out)
+{
+    if (const MeshImporter* import = renderer.meshImport())
+    {
+        // the mesh lines printed at startup described the empty streamed mesh
+        if (import->finished() && import->error().empty())
+            import->importStats().print(out);
+        renderer.meshStats().print(out);
+        renderer.lodChain().print(out);
+    }
+    renderer.cullScene().cullStats().print(out, renderer.cullScene().size());
+    renderer.transformHierarchy().transformStats().print(out, renderer.transformHierarchy().size());
+    if (renderer.occlusionStats())
+        renderer.occlusionStats()->print(out);
+    if (renderer.queryStats())
+        renderer.queryStats()->print(out);
+    renderer.shaders->printStats(out);
+    renderer.streamBuffer().printStats(out);
+    renderer.renderQueue().printStats(out);
+    renderer.lodStats().print(out);
+}
+#endif
@@ -0,0 +1,54 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <cmath>
+#include <string>
+
+// Deterministic camera motion for unattended runs, so every run renders exactly the same frames.
+enum class CameraPath
+{
+    Static,     // the viewer's start position, looking down -z
+    Orbit,      // one full circle around the origin
+    Flythrough  // straight down the -z axis through the cube field
+};
+
+inline bool parseCameraPath(const std::string& name, CameraPath& path)
+{
+    if (name == "static")
+        path = CameraPath::Static;
+    else if (name == "orbit")
+        path = CameraPath::Orbit;
+    else if (name == "flythrough")
+        path = CameraPath::Flythrough;
+    else
+        return false;
+    return true;
+}
+
+// view matrix at progress t in [0, 1] along the path
+inline glm::mat4 cameraPathView(CameraPath path, float t)
+{
+    const glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+    switch (path)
+    {
+    case CameraPath::Orbit:
+    {
+        float angle = t * glm::two_pi<float>();
+        glm::vec3 position = glm::vec3(std::sin(angle), 0.3f, std::cos(angle)) * 8.0f;
+        return glm::lookAt(position, glm::vec3(0.0f, 0.0f, -3.0f), up);
+    }
+    case CameraPath::Flythrough:
+    {
+        glm::vec3 position = glm::vec3(0.0f, 0.0f, 3.0f - t * 60.0f);
+        return glm::lookAt(position, position + glm::vec3(0.0f, 0.0f, -1.0f), up);
+    }
+    case CameraPath::Static:
+    default:
+        return glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 2.0f), up);
+    }
+}
+#endif
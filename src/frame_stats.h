@@ -0,0 +1,94 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+// Collects per-frame times (in seconds) and summarises them.
+class FrameStats
+{
+public:
+    std::vector<double> frameTimes;
+
+    void add(double seconds)
+    {
+        frameTimes.push_back(seconds);
+    }
+
+    size_t count() const
+    {
+        return frameTimes.size();
+    }
+
+    double total() const
+    {
+        double sum = 0.0;
+        for (double t : frameTimes)
+            sum += t;
+        return sum;
+    }
+
+    double mean() const
+    {
+        return frameTimes.empty() ? 0.0 : total() / frameTimes.size();
+    }
+
+    // nearest-rank percentile, p in [0, 100]
+    double percentile(double p) const
+    {
+        if (frameTimes.empty())
+            return 0.0;
+        std::vector<double> sorted = frameTimes;
+        std::sort(sorted.begin(), sorted.end());
+        size_t rank = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+
+    double min() const
+    {
+        return frameTimes.empty() ? 0.0 : *std::min_element(frameTimes.begin(), frameTimes.end());
+    }
+
+    double max() const
+    {
+        return frameTimes.empty() ? 0.0 : *std::max_element(frameTimes.begin(), frameTimes.end());
+    }
+};
+
+// Startup milestones: time from process start to the first finished frame and
+// to the first frame on which every texture was resident
+class StartupTimer
+{
+public:
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double firstFrameMs = -1.0;
+    double texturesResidentMs = -1.0;
+    double meshResidentMs = -1.0;
+
+    // call after each presented frame; prints each milestone once
+    void frameFinished(bool texturesResident, std::ostream& out, bool meshResident = true)
+    {
+        double now = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (firstFrameMs < 0.0)
+        {
+            firstFrameMs = now;
+            out << "time to first frame: " << firstFrameMs << " ms" << std::endl;
+        }
+        if (texturesResidentMs < 0.0 && texturesResident)
+        {
+            texturesResidentMs = now;
+            out << "all textures resident: " << texturesResidentMs << " ms" << std::endl;
+        }
+        if (meshResidentMs < 0.0 && meshResident)
+        {
+            meshResidentMs = now;
+            // the built in meshes are there from the first frame on
+            if (firstFrameMs < now)
+                out << "mesh complete: " << meshResidentMs << " ms" << std::endl;
+        }
+    }
+};
+#endif
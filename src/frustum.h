@@ -0,0 +1,101 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE 1
+#endif
+
+// The six planes of a view frustum as (normal, distance) with normals pointing inwards,
+// so dot(normal, p) + distance >= 0 for points on the inside.
+struct Frustum
+{
+    enum Plane { Left, Right, Bottom, Top, Near, Far };
+    static const uint32_t AllPlanes = 0x3f;
+
+    glm::vec4 planes[6];
+};
+
+// Gribb/Hartmann plane extraction from a (GL clip space, -w <= z <= w) projection * view matrix.
+// The planes are normalized so plane distances are world space distances.
+inline Frustum extractFrustum(const glm::mat4& viewProjection)
+{
+    // glm is column major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+    Frustum frustum;
+    frustum.planes[Frustum::Left] = rows[3] + rows[0];
+    frustum.planes[Frustum::Right] = rows[3] - rows[0];
+    frustum.planes[Frustum::Bottom] = rows[3] + rows[1];
+    frustum.planes[Frustum::Top] = rows[3] - rows[1];
+    frustum.planes[Frustum::Near] = rows[3] + rows[2];
+    frustum.planes[Frustum::Far] = rows[3] - rows[2];
+    for (glm::vec4& plane : frustum.planes)
+        plane /= glm::length(glm::vec3(plane));
+    return frustum;
+}
+
+// Box given as center and half extent against the planes in planeMask.
+// Returns false if the box is completely outside one plane; otherwise clears the bits of the planes
+// the box is completely inside of, so children of the box do not need to test them again.
+inline bool intersectBox(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extent, uint32_t& planeMask)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        if (!(planeMask & (1u << i)))
+            continue;
+        const glm::vec4& plane = frustum.planes[i];
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+        if (distance + radius < 0.0f)
+            return false;
+        if (distance - radius >= 0.0f)
+            planeMask &= ~(1u << i);
+    }
+    return true;
+}
+
+// Four spheres, given as separate x/y/z/radius arrays, against the planes in planeMask.
+// Returns a 4 bit mask with bit k set if sphere k is at least partially inside.
+inline uint32_t intersectSpheres4(const Frustum& frustum, const float* x, const float* y, const float* z,
+                                  const float* radius, uint32_t planeMask)
+{
+#ifdef FRUSTUM_SSE
+    __m128 cx = _mm_loadu_ps(x), cy = _mm_loadu_ps(y), cz = _mm_loadu_ps(z);
+    __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius));
+    __m128 outside = _mm_setzero_ps();
+    for (int i = 0; i < 6; i++)
+    {
+        if (!(planeMask & (1u << i)))
+            continue;
+        const glm::vec4& plane = frustum.planes[i];
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+                                     _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+    }
+    return ~(uint32_t)_mm_movemask_ps(outside) & 0xf;
+#else
+    uint32_t inside = 0;
+    for (int k = 0; k < 4; k++)
+    {
+        bool visible = true;
+        for (int i = 0; i < 6 && visible; i++)
+        {
+            if (!(planeMask & (1u << i)))
+                continue;
+            const glm::vec4& plane = frustum.planes[i];
+            visible = plane.x * x[k] + plane.y * y[k] + plane.z * z[k] + plane.w >= -radius[k];
+        }
+        inside |= visible ? 1u << k : 0u;
+    }
+    return inside;
+#endif
+}
+#endif
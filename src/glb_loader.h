@@ -0,0 +1,537 @@
+#ifndef GLB_LOADER_H
+#define GLB_LOADER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "json.h"
+#include "mapped_file.h"
+#include "transform_hierarchy.h"
+#include "vertex_layout.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// a glTF accessor resolved against the binary chunk: where its elements are and how GL reads them
+struct GlbAccessor
+{
+    int bufferView = -1;
+    size_t offset = 0;          // bytes into the binary chunk
+    size_t count = 0;
+    size_t stride = 0;          // bytes from one element to the next
+    GLenum componentType = 0;   // glTF component types are GL type enums
+    GLint components = 0;
+    GLboolean normalized = GL_FALSE;
+    glm::vec3 min = glm::vec3(0.0f), max = glm::vec3(0.0f);    // required for positions
+};
+
+// a triangle list of a glTF mesh and, once uploaded, the vertex array reading it
+struct GlbPrimitive
+{
+    GlbAccessor position, texCoord, indices;
+    bool hasTexCoord = false;
+    bool matchesLayout = false; // set up through the layout given to upload()
+    GLuint vertexArray = 0;
+    uint32_t firstIndex = 0;    // in the uploaded buffer, in units of the index type
+    size_t indexSize = 0;
+};
+
+// a node of the default scene, in depth-first order
+struct GlbNode
+{
+    uint32_t parent;            // index in nodes(), TransformHierarchy::NoParent for a root
+    Transform local;
+};
+
+// a primitive placed by a node
+struct GlbInstance
+{
+    uint32_t node;              // index in nodes()
+    uint32_t primitive;
+};
+
+// what loading a .glb did, printed at startup
+struct GlbStats
+{
+    size_t fileBytes = 0;
+    size_t uploadedBytes = 0;   // straight from the mapping
+    size_t nodes = 0;
+    size_t instances = 0;
+    size_t primitives = 0;
+    size_t layoutPrimitives = 0;    // set up through the vertex layout, the rest attribute by attribute
+    size_t skippedPrimitives = 0;   // not indexed triangles, or over the limit
+    double parseSeconds = 0.0;
+    double uploadSeconds = 0.0;
+    long peakRssGrowthKB = 0;   // high-water mark of the resident set, after the upload against before the load
+
+    void print(std::ostream& out) const
+    {
+        out << "glb: " << fileBytes / 1048576.0 << " MB, " << nodes << " nodes, " << instances << " instances of "
+            << primitives << " primitives (" << layoutPrimitives << " in the vertex layout), " << uploadedBytes / 1048576.0
+            << " MB uploaded from the mapping, parsed in " << parseSeconds * 1000.0 << " ms + uploaded in "
+            << uploadSeconds * 1000.0 << " ms, peak RSS +" << peakRssGrowthKB / 1024.0 << " MB";
+        if (skippedPrimitives)
+            out << ", " << skippedPrimitives << " primitives skipped";
+        out << std::endl;
+    }
+};
+
+// Binary glTF 2.0 (.glb) scenes, loaded without copying their geometry.
+// The file is memory mapped and its accessors and buffer views are resolved to offsets into the binary chunk.
+// upload() hands the range they span to GL straight from the mapping, as one buffer that serves as vertex and
+// element buffer of every primitive, dropping uploaded pages as it goes: no vertex or index ever passes through a
+// temporary container, so the resident set grows by about the file size. glTF component types are GL types, so
+// each primitive's vertex array points at its accessors as they are: through the vertex layout when they are
+// interleaved exactly like it, attribute by attribute otherwise.
+// The nodes of the default scene are kept as a hierarchy of local transforms for a TransformHierarchy, with one
+// instance per node and primitive.
+// Supported: indexed triangle primitives with POSITION and optionally TEXCOORD_0, node matrices and TRS.
+// Ignored: materials, animation, cameras. Rejected: external buffers and sparse accessors.
+class GlbScene
+{
+public:
+    // map and parse path, keeping at most maxPrimitives primitives; false with error() set
+    bool load(const std::string& path, size_t maxPrimitives)
+    {
+        auto start = std::chrono::steady_clock::now();
+        rssBefore = peakRssKB();
+        if (!file.open(path))
+            return fail("cannot open " + path);
+        stats.fileBytes = file.size();
+        const unsigned char* data = file.data();
+
+        // 12 byte header, then chunks of (length, type, data); JSON first, the binary chunk second
+        uint32_t header[3] = { 0, 0, 0 };
+        if (file.size() >= sizeof(header))
+            std::memcpy(header, data, sizeof(header));
+        if (header[0] != 0x46546C67u || header[1] != 2 || header[2] > file.size())
+            return fail("not a binary glTF 2.0 file");
+        const unsigned char* json = nullptr;
+        size_t jsonLength = 0;
+        for (size_t offset = 12; offset + 8 <= header[2]; )
+        {
+            uint32_t chunk[2];
+            std::memcpy(chunk, data + offset, sizeof(chunk));
+            if (offset + 8 + chunk[0] > header[2])
+                return fail("truncated chunk");
+            if (chunk[1] == 0x4E4F534Au && !json)
+            {
+                json = data + offset + 8;
+                jsonLength = chunk[0];
+            }
+            else if (chunk[1] == 0x004E4942u && !bin)
+            {
+                bin = data + offset + 8;
+                binLength = chunk[0];
+            }
+            offset += 8 + ((size_t)chunk[0] + 3) / 4 * 4;
+        }
+        JsonValue document;
+        if (!json || !JsonValue::parse(reinterpret_cast<const char*>(json), reinterpret_cast<const char*>(json) + jsonLength, document))
+            return fail("missing or malformed JSON chunk");
+
+        const JsonValue& buffers = document["buffers"];
+        for (size_t i = 0; i < buffers.size(); i++)
+        {
+            if (!buffers[i]["uri"].isNull())
+                return fail("external buffers are not supported");
+        }
+        if (!parseBufferViews(document["bufferViews"]) || !parsePrimitives(document, maxPrimitives))
+            return false;
+        parseNodes(document);
+        stats.parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+
+    // Create the GL buffer and one vertex array per primitive; primitives interleaved exactly like Layout (whose
+    // attributes are a position and a texture coordinate) use Layout::setAttributes(). Unmaps the file.
+    // Leaves no vertex array bound.
+    template <typename Layout>
+    void upload()
+    {
+        static_assert(Layout::count == 2, "the layout has to consist of a position and a texture coordinate");
+        auto start = std::chrono::steady_clock::now();
+        // the views the primitives read, from a 16 byte boundary so every offset keeps its alignment
+        size_t begin = binLength, end = 0;
+        for (const GlbPrimitive& primitive : primitiveList)
+        {
+            for (const GlbAccessor* accessor : { &primitive.position, &primitive.texCoord, &primitive.indices })
+            {
+                if (accessor->bufferView < 0)
+                    continue;
+                const View& view = views[accessor->bufferView];
+                begin = std::min(begin, view.offset);
+                end = std::max(end, view.offset + view.length);
+            }
+        }
+        begin = begin / 16 * 16;
+        end = std::max(begin, end);
+
+        // in slices, dropping the pages of each from the mapping once GL has its copy, so the file and the buffer
+        // are never resident in full at the same time
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, end - begin, NULL, GL_STATIC_DRAW);
+        for (size_t offset = begin; offset < end; offset += UploadSliceBytes)
+        {
+            size_t bytes = std::min(UploadSliceBytes, end - offset);
+            glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(offset - begin), (GLsizeiptr)bytes, bin + offset);
+            file.release((size_t)(bin - file.data()) + offset, bytes);
+        }
+        stats.uploadedBytes = end - begin;
+
+        for (GlbPrimitive& primitive : primitiveList)
+        {
+            glGenVertexArrays(1, &primitive.vertexArray);
+            glBindVertexArray(primitive.vertexArray);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            primitive.matchesLayout = interleavedAs<Layout>(primitive);
+            if (primitive.matchesLayout)
+            {
+                Layout::setAttributes((GLintptr)(primitive.position.offset - begin));
+                stats.layoutPrimitives++;
+            }
+            else
+            {
+                setAttribute(0, primitive.position, begin);
+                if (primitive.hasTexCoord)
+                    setAttribute(1, primitive.texCoord, begin);
+            }
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+            primitive.indexSize = componentSize(primitive.indices.componentType);
+            primitive.firstIndex = (uint32_t)((primitive.indices.offset - begin) / primitive.indexSize);
+        }
+        glBindVertexArray(0);
+        // primitives without texture coordinates read this constant
+        glVertexAttrib2f(1, 0.0f, 0.0f);
+
+        file.close();
+        bin = nullptr;
+        stats.uploadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.peakRssGrowthKB = peakRssKB() - rssBefore;
+    }
+
+    // add the nodes below parent; returns the id of every node
+    std::vector<uint32_t> addNodes(TransformHierarchy& transforms, uint32_t parent) const
+    {
+        std::vector<uint32_t> ids(nodeList.size());
+        for (size_t k = 0; k < nodeList.size(); k++)
+            ids[k] = transforms.add(nodeList[k].local, nodeList[k].parent == TransformHierarchy::NoParent ? parent : ids[nodeList[k].parent]);
+        return ids;
+    }
+
+    // The transform that scales and moves the instances uniformly so their bounds are centered on center with the
+    // largest side size, for the node their nodes were added below; ids as returned by addNodes
+    Transform fit(const TransformHierarchy& transforms, const std::vector<uint32_t>& ids, const glm::vec3& center, float size) const
+    {
+        Transform transform;
+        if (instanceList.empty())
+            return transform;
+        glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+        for (const GlbInstance& instance : instanceList)
+        {
+            glm::vec3 boxCenter, extent;
+            worldBox(instance, transforms.worldMatrix(ids[instance.node]), boxCenter, extent);
+            lo = glm::min(lo, boxCenter - extent);
+            hi = glm::max(hi, boxCenter + extent);
+        }
+        glm::vec3 side = hi - lo;
+        float scale = size / std::max(std::max(side.x, side.y), std::max(side.z, 1e-20f));
+        transform.translation = center - scale * 0.5f * (lo + hi);
+        transform.scale = glm::vec3(scale);
+        return transform;
+    }
+
+    // world space bounding box of an instance placed with model, as center and half extent
+    void worldBox(const GlbInstance& instance, const glm::mat4& m, glm::vec3& center, glm::vec3& extent) const
+    {
+        const GlbAccessor& position = primitiveList[instance.primitive].position;
+        glm::vec3 localCenter = 0.5f * (position.min + position.max), localExtent = 0.5f * (position.max - position.min);
+        center = glm::vec3(m * glm::vec4(localCenter, 1.0f));
+        extent = glm::abs(glm::vec3(m[0])) * localExtent.x + glm::abs(glm::vec3(m[1])) * localExtent.y + glm::abs(glm::vec3(m[2])) * localExtent.z;
+    }
+
+    const std::vector<GlbPrimitive>& primitives() const
+    {
+        return primitiveList;
+    }
+    const std::vector<GlbNode>& nodes() const
+    {
+        return nodeList;
+    }
+    const std::vector<GlbInstance>& instances() const
+    {
+        return instanceList;
+    }
+    const std::string& error() const
+    {
+        return failure;
+    }
+    const GlbStats& glbStats() const
+    {
+        return stats;
+    }
+
+    void destroy()
+    {
+        for (GlbPrimitive& primitive : primitiveList)
+        {
+            if (primitive.vertexArray)
+                glDeleteVertexArrays(1, &primitive.vertexArray);
+            primitive.vertexArray = 0;
+        }
+        if (buffer)
+            glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+
+private:
+    static const size_t UploadSliceBytes = 16 << 20;
+
+    struct View
+    {
+        size_t offset;      // into the binary chunk
+        size_t length;
+        size_t stride;      // 0: tightly packed
+        bool inBin;
+    };
+
+    MappedFile file;
+    const unsigned char* bin = nullptr;
+    size_t binLength = 0;
+    std::vector<View> views;
+    std::vector<GlbPrimitive> primitiveList;
+    std::vector<std::vector<uint32_t>> meshPrimitives;     // per glTF mesh
+    std::vector<GlbNode> nodeList;
+    std::vector<GlbInstance> instanceList;
+    GLuint buffer = 0;
+    std::string failure;
+    GlbStats stats;
+    long rssBefore = 0;
+
+    bool fail(const std::string& message)
+    {
+        failure = message;
+        file.close();
+        return false;
+    }
+
+    static long peakRssKB()
+    {
+        struct rusage usage;
+        return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+    }
+
+    static size_t componentSize(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+        case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT: case GL_FLOAT: return 4;
+        default: return 0;
+        }
+    }
+
+    static GLint componentCount(const std::string& type)
+    {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        return 0;
+    }
+
+    template <typename Layout>
+    static bool interleavedAs(const GlbPrimitive& primitive)
+    {
+        const GlbAccessor& position = primitive.position;
+        const GlbAccessor& texCoord = primitive.texCoord;
+        return primitive.hasTexCoord && position.bufferView == texCoord.bufferView &&
+               position.stride == Layout::stride && texCoord.stride == Layout::stride &&
+               texCoord.offset == position.offset + Layout::offset(1) &&
+               Layout::attributeIs(0, 0, position.components, position.componentType, position.normalized) &&
+               Layout::attributeIs(1, 1, texCoord.components, texCoord.componentType, texCoord.normalized);
+    }
+
+    void setAttribute(GLuint location, const GlbAccessor& accessor, size_t begin)
+    {
+        glVertexAttribPointer(location, accessor.components, accessor.componentType, accessor.normalized,
+                              (GLsizei)accessor.stride, (void*)(uintptr_t)(accessor.offset - begin));
+        glEnableVertexAttribArray(location);
+    }
+
+    bool parseBufferViews(const JsonValue& list)
+    {
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            const JsonValue& view = list[i];
+            View resolved;
+            resolved.offset = (size_t)view["byteOffset"].asInt(0);
+            resolved.length = (size_t)view["byteLength"].asInt(0);
+            resolved.stride = (size_t)view["byteStride"].asInt(0);
+            resolved.inBin = view["buffer"].asInt(0) == 0 && bin && resolved.offset + resolved.length <= binLength;
+            views.push_back(resolved);
+        }
+        return true;
+    }
+
+    // resolve accessor index; false if it is missing, sparse or reaches outside its view
+    bool parseAccessor(const JsonValue& document, long long index, GlbAccessor& out)
+    {
+        const JsonValue& accessor = document["accessors"][(size_t)std::max(index, 0LL)];
+        if (index < 0 || accessor.isNull())
+            return false;
+        if (!accessor["sparse"].isNull())
+        {
+            failure = "sparse accessors are not supported";
+            return false;
+        }
+        long long viewIndex = accessor["bufferView"].asInt();
+        if (viewIndex < 0 || viewIndex >= (long long)views.size() || !views[viewIndex].inBin)
+            return false;
+        const View& view = views[viewIndex];
+        out.bufferView = (int)viewIndex;
+        out.componentType = (GLenum)accessor["componentType"].asInt(0);
+        out.components = componentCount(accessor["type"].string);
+        out.normalized = accessor["normalized"].boolean ? GL_TRUE : GL_FALSE;
+        out.count = (size_t)accessor["count"].asInt(0);
+        size_t elementSize = componentSize(out.componentType) * (size_t)out.components;
+        out.stride = view.stride ? view.stride : elementSize;
+        out.offset = view.offset + (size_t)accessor["byteOffset"].asInt(0);
+        for (int c = 0; c < 3; c++)
+        {
+            out.min[c] = (float)accessor["min"][(size_t)c].asNumber(0.0);
+            out.max[c] = (float)accessor["max"][(size_t)c].asNumber(0.0);
+        }
+        return elementSize > 0 && out.count > 0 && out.offset % componentSize(out.componentType) == 0 &&
+               out.offset + (out.count - 1) * out.stride + elementSize <= view.offset + view.length;
+    }
+
+    bool parsePrimitives(const JsonValue& document, size_t maxPrimitives)
+    {
+        const JsonValue& meshes = document["meshes"];
+        meshPrimitives.resize(meshes.size());
+        for (size_t m = 0; m < meshes.size(); m++)
+        {
+            const JsonValue& primitives = meshes[m]["primitives"];
+            for (size_t p = 0; p < primitives.size(); p++)
+            {
+                const JsonValue& primitive = primitives[p];
+                GlbPrimitive parsed;
+                bool valid = primitive["mode"].asInt(4) == 4 &&
+                             parseAccessor(document, primitive["attributes"]["POSITION"].asInt(), parsed.position) &&
+                             parseAccessor(document, primitive["indices"].asInt(), parsed.indices);
+                valid = valid && (parsed.indices.componentType == GL_UNSIGNED_BYTE || parsed.indices.componentType == GL_UNSIGNED_SHORT ||
+                                  parsed.indices.componentType == GL_UNSIGNED_INT) &&
+                        parsed.indices.stride == componentSize(parsed.indices.componentType) && parsed.indices.count % 3 == 0;
+                if (valid && !primitive["attributes"]["TEXCOORD_0"].isNull())
+                    parsed.hasTexCoord = parseAccessor(document, primitive["attributes"]["TEXCOORD_0"].asInt(), parsed.texCoord);
+                if (!failure.empty())
+                    return false;
+                if (!valid || primitiveList.size() >= maxPrimitives)
+                {
+                    stats.skippedPrimitives++;
+                    continue;
+                }
+                meshPrimitives[m].push_back((uint32_t)primitiveList.size());
+                primitiveList.push_back(parsed);
+            }
+        }
+        stats.primitives = primitiveList.size();
+        if (primitiveList.empty())
+            return fail("no indexed triangle primitives");
+        return true;
+    }
+
+    static Transform localTransform(const JsonValue& node)
+    {
+        const JsonValue& matrix = node["matrix"];
+        if (matrix.size() == 16)
+        {
+            glm::mat4 m;
+            for (int k = 0; k < 16; k++)
+                m[k / 4][k % 4] = (float)matrix[(size_t)k].asNumber();
+            return decomposeTransform(m);
+        }
+        const JsonValue& t = node["translation"];
+        const JsonValue& r = node["rotation"];
+        const JsonValue& s = node["scale"];
+        glm::vec3 translation((float)t[0].asNumber(0.0), (float)t[1].asNumber(0.0), (float)t[2].asNumber(0.0));
+        // glTF quaternions are x, y, z, w; glm::quat takes w first
+        glm::quat rotation((float)r[3].asNumber(1.0), (float)r[0].asNumber(0.0), (float)r[1].asNumber(0.0), (float)r[2].asNumber(0.0));
+        glm::vec3 scale((float)s[0].asNumber(1.0), (float)s[1].asNumber(1.0), (float)s[2].asNumber(1.0));
+        return Transform{ translation, glm::normalize(rotation), scale };
+    }
+
+    // walk the default scene (or, without scenes, every root node), keeping the nodes in depth-first order, and place
+    // the primitives of every mesh node
+    void parseNodes(const JsonValue& document)
+    {
+        const JsonValue& nodes = document["nodes"];
+        stats.nodes = nodes.size();
+        std::vector<size_t> roots;
+        const JsonValue& scene = document["scenes"][(size_t)document["scene"].asInt(0)];
+        if (!scene.isNull())
+        {
+            for (size_t i = 0; i < scene["nodes"].size(); i++)
+                roots.push_back((size_t)scene["nodes"][i].asInt(0));
+        }
+        else
+        {
+            std::vector<bool> child(nodes.size(), false);
+            for (size_t i = 0; i < nodes.size(); i++)
+            {
+                for (size_t c = 0; c < nodes[i]["children"].size(); c++)
+                {
+                    size_t index = (size_t)nodes[i]["children"][c].asInt(0);
+                    if (index < child.size())
+                        child[index] = true;
+                }
+            }
+            for (size_t i = 0; i < nodes.size(); i++)
+            {
+                if (!child[i])
+                    roots.push_back(i);
+            }
+        }
+
+        // depth first with an explicit stack; a valid file is a forest, the visit limit stops cycles in broken ones
+        std::vector<std::pair<size_t, uint32_t>> stack;     // document index, parent in nodeList
+        for (size_t k = roots.size(); k-- > 0; )
+            stack.emplace_back(roots[k], TransformHierarchy::NoParent);
+        size_t visits = 0;
+        while (!stack.empty() && visits++ <= nodes.size())
+        {
+            size_t index = stack.back().first;
+            uint32_t parent = stack.back().second;
+            stack.pop_back();
+            const JsonValue& node = nodes[index];
+            if (node.isNull())
+                continue;
+            uint32_t self = (uint32_t)nodeList.size();
+            nodeList.push_back(GlbNode{ parent, localTransform(node) });
+            long long mesh = node["mesh"].asInt();
+            if (mesh >= 0 && mesh < (long long)meshPrimitives.size())
+            {
+                for (uint32_t primitive : meshPrimitives[(size_t)mesh])
+                    instanceList.push_back(GlbInstance{ self, primitive });
+            }
+            const JsonValue& children = node["children"];
+            for (size_t c = children.size(); c-- > 0; )
+                stack.emplace_back((size_t)children[c].asInt(0), self);
+        }
+        stats.instances = instanceList.size();
+    }
+};
+#endif
@@ -0,0 +1,37 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a, used to key on-disk caches by content
+inline uint64_t fnv1a64(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint64_t fnv1a64(const std::string& text, uint64_t hash = 14695981039346656037ull)
+{
+    return fnv1a64(text.data(), text.size(), hash);
+}
+
+// 16 lowercase hex digits, for cache file names
+inline std::string hashToHex(uint64_t hash)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string text(16, '0');
+    for (int i = 15; i >= 0; i--)
+    {
+        text[i] = digits[hash & 0xf];
+        hash >>= 4;
+    }
+    return text;
+}
+#endif
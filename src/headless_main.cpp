@@ -0,0 +1,165 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "headless_context.h"
+#include "renderer.h"
+#include "camera_path.h"
+#include "frame_stats.h"
+#include "profiler.h"
+#include "benchmarks.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Headless front end: renders the cube scene into an offscreen framebuffer for a fixed number of
+// frames along a fixed camera path, then prints timing statistics. Needs no display and no GPU.
+
+bool writePPM(const char* path, int width, int height, const std::vector<unsigned char>& rgb);
+
+int main(int argc, char* argv[])
+{
+    StartupTimer startup;
+    RenderSettings settings;
+    int width = 800, height = 600;
+    unsigned int frames = 300;
+    CameraPath cameraPath = CameraPath::Static;
+    std::string outputPath;
+    BenchmarkSelection benchmarks;
+    bool profile = false;
+    std::string profileOutput;
+
+    // command line options
+    // --------------------
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (parseRenderSetting(argc, argv, i, settings) || parseBenchmarkOption(arg, benchmarks))
+            continue;
+        else if (arg == "--frames" && i + 1 < argc)
+            frames = static_cast<unsigned int>(std::strtoul(argv[++i], NULL, 10));
+        else if (arg == "--size" && i + 1 < argc && std::sscanf(argv[++i], "%dx%d", &width, &height) == 2 && width > 0 && height > 0)
+            continue;
+        else if (arg == "--camera" && i + 1 < argc && parseCameraPath(argv[++i], cameraPath))
+            continue;
+        else if (arg == "--output" && i + 1 < argc)
+            outputPath = argv[++i];
+        else if (arg == "--profile")
+            profile = settings.overdrawStats = true;
+        else if (arg == "--profile-out" && i + 1 < argc)
+        {
+            profile = settings.overdrawStats = true;
+            profileOutput = argv[++i];
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " " << renderSettingsUsage()
+                      << " [--frames N] [--size WxH] [--camera static|orbit|flythrough] [--output frame.ppm] " << benchmarkUsage()
+                      << " [--profile] [--profile-out profile.csv|profile.json]" << std::endl;
+            return -1;
+        }
+    }
+
+    HeadlessContext context;
+    if (!context.create(width, height))
+    {
+        context.destroy();
+        return -1;
+    }
+    std::cout << "Renderer: " << context.renderer() << ", " << width << "x" << height << std::endl;
+
+    CubeRenderer renderer;
+    renderer.init(settings);
+    printStartupStats(renderer, settings, std::cout);
+
+    if (benchmarks.any())
+    {
+        runBenchmarks(benchmarks, renderer, settings, context.framebuffer, (float)width / (float)height);
+        renderer.destroy();
+        context.destroy();
+        return 0;
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
+
+    // glFinish stands in for the buffer swap, so each sample covers the complete frame on the (software) GPU
+    FrameStats stats;
+    std::unique_ptr<FrameProfiler> profiler;
+    if (profile)
+        profiler.reset(new FrameProfiler());
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+        auto frameStart = std::chrono::steady_clock::now();
+        if (profiler)
+            profiler->beginFrame();
+
+        float t = frames > 1 ? (float)frame / (float)(frames - 1) : 0.0f;
+        glBindFramebuffer(GL_FRAMEBUFFER, context.framebuffer);
+        renderer.render(projection, cameraPathView(cameraPath, t), profiler.get());
+        {
+            ProfileScope scope(profiler.get(), "swap");
+            glFinish();
+        }
+        startup.frameFinished(renderer.texturesResident(), std::cout, renderer.meshResident());
+        if (profiler)
+            profiler->endFrame();
+
+        // the first frame is excluded since it includes driver warm-up
+        if (frame > 0)
+            stats.add(std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count());
+    }
+
+    std::cout << drawPathName(settings.drawPath) << " path, " << settings.cubeCount << " cubes, "
+              << frames << " frames" << std::endl;
+    if (stats.count() > 0)
+    {
+        std::cout << "frame time ms: avg " << stats.mean() * 1000.0
+                  << "  min " << stats.min() * 1000.0
+                  << "  p50 " << stats.percentile(50) * 1000.0
+                  << "  p95 " << stats.percentile(95) * 1000.0
+                  << "  p99 " << stats.percentile(99) * 1000.0
+                  << "  max " << stats.max() * 1000.0
+                  << "  (" << 1.0 / stats.mean() << " fps)" << std::endl;
+    }
+    printRenderStats(renderer, std::cout);
+
+    if (profiler)
+    {
+        profiler->flush();
+        profiler->printSummary(std::cout);
+        if (!profileOutput.empty() && !profiler->write(profileOutput))
+            std::cout << "Failed to write " << profileOutput << std::endl;
+        profiler.reset();
+    }
+
+    if (!outputPath.empty())
+    {
+        std::vector<unsigned char> pixels((size_t)width * height * 3);
+        context.readPixels(pixels.data());
+        if (!writePPM(outputPath.c_str(), width, height, pixels))
+            std::cout << "Failed to write " << outputPath << std::endl;
+    }
+
+    renderer.destroy();
+    context.destroy();
+    return 0;
+}
+
+// Write bottom-up RGB rows (as returned by glReadPixels) to a binary PPM file
+bool writePPM(const char* path, int width, int height, const std::vector<unsigned char>& rgb)
+{
+    FILE* file = std::fopen(path, "wb");
+    if (!file)
+        return false;
+    std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for (int y = height - 1; y >= 0; y--)
+        std::fwrite(&rgb[(size_t)y * width * 3], 1, (size_t)width * 3, file);
+    return std::fclose(file) == 0;
+}
@@ -0,0 +1,392 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// One unit of work: a small callable stored inline, a counter of itself plus its unfinished children, and a
+// counter of the jobs it still waits for. Jobs live in per-thread rings inside the JobSystem and are never freed,
+// only reused, so creating one costs no allocation.
+struct Job
+{
+    static const size_t PayloadBytes = 64;
+    static const int MaxContinuations = 4;
+
+    void (*function)(Job*);
+    Job* parent;
+    std::atomic<int32_t> unfinished;        // 1 until it ran, plus one per child that has not finished
+    std::atomic<int32_t> dependencies;      // jobs it waits for, plus one until run() is called
+    std::atomic<int32_t> continuationCount;
+    Job* continuations[MaxContinuations];   // jobs waiting for this one
+    alignas(std::max_align_t) unsigned char payload[PayloadBytes];
+};
+
+// Chase-Lev work-stealing deque of a fixed capacity (the C11 formulation of Le et al. 2013): the owning thread
+// pushes and pops at the bottom, any other thread steals from the top. Only a steal and the owner's pop of the
+// last job contend, on one compare and swap.
+class WorkStealingDeque
+{
+public:
+    static const int64_t Capacity = 1024;
+
+    // owner only; false if the deque is full
+    bool push(Job* job)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= Capacity)
+            return false;
+        buffer[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+        // publishes the slot and the job behind it to thieves, which read bottom with acquire
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    // owner only: the job pushed last, or null
+    Job* pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Job* job = buffer[b & (Capacity - 1)].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            // the last one: race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    // any thread: the oldest job, or null if there is none or another thread got it first
+    Job* steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+        Job* job = buffer[t & (Capacity - 1)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return job;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top{ 0 };
+    alignas(64) std::atomic<int64_t> bottom{ 0 };
+    alignas(64) std::atomic<Job*> buffer[Capacity] = {};
+};
+
+// counters of a JobSystem since it was created
+struct JobStats
+{
+    unsigned long long executed = 0, stolen = 0, inlined = 0, sleeps = 0;
+};
+
+// Fixed pool of worker threads for the engine's per-frame work, with one work-stealing deque per thread.
+// The thread that created the system takes part as thread 0: it submits jobs and, while it waits for them,
+// runs jobs itself. Workers pop their own deque first (newest job, still warm in the cache) and otherwise
+// steal the oldest job of another thread; when there is nothing to do for a while they sleep until the next job.
+//   Job* root = jobs.create([&]() { ... });
+//   Job* child = jobs.createChild(root, [&]() { ... });   // root only finishes once child has
+//   jobs.run(child); jobs.run(root); jobs.wait(root);
+// A job created with create() can wait for others: dependsOn(job, before) before either is run delays job until
+// before has finished. Every thread creates its jobs in a ring of JobsPerThread, so a thread must not have more than
+// that in flight at once. Only thread 0 and the workers may call the system.
+class JobSystem
+{
+public:
+    static const size_t JobsPerThread = 1024;
+
+    // threads: total including the calling thread (0 = one per hardware thread); 1 runs everything inline in wait()
+    explicit JobSystem(unsigned int threads = 0)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        queues.reset(new PerThread[threads]);
+        threadCount = threads;
+        for (unsigned int i = 1; i < threads; i++)
+            workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeWorkers.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    unsigned int threads() const
+    {
+        return threadCount;
+    }
+
+    // a job running function; it runs once run() was called and everything it dependsOn finished
+    template <typename Function>
+    Job* create(Function&& function)
+    {
+        return createChild(nullptr, std::forward<Function>(function));
+    }
+
+    // a job that parent only finishes after; create children before running the parent, or from inside it
+    template <typename Function>
+    Job* createChild(Job* parent, Function&& function)
+    {
+        using Callable = typename std::decay<Function>::type;
+        static_assert(sizeof(Callable) <= Job::PayloadBytes, "job function too large, capture by reference");
+        static_assert(std::is_trivially_destructible<Callable>::value, "job functions are never destroyed");
+        PerThread& thread = queues[currentThread()];
+        Job* job = &thread.jobs[thread.nextJob++ % JobsPerThread];
+        job->function = [](Job* self) { (*reinterpret_cast<Callable*>(self->payload))(); };
+        job->parent = parent;
+        job->unfinished.store(1, std::memory_order_relaxed);
+        job->dependencies.store(1, std::memory_order_relaxed);
+        job->continuationCount.store(0, std::memory_order_relaxed);
+        new (job->payload) Callable(std::forward<Function>(function));
+        if (parent)
+            parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    // job does not start before before has finished; call before running either. False if Job::MaxContinuations
+    // jobs already wait for before, in which case nothing changed.
+    bool dependsOn(Job* job, Job* before)
+    {
+        int32_t slot = before->continuationCount.load(std::memory_order_relaxed);
+        if (slot >= Job::MaxContinuations)
+            return false;
+        before->continuations[slot] = job;
+        before->continuationCount.store(slot + 1, std::memory_order_relaxed);
+        job->dependencies.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // queue the job (or, once the jobs it depends on are done, have the last of them queue it)
+    void run(Job* job)
+    {
+        if (job->dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            enqueue(job);
+    }
+
+    // run jobs until job has finished
+    void wait(const Job* job)
+    {
+        unsigned int thread = currentThread();
+        while (job->unfinished.load(std::memory_order_acquire) > 0)
+        {
+            if (Job* next = take(thread))
+                execute(next);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    // Call function(begin, end) over [0, count) split into ranges of at least grain elements, on all threads,
+    // and return once every range is done
+    template <typename Function>
+    void parallelFor(size_t count, size_t grain, const Function& function)
+    {
+        parallelRanges(count, grain, [&function](size_t, size_t begin, size_t end) { function(begin, end); });
+    }
+
+    // The same, calling function(range, begin, end) with the index of the range below rangeCount(count, grain),
+    // e.g. for per-range partial results that are combined afterwards in range order
+    template <typename Function>
+    void parallelRanges(size_t count, size_t grain, const Function& function)
+    {
+        size_t ranges = rangeCount(count, grain);
+        if (ranges <= 1)
+        {
+            if (count > 0)
+                function((size_t)0, (size_t)0, count);
+            return;
+        }
+        const Function* f = &function;
+        size_t size = (count + ranges - 1) / ranges;
+        Job* root = create([]() {});
+        for (size_t range = 0; range * size < count; range++)
+        {
+            size_t begin = range * size, end = std::min(count, begin + size);
+            run(createChild(root, [f, range, begin, end]() { (*f)(range, begin, end); }));
+        }
+        run(root);
+        wait(root);
+    }
+
+    // how many ranges parallelFor splits count elements into: up to four per thread, so that a thread that is
+    // descheduled or got slower ranges holds up the others less
+    size_t rangeCount(size_t count, size_t grain) const
+    {
+        grain = std::max<size_t>(grain, 1);
+        if (threadCount == 1 || count <= grain)
+            return 1;
+        size_t ranges = std::min((size_t)threadCount * 4, (count + grain - 1) / grain);
+        // equal ranges of the rounded up size may not need the last one
+        size_t size = (count + ranges - 1) / ranges;
+        return (count + size - 1) / size;
+    }
+
+    JobStats jobStats() const
+    {
+        JobStats stats;
+        stats.executed = executed.load(std::memory_order_relaxed);
+        stats.stolen = stolen.load(std::memory_order_relaxed);
+        stats.inlined = inlined.load(std::memory_order_relaxed);
+        stats.sleeps = sleeps.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    static const int SpinsBeforeSleep = 64;
+
+    struct alignas(64) PerThread
+    {
+        WorkStealingDeque deque;
+        Job jobs[JobsPerThread];
+        size_t nextJob = 0;
+    };
+
+    std::unique_ptr<PerThread[]> queues;
+    unsigned int threadCount = 1;
+    std::vector<std::thread> workers;
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeWorkers;
+    std::atomic<int> queued{ 0 };       // jobs pushed and not taken yet
+    std::atomic<int> sleeping{ 0 };
+    bool stopping = false;
+
+    std::atomic<unsigned long long> executed{ 0 }, stolen{ 0 }, inlined{ 0 }, sleeps{ 0 };
+
+    struct ThreadSlot
+    {
+        const JobSystem* system;
+        unsigned int index;
+    };
+    static ThreadSlot& threadSlot()
+    {
+        static thread_local ThreadSlot slot = { nullptr, 0 };
+        return slot;
+    }
+
+    // the worker index of the calling thread, 0 for the thread that owns the system
+    unsigned int currentThread() const
+    {
+        const ThreadSlot& slot = threadSlot();
+        return slot.system == this ? slot.index : 0;
+    }
+
+    void enqueue(Job* job)
+    {
+        unsigned int thread = currentThread();
+        if (threadCount == 1 || !queues[thread].deque.push(job))
+        {
+            // nobody to share with, or the deque is full: run it right here
+            inlined.fetch_add(1, std::memory_order_relaxed);
+            execute(job);
+            return;
+        }
+        queued.fetch_add(1, std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_seq_cst) > 0)
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wakeWorkers.notify_one();
+        }
+    }
+
+    // own deque first, then steal round robin starting at the next thread
+    Job* take(unsigned int thread)
+    {
+        Job* job = queues[thread].deque.pop();
+        for (unsigned int i = 1; !job && i < threadCount; i++)
+        {
+            job = queues[(thread + i) % threadCount].deque.steal();
+            if (job)
+                stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (job)
+            queued.fetch_sub(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    void execute(Job* job)
+    {
+        job->function(job);
+        executed.fetch_add(1, std::memory_order_relaxed);
+        finish(job);
+    }
+
+    void finish(Job* job)
+    {
+        // read what is needed before the count drops: once it reaches zero, a waiter may return and the job be reused
+        Job* parent = job->parent;
+        int32_t waiting = job->continuationCount.load(std::memory_order_relaxed);
+        Job* continuations[Job::MaxContinuations];
+        std::copy(job->continuations, job->continuations + waiting, continuations);
+        if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        for (int32_t i = 0; i < waiting; i++)
+            run(continuations[i]);
+        if (parent)
+            finish(parent);
+    }
+
+    void workerLoop(unsigned int index)
+    {
+        threadSlot() = ThreadSlot{ this, index };
+        int idle = 0;
+        for (;;)
+        {
+            if (Job* job = take(index))
+            {
+                execute(job);
+                idle = 0;
+                continue;
+            }
+            if (++idle < SpinsBeforeSleep)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            // sleep until something is queued; announcing the sleep before the last check means a job pushed
+            // concurrently either is seen here or sees the sleeper and wakes it
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeping.fetch_add(1, std::memory_order_seq_cst);
+            if (!stopping && queued.load(std::memory_order_seq_cst) <= 0)
+            {
+                sleeps.fetch_add(1, std::memory_order_relaxed);
+                wakeWorkers.wait(lock, [this] { return stopping || queued.load(std::memory_order_seq_cst) > 0; });
+            }
+            sleeping.fetch_sub(1, std::memory_order_seq_cst);
+            if (stopping)
+                return;
+            idle = 0;
+        }
+    }
+};
+#endif
@@ -0,0 +1,220 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include "number_parse.h"
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// text as the contents of a JSON string: quotes and backslashes escaped, control characters as \u00XX
+inline std::string jsonEscape(const std::string& text)
+{
+    static const char hex[] = "0123456789abcdef";
+    std::string out;
+    for (char c : text)
+    {
+        unsigned char u = (unsigned char)c;
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (u < 0x20)
+        {
+            out += "\\u00";
+            out += hex[u >> 4];
+            out += hex[u & 15];
+        }
+        else
+            out += c;
+    }
+    return out;
+}
+
+// Just enough JSON for glTF documents and benchmark reports: numbers are doubles, objects keep their keys in file order
+class JsonValue
+{
+public:
+    enum class Type : uint8_t { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> items;       // array elements, or object member values
+    std::vector<std::string> keys;      // object member names, one per item
+
+    // member or element, a null value if there is none
+    const JsonValue& operator[](const char* key) const
+    {
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            if (keys[i] == key)
+                return items[i];
+        }
+        return null();
+    }
+    const JsonValue& operator[](size_t index) const
+    {
+        return type == Type::Array && index < items.size() ? items[index] : null();
+    }
+    const JsonValue& operator[](int index) const
+    {
+        return index < 0 ? null() : (*this)[(size_t)index];
+    }
+    size_t size() const
+    {
+        return type == Type::Array ? items.size() : 0;
+    }
+    bool isNull() const
+    {
+        return type == Type::Null;
+    }
+    double asNumber(double fallback = 0.0) const
+    {
+        return type == Type::Number ? number : fallback;
+    }
+    long long asInt(long long fallback = -1) const
+    {
+        return type == Type::Number ? (long long)number : fallback;
+    }
+
+    // parse a complete document; false on a syntax error
+    static bool parse(const char* begin, const char* end, JsonValue& document)
+    {
+        const char* p = parseValue(begin, end, document, 0);
+        return p && skipSpace(p, end) == end;
+    }
+
+private:
+    static const int MaxDepth = 64;
+
+    static const JsonValue& null()
+    {
+        static const JsonValue value;
+        return value;
+    }
+
+    static const char* skipSpace(const char* p, const char* end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            p++;
+        return p;
+    }
+
+    static const char* parseLiteral(const char* p, const char* end, const char* word)
+    {
+        size_t length = std::strlen(word);
+        return (size_t)(end - p) >= length && std::memcmp(p, word, length) == 0 ? p + length : nullptr;
+    }
+
+    // a quoted string with escapes; \u escapes become UTF-8
+    static const char* parseString(const char* p, const char* end, std::string& out)
+    {
+        if (p == end || *p != '"')
+            return nullptr;
+        for (p++; p < end && *p != '"'; p++)
+        {
+            if (*p != '\\')
+            {
+                out += *p;
+                continue;
+            }
+            if (++p == end)
+                return nullptr;
+            switch (*p)
+            {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u':
+            {
+                unsigned int code = 0;
+                for (int k = 0; k < 4; k++)
+                {
+                    if (++p == end || !std::isxdigit((unsigned char)*p))
+                        return nullptr;
+                    code = code * 16 + (unsigned int)(std::isdigit((unsigned char)*p) ? *p - '0' : (std::tolower((unsigned char)*p) - 'a' + 10));
+                }
+                if (code < 0x80)
+                    out += (char)code;
+                else if (code < 0x800)
+                {
+                    out += (char)(0xC0 | code >> 6);
+                    out += (char)(0x80 | (code & 0x3F));
+                }
+                else
+                {
+                    out += (char)(0xE0 | code >> 12);
+                    out += (char)(0x80 | ((code >> 6) & 0x3F));
+                    out += (char)(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: out += *p; break;     // \" \\ \/
+            }
+        }
+        return p < end ? p + 1 : nullptr;
+    }
+
+    static const char* parseValue(const char* p, const char* end, JsonValue& value, int depth)
+    {
+        p = skipSpace(p, end);
+        if (p == end || depth > MaxDepth)
+            return nullptr;
+        switch (*p)
+        {
+        case '{':
+        case '[':
+        {
+            bool object = *p == '{';
+            char close = object ? '}' : ']';
+            value.type = object ? Type::Object : Type::Array;
+            p = skipSpace(p + 1, end);
+            if (p < end && *p == close)
+                return p + 1;
+            for (;;)
+            {
+                if (object)
+                {
+                    value.keys.emplace_back();
+                    p = parseString(skipSpace(p, end), end, value.keys.back());
+                    p = p ? skipSpace(p, end) : nullptr;
+                    if (!p || p == end || *p != ':')
+                        return nullptr;
+                    p++;
+                }
+                value.items.emplace_back();
+                p = parseValue(p, end, value.items.back(), depth + 1);
+                p = p ? skipSpace(p, end) : nullptr;
+                if (!p || p == end)
+                    return nullptr;
+                if (*p == close)
+                    return p + 1;
+                if (*p != ',')
+                    return nullptr;
+                p++;
+            }
+        }
+        case '"':
+            value.type = Type::String;
+            return parseString(p, end, value.string);
+        case 't':
+        case 'f':
+            value.type = Type::Bool;
+            value.boolean = *p == 't';
+            return parseLiteral(p, end, value.boolean ? "true" : "false");
+        case 'n':
+            return parseLiteral(p, end, "null");
+        default:
+            value.type = Type::Number;
+            return parseDouble(p, end, value.number);
+        }
+    }
+};
+#endif
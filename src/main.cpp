@@ -5,11 +5,17 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "shader_s.h"
+#include "renderer.h"
+#include "profiler.h"
+#include "frame_stats.h"
+#include "benchmarks.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #include <iostream>
 #include <filesystem>
+#include <memory>
+#include <string>
 
 
 
@@ -38,8 +44,36 @@ float fov   =  45.0f;
 float deltaTime = 0.0f;	// time between current frame and last frame
 float lastFrame = 0.0f;
 
-int main()
+int main(int argc, char* argv[])
 {
+    StartupTimer startup;
+
+    // command line options
+    // --------------------
+    RenderSettings settings;
+    BenchmarkSelection benchmarks;
+    bool profile = false;
+    std::string profileOutput;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (parseRenderSetting(argc, argv, i, settings) || parseBenchmarkOption(arg, benchmarks))
+            continue;
+        else if (arg == "--profile")
+            profile = settings.overdrawStats = true;
+        else if (arg == "--profile-out" && i + 1 < argc)
+        {
+            profile = settings.overdrawStats = true;
+            profileOutput = argv[++i];
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " " << renderSettingsUsage() << " " << benchmarkUsage()
+                      << " [--profile] [--profile-out profile.csv|profile.json]" << std::endl;
+            return -1;
+        }
+    }
+
     // GLFW initialization
     if (!glfwInit())
     {
@@ -71,162 +105,26 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
-    
-    // configure global opengl state
-    // -----------------------------
-    glEnable(GL_DEPTH_TEST);
 
-    // Build and compile the shader program
-    Shader ourShader("shaders/3.3.shader.vs", "shaders/3.3.shader.fs");
-    
-    // Set up vertex data (and buffer(s)) and configure vertex attributes
-    // Vertex data for a rectangle
-    // The rectangle is defined by 4 vertices (2 triangles)
-    float vertices[] = {
-        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-         0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-
-        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f
-    };
-    // world space positions of our cubes
-    glm::vec3 cubePositions[] = {
-        glm::vec3( 0.0f,  0.0f,  0.0f),
-        glm::vec3( 2.0f,  5.0f, -15.0f),
-        glm::vec3(-1.5f, -2.2f, -2.5f),
-        glm::vec3(-3.8f, -2.0f, -12.3f),
-        glm::vec3( 2.4f, -0.4f, -3.5f),
-        glm::vec3(-1.7f,  3.0f, -7.5f),
-        glm::vec3( 1.3f, -2.0f, -2.5f),
-        glm::vec3( 1.5f,  2.0f, -2.5f),
-        glm::vec3( 1.5f,  0.2f, -1.5f),
-        glm::vec3(-1.3f,  1.0f, -1.5f)
-    };
-    // Generate and bind a Vertex Buffer Object (VBO)
-    // Generate a buffer ID
-    unsigned int VBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    // Bind the Vertex Array Object first, then bind and set vertex buffer(s)
-    glBindVertexArray(VAO);
-
-    // Bind the buffer to the GL_ARRAY_BUFFER target
-    // This tells OpenGL that we want to use the buffer as a vertex buffer
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // Copy the vertex data into the buffer's memory
-    // The first parameter is the target buffer, the second is the size of the data,
-    // the third is a pointer to the data, and the last is the usage pattern
-    // GL_STATIC_DRAW indicates that the data will not change
-    
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    //then set our vertex attributes pointers
-     /*Tells Intrepret vertex data
-     first parammeter is which vertex attribute to configure,
-     size of the vertex attribute
-     vertex attribute
-     whether the vertex attribute should be normalized
-     the stride: the space between consecutive vertex attributes
-     offset of the first component of the vertex attribute in the buffer
-     last parameter is the pointer to the vertex attribute data */ 
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // texture coord attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE,  5* sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    
-    // load and create a texture 
-    unsigned int texture1, texture2;
-    glGenTextures(1, &texture1);
-    glBindTexture(GL_TEXTURE_2D, texture1); // all upcoming GL_TEXTURE_2D operations now have effect on this texture object
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load image, create texture and generate mipmaps
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char *data = stbi_load("textures/container.jpg", &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
-
-    // Texture 2
-    glGenTextures(1, &texture2);
-    glBindTexture(GL_TEXTURE_2D, texture2);
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load image, create texture and generate mipmaps
-    data = stbi_load(("textures/awesomeface.png"), &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
+    // shaders, geometry and textures of the cube scene
+    CubeRenderer renderer;
+    renderer.init(settings);
+    printStartupStats(renderer, settings, std::cout);
+
+    if (benchmarks.any())
     {
-        std::cout << "Failed to load texture" << std::endl;
+        runBenchmarks(benchmarks, renderer, settings, 0, (float)SCR_WIDTH / (float)SCR_HEIGHT);
+        renderer.destroy();
+        glfwTerminate();
+        return 0;
     }
-    stbi_image_free(data);
 
-    // tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
-    // -------------------------------------------------------------------------------------------
-    ourShader.use(); // don't forget to activate/use the shader before setting uniforms!
-    // either set it manually like so:
-    glUniform1i(glGetUniformLocation(ourShader.ID, "texture1"), 0);
-    // or set it via the texture class
-    ourShader.setInt("texture2", 1);
+    // frame time statistics, reported on exit
+    double totalFrameTime = 0.0;
+    unsigned int frameCount = 0;
+    std::unique_ptr<FrameProfiler> profiler;
+    if (profile)
+        profiler.reset(new FrameProfiler());
 
     // Render loop
     while(!glfwWindowShouldClose(window))
@@ -236,57 +134,57 @@ int main()
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        if (frameCount++ > 0)
+            totalFrameTime += deltaTime;
+        if (profiler)
+            profiler->beginFrame();
 
         // input
         // -----
-        processInput(window);
+        {
+            ProfileScope scope(profiler.get(), "input");
+            processInput(window);
+        }
 
         // render
         // ------
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); 
-
-        // bind textures on corresponding texture units
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
-
-        // activate shader
-        ourShader.use();
-
-        // pass projection matrix to shader (note that in this case it could change every frame)
+        // projection matrix (note that in this case it could change every frame) and camera/view transformation
         glm::mat4 projection = glm::perspective(glm::radians(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        ourShader.setMat4("projection", projection);
-
-        // camera/view transformation
         glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        ourShader.setMat4("view", view);
+        renderer.render(projection, view, profiler.get());
 
-        // render boxes
-        glBindVertexArray(VAO);
-        for (unsigned int i = 0; i < 10; i++)
+        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+        // -------------------------------------------------------------------------------
         {
-            // calculate the model matrix for each object and pass it to shader before drawing
-            glm::mat4 model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-            model = glm::translate(model, cubePositions[i]);
-            float angle = 20.0f * i;
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            ourShader.setMat4("model", model);
-
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            ProfileScope scope(profiler.get(), "swap");
+            glfwSwapBuffers(window);
+            glfwPollEvents();
         }
+        startup.frameFinished(renderer.texturesResident(), std::cout, renderer.meshResident());
+        if (profiler)
+            profiler->endFrame();
+    }
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-        
+    // the first frame is excluded since it includes driver warm-up
+    if (frameCount > 1)
+    {
+        double averageFrameTime = totalFrameTime / (frameCount - 1);
+        std::cout << drawPathName(settings.drawPath) << " path, " << settings.cubeCount << " cubes: "
+                  << frameCount << " frames, average frame time " << averageFrameTime * 1000.0 << " ms ("
+                  << 1.0 / averageFrameTime << " fps)" << std::endl;
+    }
+    printRenderStats(renderer, std::cout);
+    if (profiler)
+    {
+        profiler->flush();
+        profiler->printSummary(std::cout);
+        if (!profileOutput.empty() && !profiler->write(profileOutput))
+            std::cout << "Failed to write " << profileOutput << std::endl;
+        profiler.reset();
     }
 
     // de-allocate all resources once they've outlived their purpose
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    renderer.destroy();
 
     glfwTerminate();
     return 0;
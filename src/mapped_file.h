@@ -0,0 +1,122 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+
+// Read-only memory mapping of a whole file. Pages are faulted in on first access,
+// so nothing is read or copied up front.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile()
+    {
+        close();
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            mapping = other.mapping;
+            length = other.length;
+            other.mapping = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+
+    bool open(const std::string& path)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping stays valid after the descriptor is closed
+        ::close(fd);
+        if (address == MAP_FAILED)
+            return false;
+        mapping = address;
+        length = (size_t)info.st_size;
+        return true;
+    }
+
+    void close()
+    {
+        if (mapping)
+            munmap(mapping, length);
+        mapping = nullptr;
+        length = 0;
+    }
+
+    // hint that the whole file will be read front to back soon
+    void adviseSequential() const
+    {
+        if (mapping)
+        {
+            madvise(mapping, length, MADV_SEQUENTIAL);
+            madvise(mapping, length, MADV_WILLNEED);
+        }
+    }
+
+    // drop the pages of [offset, offset + bytes) that are read and no longer needed; they are read from the file
+    // again if touched, so the mapping stays valid
+    void release(size_t offset, size_t bytes) const
+    {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t begin = (offset + page - 1) / page * page, end = std::min(offset + bytes, length) / page * page;
+        if (mapping && begin < end)
+            madvise(static_cast<char*>(mapping) + begin, end - begin, MADV_DONTNEED);
+    }
+
+    bool isOpen() const { return mapping != nullptr; }
+    const unsigned char* data() const { return static_cast<const unsigned char*>(mapping); }
+    size_t size() const { return length; }
+
+private:
+    void* mapping = nullptr;
+    size_t length = 0;
+};
+
+// Open a new file next to path to write a cache entry into before renaming it over path. The name is made unique
+// by mkstemp, so two processes or threads writing the same entry never truncate each other's file.
+inline FILE* createTemporaryFile(const std::string& path, std::string& temporary)
+{
+    temporary = path + ".XXXXXX";
+    int fd = mkstemp(&temporary[0]);
+    if (fd < 0)
+        return nullptr;
+    // mkstemp creates the file for its owner only, entries are as readable as any other file
+    fchmod(fd, 0644);
+    FILE* file = fdopen(fd, "wb");
+    if (!file)
+    {
+        ::close(fd);
+        std::remove(temporary.c_str());
+    }
+    return file;
+}
+#endif
@@ -0,0 +1,267 @@
+#ifndef MATRIX_KERNELS_H
+#define MATRIX_KERNELS_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// the vector kernels use per-function target attributes, so the rest of the program needs no -mavx2
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define MATRIX_KERNELS_X86 1
+#endif
+
+// translation * rotation * scale as one matrix, without the three matrix products
+inline glm::mat4 composeTransform(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+    glm::mat3 r = glm::mat3_cast(rotation);
+    return glm::mat4(glm::vec4(r[0] * scale.x, 0.0f), glm::vec4(r[1] * scale.y, 0.0f), glm::vec4(r[2] * scale.z, 0.0f),
+                     glm::vec4(translation, 1.0f));
+}
+
+// Implementations of composeMatrices, from the widest the CPU runs down to plain C++
+enum class MatrixKernel
+{
+    Scalar,     // composeTransform per object
+    SSE,        // four objects at a time
+    AVX2        // eight objects at a time
+};
+
+inline const char* matrixKernelName(MatrixKernel kernel)
+{
+    switch (kernel)
+    {
+    case MatrixKernel::SSE: return "sse";
+    case MatrixKernel::AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+// whether this CPU (and OS, for the AVX register state) runs the kernel; asks CPUID
+inline bool matrixKernelSupported(MatrixKernel kernel)
+{
+#ifdef MATRIX_KERNELS_X86
+    if (kernel == MatrixKernel::AVX2)
+        return __builtin_cpu_supports("avx2");
+    if (kernel == MatrixKernel::SSE)
+        return __builtin_cpu_supports("sse2");
+#endif
+    return kernel == MatrixKernel::Scalar;
+}
+
+// the widest supported kernel, looked up once
+inline MatrixKernel bestMatrixKernel()
+{
+    static const MatrixKernel best = matrixKernelSupported(MatrixKernel::AVX2) ? MatrixKernel::AVX2
+                                     : matrixKernelSupported(MatrixKernel::SSE) ? MatrixKernel::SSE
+                                                                                : MatrixKernel::Scalar;
+    return best;
+}
+
+namespace matrix_kernels
+{
+inline void composeScalar(size_t count, const glm::vec3* translations, const glm::quat* rotations, const glm::vec3* scales,
+                          const glm::mat4* prefix, unsigned char* out, size_t stride)
+{
+    for (size_t k = 0; k < count; k++, out += stride)
+    {
+        glm::mat4 m = composeTransform(translations[k], rotations[k], scales[k]);
+        if (prefix)
+            m = *prefix * m;
+        std::memcpy(out, &m, sizeof(glm::mat4));
+    }
+}
+
+#ifdef MATRIX_KERNELS_X86
+// The vector kernels work on structures of arrays: every one of the 16 matrix elements is a register holding it for
+// four or eight objects. They do the same multiplications and additions in the same order as composeTransform and
+// glm's matrix product, without fused multiply-adds, so every kernel writes the same bits.
+
+// m = the 16 elements of four matrices, column major, each register one element of objects 0..3
+__attribute__((target("sse2"))) inline void composeSSE4(const glm::vec3* t, const glm::quat* q, const glm::vec3* s,
+                                                        __m128 m[16])
+{
+    __m128 x = _mm_loadu_ps(&q[0].x), y = _mm_loadu_ps(&q[1].x), z = _mm_loadu_ps(&q[2].x), w = _mm_loadu_ps(&q[3].x);
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+    __m128 qxx = _mm_mul_ps(x, x), qyy = _mm_mul_ps(y, y), qzz = _mm_mul_ps(z, z);
+    __m128 qxz = _mm_mul_ps(x, z), qxy = _mm_mul_ps(x, y), qyz = _mm_mul_ps(y, z);
+    __m128 qwx = _mm_mul_ps(w, x), qwy = _mm_mul_ps(w, y), qwz = _mm_mul_ps(w, z);
+    __m128 sx = _mm_set_ps(s[3].x, s[2].x, s[1].x, s[0].x), sy = _mm_set_ps(s[3].y, s[2].y, s[1].y, s[0].y),
+           sz = _mm_set_ps(s[3].z, s[2].z, s[1].z, s[0].z);
+    m[0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(qyy, qzz))), sx);
+    m[1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(qxy, qwz)), sx);
+    m[2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(qxz, qwy)), sx);
+    m[3] = zero;
+    m[4] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(qxy, qwz)), sy);
+    m[5] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(qxx, qzz))), sy);
+    m[6] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(qyz, qwx)), sy);
+    m[7] = zero;
+    m[8] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(qxz, qwy)), sz);
+    m[9] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(qyz, qwx)), sz);
+    m[10] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(qxx, qyy))), sz);
+    m[11] = zero;
+    m[12] = _mm_set_ps(t[3].x, t[2].x, t[1].x, t[0].x);
+    m[13] = _mm_set_ps(t[3].y, t[2].y, t[1].y, t[0].y);
+    m[14] = _mm_set_ps(t[3].z, t[2].z, t[1].z, t[0].z);
+    m[15] = one;
+}
+
+__attribute__((target("sse2"))) inline void composeSSE(size_t count, const glm::vec3* translations, const glm::quat* rotations,
+                                                       const glm::vec3* scales, const glm::mat4* prefix, unsigned char* out,
+                                                       size_t stride)
+{
+    size_t k = 0;
+    for (; k + 4 <= count; k += 4, out += 4 * stride)
+    {
+        __m128 m[16];
+        composeSSE4(translations + k, rotations + k, scales + k, m);
+        if (prefix)
+        {
+            const glm::mat4& p = *prefix;
+            __m128 product[16];
+            for (int c = 0; c < 4; c++)
+            {
+                for (int r = 0; r < 4; r++)
+                {
+                    __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[0][r]), m[c * 4]),
+                                                       _mm_mul_ps(_mm_set1_ps(p[1][r]), m[c * 4 + 1])),
+                                            _mm_mul_ps(_mm_set1_ps(p[2][r]), m[c * 4 + 2]));
+                    // the last column of the object matrix is (t, 1), the others end in 0
+                    product[c * 4 + r] = c == 3 ? _mm_add_ps(sum, _mm_set1_ps(p[3][r])) : sum;
+                }
+            }
+            std::memcpy(m, product, sizeof(product));
+        }
+        // back to one matrix per object, a column at a time
+        for (int c = 0; c < 4; c++)
+        {
+            __m128 r0 = m[c * 4], r1 = m[c * 4 + 1], r2 = m[c * 4 + 2], r3 = m[c * 4 + 3];
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(reinterpret_cast<float*>(out) + c * 4, r0);
+            _mm_storeu_ps(reinterpret_cast<float*>(out + stride) + c * 4, r1);
+            _mm_storeu_ps(reinterpret_cast<float*>(out + 2 * stride) + c * 4, r2);
+            _mm_storeu_ps(reinterpret_cast<float*>(out + 3 * stride) + c * 4, r3);
+        }
+    }
+    composeScalar(count - k, translations + k, rotations + k, scales + k, prefix, out, stride);
+}
+
+// transpose eight rows of eight: object k gets lane k of every row
+__attribute__((target("avx2"))) inline void transposeAVX2(__m256 row[8])
+{
+    __m256 t0 = _mm256_unpacklo_ps(row[0], row[1]), t1 = _mm256_unpackhi_ps(row[0], row[1]);
+    __m256 t2 = _mm256_unpacklo_ps(row[2], row[3]), t3 = _mm256_unpackhi_ps(row[2], row[3]);
+    __m256 t4 = _mm256_unpacklo_ps(row[4], row[5]), t5 = _mm256_unpackhi_ps(row[4], row[5]);
+    __m256 t6 = _mm256_unpacklo_ps(row[6], row[7]), t7 = _mm256_unpackhi_ps(row[6], row[7]);
+    __m256 u0 = _mm256_shuffle_ps(t0, t2, 0x44), u1 = _mm256_shuffle_ps(t0, t2, 0xee);
+    __m256 u2 = _mm256_shuffle_ps(t1, t3, 0x44), u3 = _mm256_shuffle_ps(t1, t3, 0xee);
+    __m256 u4 = _mm256_shuffle_ps(t4, t6, 0x44), u5 = _mm256_shuffle_ps(t4, t6, 0xee);
+    __m256 u6 = _mm256_shuffle_ps(t5, t7, 0x44), u7 = _mm256_shuffle_ps(t5, t7, 0xee);
+    row[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+    row[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+    row[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+    row[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+    row[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+    row[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+    row[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+    row[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+
+__attribute__((target("avx2"))) inline void composeAVX2(size_t count, const glm::vec3* translations, const glm::quat* rotations,
+                                                        const glm::vec3* scales, const glm::mat4* prefix, unsigned char* out,
+                                                        size_t stride)
+{
+    const __m256i vec3Index = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    size_t k = 0;
+    for (; k + 8 <= count; k += 8, out += 8 * stride)
+    {
+        // quaternions 0-3 and 4-7 as two transposes of four in the two lanes
+        const float* q = &rotations[k].x;
+        __m256 a = _mm256_loadu_ps(q), b = _mm256_loadu_ps(q + 8), c = _mm256_loadu_ps(q + 16), d = _mm256_loadu_ps(q + 24);
+        __m256 r0 = _mm256_permute2f128_ps(a, c, 0x20), r1 = _mm256_permute2f128_ps(a, c, 0x31);
+        __m256 r2 = _mm256_permute2f128_ps(b, d, 0x20), r3 = _mm256_permute2f128_ps(b, d, 0x31);
+        __m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpackhi_ps(r0, r1);
+        __m256 t2 = _mm256_unpacklo_ps(r2, r3), t3 = _mm256_unpackhi_ps(r2, r3);
+        __m256 x = _mm256_shuffle_ps(t0, t2, 0x44), y = _mm256_shuffle_ps(t0, t2, 0xee);
+        __m256 z = _mm256_shuffle_ps(t1, t3, 0x44), w = _mm256_shuffle_ps(t1, t3, 0xee);
+
+        const float* t = &translations[k].x;
+        const float* s = &scales[k].x;
+        __m256 sx = _mm256_i32gather_ps(s, vec3Index, 4), sy = _mm256_i32gather_ps(s + 1, vec3Index, 4),
+               sz = _mm256_i32gather_ps(s + 2, vec3Index, 4);
+
+        __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), zero = _mm256_setzero_ps();
+        __m256 qxx = _mm256_mul_ps(x, x), qyy = _mm256_mul_ps(y, y), qzz = _mm256_mul_ps(z, z);
+        __m256 qxz = _mm256_mul_ps(x, z), qxy = _mm256_mul_ps(x, y), qyz = _mm256_mul_ps(y, z);
+        __m256 qwx = _mm256_mul_ps(w, x), qwy = _mm256_mul_ps(w, y), qwz = _mm256_mul_ps(w, z);
+        __m256 m[16];
+        m[0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(qyy, qzz))), sx);
+        m[1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(qxy, qwz)), sx);
+        m[2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(qxz, qwy)), sx);
+        m[3] = zero;
+        m[4] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(qxy, qwz)), sy);
+        m[5] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(qxx, qzz))), sy);
+        m[6] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(qyz, qwx)), sy);
+        m[7] = zero;
+        m[8] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(qxz, qwy)), sz);
+        m[9] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(qyz, qwx)), sz);
+        m[10] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(qxx, qyy))), sz);
+        m[11] = zero;
+        m[12] = _mm256_i32gather_ps(t, vec3Index, 4);
+        m[13] = _mm256_i32gather_ps(t + 1, vec3Index, 4);
+        m[14] = _mm256_i32gather_ps(t + 2, vec3Index, 4);
+        m[15] = one;
+
+        if (prefix)
+        {
+            const glm::mat4& p = *prefix;
+            __m256 product[16];
+            for (int col = 0; col < 4; col++)
+            {
+                for (int row = 0; row < 4; row++)
+                {
+                    __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p[0][row]), m[col * 4]),
+                                                             _mm256_mul_ps(_mm256_set1_ps(p[1][row]), m[col * 4 + 1])),
+                                               _mm256_mul_ps(_mm256_set1_ps(p[2][row]), m[col * 4 + 2]));
+                    product[col * 4 + row] = col == 3 ? _mm256_add_ps(sum, _mm256_set1_ps(p[3][row])) : sum;
+                }
+            }
+            std::memcpy(m, product, sizeof(product));
+        }
+
+        // columns 0 and 1, then 2 and 3, of the eight objects
+        transposeAVX2(m);
+        transposeAVX2(m + 8);
+        for (int object = 0; object < 8; object++)
+        {
+            float* matrix = reinterpret_cast<float*>(out + object * stride);
+            _mm256_storeu_ps(matrix, m[object]);
+            _mm256_storeu_ps(matrix + 8, m[8 + object]);
+        }
+    }
+    composeScalar(count - k, translations + k, rotations + k, scales + k, prefix, out, stride);
+}
+#endif
+}
+
+// Model matrices of count objects from arrays of translations, rotations and scales, each
+// prefix * composeTransform(translations[k], rotations[k], scales[k]) (prefix may be null, or e.g. the view projection
+// matrix for MVP matrices). Matrix k goes to out + k * stride, so the output can be a plain array, instance data or
+// std140 blocks in a mapped buffer. Every kernel writes the same bits; the default is the widest the CPU runs.
+inline void composeMatrices(size_t count, const glm::vec3* translations, const glm::quat* rotations, const glm::vec3* scales,
+                            const glm::mat4* prefix, void* out, size_t stride, MatrixKernel kernel = bestMatrixKernel())
+{
+    unsigned char* bytes = static_cast<unsigned char*>(out);
+#ifdef MATRIX_KERNELS_X86
+    if (kernel == MatrixKernel::AVX2)
+        return matrix_kernels::composeAVX2(count, translations, rotations, scales, prefix, bytes, stride);
+    if (kernel == MatrixKernel::SSE)
+        return matrix_kernels::composeSSE(count, translations, rotations, scales, prefix, bytes, stride);
+#endif
+    matrix_kernels::composeScalar(count, translations, rotations, scales, prefix, bytes, stride);
+}
+#endif
@@ -0,0 +1,346 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "hash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// vertex of the textured mesh path, laid out like the attribute pointers expect: position (location 0), uv (location 1)
+struct MeshVertex
+{
+    glm::vec3 position;
+    glm::vec2 texCoord;
+};
+
+// Vertices plus a triangle list index buffer. Indices are kept 32-bit on the CPU and narrowed
+// to 16-bit on upload whenever every vertex is reachable with 16 bits.
+struct IndexedMesh
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+
+    GLenum indexType() const
+    {
+        return vertices.size() <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+    size_t indexSize() const
+    {
+        return indexType() == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+};
+
+// what the mesh building stage did, printed at startup
+struct MeshStats
+{
+    size_t inputVertices = 0;
+    size_t weldedVertices = 0;
+    size_t triangles = 0;
+    float acmrBefore = 0.0f;    // average cache miss ratio (post-transform cache misses per triangle)
+    float acmrAfter = 0.0f;
+    bool index16 = true;
+    std::string vertexFormat = "Pos_Float3 + UV_Float2";  // as uploaded
+    size_t vertexStride = 5 * sizeof(float);
+
+    void print(std::ostream& out) const
+    {
+        out << "mesh: " << inputVertices << " -> " << weldedVertices << " vertices, " << triangles << " triangles, "
+            << (index16 ? "16" : "32") << "-bit indices, ACMR " << acmrBefore << " -> " << acmrAfter << ", vertices "
+            << vertexFormat << " (" << vertexStride << " bytes, " << weldedVertices * vertexStride / 1024.0 << " KB)" << std::endl;
+    }
+};
+
+// Post-transform cache simulation: a FIFO of cacheSize vertices, like most hardware.
+// Returns misses per triangle; 0.5 is the ideal for large regular meshes, 3.0 means no reuse at all.
+inline float averageCacheMissRatio(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned int cacheSize = 16)
+{
+    if (indices.empty())
+        return 0.0f;
+    std::vector<unsigned long long> insertedAt(vertexCount, 0);   // 0 = never in the cache
+    unsigned long long clock = 0;
+    size_t misses = 0;
+    for (uint32_t index : indices)
+    {
+        // a vertex is still cached if fewer than cacheSize others were inserted after it
+        if (insertedAt[index] == 0 || clock - insertedAt[index] >= cacheSize)
+        {
+            misses++;
+            insertedAt[index] = ++clock;
+        }
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+// Weld identical vertices: every distinct position + uv pair is stored once and referenced by index.
+// Vertices compare by bit pattern (after folding -0 into +0), so only exact duplicates are merged.
+inline IndexedMesh weldVertices(const MeshVertex* vertices, size_t vertexCount)
+{
+    struct Key
+    {
+        uint32_t bits[5];
+        bool operator==(const Key& other) const { return std::memcmp(bits, other.bits, sizeof(bits)) == 0; }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const { return (size_t)fnv1a64(key.bits, sizeof(key.bits)); }
+    };
+
+    IndexedMesh mesh;
+    mesh.indices.reserve(vertexCount);
+    std::unordered_map<Key, uint32_t, KeyHash> unique;
+    unique.reserve(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const float values[5] = { vertices[i].position.x, vertices[i].position.y, vertices[i].position.z,
+                                  vertices[i].texCoord.x, vertices[i].texCoord.y };
+        Key key;
+        for (int c = 0; c < 5; c++)
+        {
+            float value = values[c] == 0.0f ? 0.0f : values[c];
+            std::memcpy(&key.bits[c], &value, sizeof(float));
+        }
+        auto inserted = unique.emplace(key, (uint32_t)mesh.vertices.size());
+        if (inserted.second)
+            mesh.vertices.push_back(vertices[i]);
+        mesh.indices.push_back(inserted.first->second);
+    }
+    return mesh;
+}
+
+// Reorder triangles for the post-transform vertex cache (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation").
+// Greedily emits the best scoring triangle, where a vertex scores high if it is recently used (in a simulated
+// LRU cache) and has few triangles left. Runs in linear time in the number of triangles.
+inline void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    const int CacheSize = 32;
+    const float CacheDecayPower = 1.5f;
+    const float LastTriangleScore = 0.75f;
+    const float ValenceBoostScale = 2.0f;
+    const float ValenceBoostPower = 0.5f;
+
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    auto vertexScore = [&](int cachePosition, unsigned int remaining) -> float
+    {
+        if (remaining == 0)
+            return -1.0f;   // no triangles left, never picked again
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+            {
+                // the vertices of the triangle just emitted get a fixed score so the next one does not simply
+                // reuse the same edge
+                score = LastTriangleScore;
+            }
+            else
+            {
+                float scaler = 1.0f / (CacheSize - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+            }
+        }
+        // boost vertices with few triangles left so lone triangles do not get stranded
+        score += ValenceBoostScale * std::pow((float)remaining, -ValenceBoostPower);
+        return score;
+    };
+
+    // vertex -> triangle adjacency in one flat array
+    std::vector<unsigned int> remaining(vertexCount, 0), offsets(vertexCount + 1, 0);
+    for (uint32_t index : indices)
+        remaining[index]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    std::vector<uint32_t> cache, nextCache;
+    cache.reserve(CacheSize + 3);
+    size_t scanCursor = 0;  // for the (rare) full scans when the cache offers no candidate
+
+    long long best = 0;
+    for (size_t t = 1; t < triangleCount; t++)
+    {
+        if (triangleScore[t] > triangleScore[best])
+            best = (long long)t;
+    }
+
+    while (best >= 0)
+    {
+        emitted[best] = true;
+        const uint32_t* triangle = &indices[best * 3];
+
+        // emit and move its vertices to the front of the cache
+        nextCache.assign(triangle, triangle + 3);
+        for (int k = 0; k < 3; k++)
+        {
+            output.push_back(triangle[k]);
+            // drop the triangle from the vertex's adjacency
+            uint32_t v = triangle[k];
+            unsigned int begin = offsets[v], end = begin + remaining[v];
+            for (unsigned int a = begin; a < end; a++)
+            {
+                if (adjacency[a] == (uint32_t)best)
+                {
+                    std::swap(adjacency[a], adjacency[end - 1]);
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+        for (uint32_t v : cache)
+        {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                nextCache.push_back(v);
+        }
+        // vertices pushed past the end fall out of the cache
+        for (size_t i = CacheSize; i < nextCache.size(); i++)
+        {
+            cachePosition[nextCache[i]] = -1;
+            score[nextCache[i]] = vertexScore(-1, remaining[nextCache[i]]);
+        }
+        if (nextCache.size() > (size_t)CacheSize)
+            nextCache.resize(CacheSize);
+        cache.swap(nextCache);
+
+        // rescore cached vertices and their triangles, picking the best candidate on the way
+        for (size_t i = 0; i < cache.size(); i++)
+        {
+            cachePosition[cache[i]] = (int)i;
+            score[cache[i]] = vertexScore((int)i, remaining[cache[i]]);
+        }
+        best = -1;
+        float bestScore = -1.0f;
+        for (uint32_t v : cache)
+        {
+            for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+            {
+                uint32_t t = adjacency[a];
+                triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = (long long)t;
+                }
+            }
+        }
+
+        // nothing left around the cache: continue with the next unemitted triangle
+        if (best < 0)
+        {
+            while (scanCursor < triangleCount && emitted[scanCursor])
+                scanCursor++;
+            if (scanCursor < triangleCount)
+                best = (long long)scanCursor;
+        }
+    }
+    indices.swap(output);
+}
+
+// Reorder vertices into first-use order of the (optimized) index buffer, so vertex fetches walk memory linearly
+inline void optimizeVertexFetch(IndexedMesh& mesh)
+{
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<MeshVertex> ordered;
+    ordered.reserve(mesh.vertices.size());
+    for (uint32_t& index : mesh.indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = (uint32_t)ordered.size();
+            ordered.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(ordered);
+}
+
+// Triangle soup of a UV sphere around the origin: segments around the axis, rings from pole to pole.
+// u follows the longitude and v the latitude, so the texture wraps once around with a seam at u = 0.
+inline std::vector<MeshVertex> uvSphere(unsigned int segments, unsigned int rings, float radius)
+{
+    const float pi = 3.14159265358979f;
+    auto vertex = [&](unsigned int segment, unsigned int ring)
+    {
+        float u = (float)segment / segments, v = (float)ring / rings;
+        float theta = u * 2.0f * pi, phi = v * pi;
+        glm::vec3 position(std::sin(phi) * std::cos(theta), -std::cos(phi), std::sin(phi) * std::sin(theta));
+        return MeshVertex{ position * radius, glm::vec2(u, v) };
+    };
+    std::vector<MeshVertex> vertices;
+    vertices.reserve((size_t)segments * rings * 6);
+    for (unsigned int ring = 0; ring < rings; ring++)
+    {
+        for (unsigned int segment = 0; segment < segments; segment++)
+        {
+            MeshVertex a = vertex(segment, ring), b = vertex(segment + 1, ring);
+            MeshVertex c = vertex(segment + 1, ring + 1), d = vertex(segment, ring + 1);
+            // the quads at the poles degenerate into one triangle
+            if (ring > 0)
+                vertices.insert(vertices.end(), { a, c, b });
+            if (ring + 1 < rings)
+                vertices.insert(vertices.end(), { a, d, c });
+        }
+    }
+    return vertices;
+}
+
+// The full mesh building stage: weld, optimize for the vertex cache, then for vertex fetch
+inline IndexedMesh buildIndexedMesh(const MeshVertex* vertices, size_t vertexCount, MeshStats* stats = nullptr)
+{
+    IndexedMesh mesh = weldVertices(vertices, vertexCount);
+    float acmrBefore = averageCacheMissRatio(mesh.indices, mesh.vertices.size());
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeVertexFetch(mesh);
+    if (stats)
+    {
+        stats->inputVertices = vertexCount;
+        stats->weldedVertices = mesh.vertices.size();
+        stats->triangles = mesh.indices.size() / 3;
+        stats->acmrBefore = acmrBefore;
+        stats->acmrAfter = averageCacheMissRatio(mesh.indices, mesh.vertices.size());
+        stats->index16 = mesh.indexType() == GL_UNSIGNED_SHORT;
+    }
+    return mesh;
+}
+
+// Upload the index buffer to the bound GL_ELEMENT_ARRAY_BUFFER, narrowed to 16-bit when possible
+inline void uploadIndices(const IndexedMesh& mesh)
+{
+    if (mesh.indexType() == GL_UNSIGNED_SHORT)
+    {
+        std::vector<uint16_t> narrow(mesh.indices.begin(), mesh.indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, narrow.size() * sizeof(uint16_t), narrow.data(), GL_STATIC_DRAW);
+    }
+    else
+    {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), mesh.indices.data(), GL_STATIC_DRAW);
+    }
+}
+#endif
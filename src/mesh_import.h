@@ -0,0 +1,837 @@
+#ifndef MESH_IMPORT_H
+#define MESH_IMPORT_H
+
+#include <glm/glm.hpp>
+
+#include "mapped_file.h"
+#include "mesh.h"
+#include "number_parse.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Center triangles on the origin and scale them uniformly so the largest side is 1, the size of the cube they
+// replace; planarTexCoords: also project x and y onto the texture, for files without texture coordinates
+inline void fitUnitCube(std::vector<MeshVertex>& vertices, bool planarTexCoords)
+{
+    if (vertices.empty())
+        return;
+    glm::vec3 lo = vertices[0].position, hi = vertices[0].position;
+    for (const MeshVertex& v : vertices)
+    {
+        lo = glm::min(lo, v.position);
+        hi = glm::max(hi, v.position);
+    }
+    glm::vec3 center = 0.5f * (lo + hi), extent = hi - lo;
+    float scale = 1.0f / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+    for (MeshVertex& v : vertices)
+    {
+        v.position = (v.position - center) * scale;
+        if (planarTexCoords)
+            v.texCoord = glm::vec2(v.position.x, v.position.y) + 0.5f;
+    }
+}
+
+// what an import did, valid once it finished
+struct ImportStats
+{
+    std::string path;
+    size_t bytes = 0;
+    size_t vertices = 0;        // as stored in the file
+    size_t triangles = 0;
+    size_t skippedFaces = 0;    // with indices out of range
+    size_t chunks = 0;
+    unsigned int threads = 0;
+    double seconds = 0.0;       // map to last merged chunk
+    double firstGeometrySeconds = 0.0;
+
+    void print(std::ostream& out) const
+    {
+        double s = seconds > 0.0 ? seconds : 1e-9;
+        out << "import: " << path << ", " << bytes / 1048576.0 << " MB in " << seconds * 1000.0 << " ms ("
+            << bytes / 1048576.0 / s << " MB/s), " << triangles << " triangles (" << triangles / s / 1e6
+            << " M triangles/s), first geometry after " << firstGeometrySeconds * 1000.0 << " ms, " << chunks
+            << " chunks on " << threads << (threads == 1 ? " thread" : " threads");
+        if (skippedFaces)
+            out << ", " << skippedFaces << " faces with invalid indices skipped";
+        out << std::endl;
+    }
+};
+
+// Imports OBJ, ASCII and binary PLY, and binary STL meshes as triangle soup, in the background.
+// The file is memory mapped and cut into chunks of about ChunkBytes at line or record boundaries. Worker threads
+// parse chunks in parallel into chunk-local vertex and corner lists; a chunk is then merged as soon as every chunk
+// before it is: its vertices are appended to the file-wide arrays and its faces resolved against them into
+// triangles. Merging strictly in file order makes the result the same for any thread count, and it lets the renderer
+// pick up the triangles of every merged chunk while later ones are still being parsed.
+// Faces are fan triangulated. Files without texture coordinates get (0, 0) at every corner.
+class MeshImporter
+{
+public:
+    static const size_t ChunkBytes = 4 << 20;
+
+    // start importing path; workers: parser threads (0 = one per hardware thread)
+    explicit MeshImporter(const std::string& path, unsigned int workers = 0)
+    {
+        stats.path = path;
+        stats.threads = workers > 0 ? workers : std::max(1u, std::thread::hardware_concurrency());
+        controller = std::thread(&MeshImporter::run, this);
+    }
+
+    ~MeshImporter()
+    {
+        cancelled.store(true);
+        if (controller.joinable())
+            controller.join();
+    }
+
+    MeshImporter(const MeshImporter&) = delete;
+    MeshImporter& operator=(const MeshImporter&) = delete;
+
+    // chunks whose triangles are final; chunkTriangles(k) for k below this may be read from any thread
+    size_t mergedChunks() const
+    {
+        return merged.load(std::memory_order_acquire);
+    }
+    const std::vector<MeshVertex>& chunkTriangles(size_t chunk) const
+    {
+        return chunks[chunk].triangles;
+    }
+
+    // all chunks merged, or the import failed
+    bool finished() const
+    {
+        return done.load(std::memory_order_acquire);
+    }
+    // the reason the import failed, empty if it did not; valid once finished
+    const std::string& error() const
+    {
+        return failure;
+    }
+    // whether the file had texture coordinates; valid once finished
+    bool hasTexCoords() const
+    {
+        return !texCoords.empty();
+    }
+    const ImportStats& importStats() const
+    {
+        return stats;
+    }
+
+    // every triangle in file order, once finished; releases the chunks
+    std::vector<MeshVertex> takeTriangles()
+    {
+        std::vector<MeshVertex> all;
+        all.reserve(stats.triangles * 3);
+        for (Chunk& chunk : chunks)
+        {
+            all.insert(all.end(), chunk.triangles.begin(), chunk.triangles.end());
+            std::vector<MeshVertex>().swap(chunk.triangles);
+        }
+        return all;
+    }
+
+private:
+    static const int32_t NoIndex = INT32_MIN;
+
+    // a triangle corner: indices into the file-wide positions and texture coordinates (0-based)
+    struct Corner
+    {
+        int32_t position;
+        int32_t texCoord;   // NoIndex if none
+    };
+
+    enum class ChunkKind : uint8_t { Obj, PlyAsciiVertices, PlyAsciiFaces, PlyBinaryVertices, PlyBinaryFaces, Stl };
+
+    struct Chunk
+    {
+        ChunkKind kind;
+        const char* begin;
+        const char* end;
+        size_t records;     // binary chunks
+        bool parsed = false;
+        // parse output, released by the merge
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> texCoords;
+        std::vector<Corner> corners;
+        std::vector<uint32_t> relativePositions, relativeTexCoords;    // corners counting from the chunk's first vertex
+        // merge output
+        std::vector<MeshVertex> triangles;
+    };
+
+    enum class PlyType : uint8_t { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid };
+    struct PlyProperty
+    {
+        std::string name;
+        PlyType type = PlyType::Invalid;
+        bool list = false;
+        PlyType countType = PlyType::Invalid;
+    };
+    struct PlyElement
+    {
+        std::string name;
+        size_t count = 0;
+        std::vector<PlyProperty> properties;
+    };
+
+    MappedFile file;
+    std::vector<Chunk> chunks;
+    std::atomic<size_t> nextChunk{ 0 };
+    std::atomic<size_t> merged{ 0 };
+    std::atomic<bool> done{ false }, cancelled{ false };
+    std::thread controller;
+    std::mutex mergeMutex;
+    bool merging = false;
+    size_t mergeCursor = 0;     // guarded by mergeMutex
+    std::chrono::steady_clock::time_point start;
+    std::string failure;
+    ImportStats stats;
+
+    // file-wide arrays, only touched by the thread merging
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+
+    // PLY layout
+    bool plyBigEndian = false;
+    std::vector<PlyProperty> plyVertexProperties, plyFaceProperties;
+    int plyX = -1, plyY = -1, plyZ = -1, plyU = -1, plyV = -1, plyFaceList = -1;
+    size_t plyVertexStride = 0;
+
+    void run()
+    {
+        start = std::chrono::steady_clock::now();
+        if (!file.open(stats.path))
+            failure = "cannot open " + stats.path;
+        else
+        {
+            file.adviseSequential();
+            stats.bytes = file.size();
+            std::string extension = stats.path.substr(std::min(stats.path.size(), stats.path.rfind('.') + 1));
+            std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+            if (extension == "obj")
+                planObj();
+            else if (extension == "ply")
+                planPly();
+            else if (extension == "stl")
+                planStl();
+            else
+                failure = "unknown mesh format " + stats.path;
+        }
+
+        if (failure.empty())
+        {
+            stats.chunks = chunks.size();
+            unsigned int helpers = (unsigned int)std::min<size_t>(stats.threads, chunks.size());
+            std::vector<std::thread> workers;
+            for (unsigned int i = 1; i < helpers; i++)
+                workers.emplace_back(&MeshImporter::work, this);
+            work();
+            for (std::thread& worker : workers)
+                worker.join();
+            stats.vertices = positions.size();
+            std::vector<glm::vec3>().swap(positions);
+        }
+        else
+        {
+            chunks.clear();
+        }
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        done.store(true, std::memory_order_release);
+    }
+
+    // parse chunks until none are left, merging whatever became mergeable
+    void work()
+    {
+        for (size_t k = nextChunk.fetch_add(1); k < chunks.size() && !cancelled.load(); k = nextChunk.fetch_add(1))
+        {
+            parseChunk(chunks[k]);
+            std::unique_lock<std::mutex> lock(mergeMutex);
+            chunks[k].parsed = true;
+            // another thread is merging and will get to this chunk
+            if (merging)
+                continue;
+            merging = true;
+            while (mergeCursor < chunks.size() && chunks[mergeCursor].parsed)
+            {
+                size_t next = mergeCursor;
+                lock.unlock();
+                mergeChunk(chunks[next]);
+                lock.lock();
+                mergeCursor = next + 1;
+                merged.store(mergeCursor, std::memory_order_release);
+            }
+            merging = false;
+        }
+    }
+
+    // append the chunk's vertices to the file-wide arrays and resolve its faces into triangles
+    void mergeChunk(Chunk& chunk)
+    {
+        int64_t positionBase = (int64_t)positions.size(), texCoordBase = (int64_t)texCoords.size();
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+        std::vector<glm::vec3>().swap(chunk.positions);
+        std::vector<glm::vec2>().swap(chunk.texCoords);
+        for (uint32_t corner : chunk.relativePositions)
+            chunk.corners[corner].position = (int32_t)(chunk.corners[corner].position + positionBase);
+        for (uint32_t corner : chunk.relativeTexCoords)
+            chunk.corners[corner].texCoord = (int32_t)(chunk.corners[corner].texCoord + texCoordBase);
+
+        if (!chunk.corners.empty())
+        {
+            int64_t positionCount = (int64_t)positions.size(), texCoordCount = (int64_t)texCoords.size();
+            chunk.triangles.reserve(chunk.corners.size());
+            for (size_t k = 0; k + 2 < chunk.corners.size(); k += 3)
+            {
+                bool valid = true;
+                for (size_t c = k; c < k + 3; c++)
+                {
+                    const Corner& corner = chunk.corners[c];
+                    valid = valid && corner.position >= 0 && corner.position < positionCount &&
+                            (corner.texCoord == NoIndex || (corner.texCoord >= 0 && corner.texCoord < texCoordCount));
+                }
+                if (!valid)
+                {
+                    stats.skippedFaces++;
+                    continue;
+                }
+                for (size_t c = k; c < k + 3; c++)
+                {
+                    const Corner& corner = chunk.corners[c];
+                    chunk.triangles.push_back(MeshVertex{ positions[corner.position],
+                        corner.texCoord == NoIndex ? glm::vec2(0.0f) : texCoords[corner.texCoord] });
+                }
+            }
+            std::vector<Corner>().swap(chunk.corners);
+            std::vector<uint32_t>().swap(chunk.relativePositions);
+            std::vector<uint32_t>().swap(chunk.relativeTexCoords);
+        }
+
+        if (!chunk.triangles.empty() && stats.triangles == 0)
+            stats.firstGeometrySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.triangles += chunk.triangles.size() / 3;
+    }
+
+    void parseChunk(Chunk& chunk)
+    {
+        switch (chunk.kind)
+        {
+        case ChunkKind::Obj: parseObj(chunk); break;
+        case ChunkKind::PlyAsciiVertices: parsePlyAsciiVertices(chunk); break;
+        case ChunkKind::PlyAsciiFaces: parsePlyAsciiFaces(chunk); break;
+        case ChunkKind::PlyBinaryVertices: parsePlyBinaryVertices(chunk); break;
+        case ChunkKind::PlyBinaryFaces: parsePlyBinaryFaces(chunk); break;
+        case ChunkKind::Stl: parseStl(chunk); break;
+        }
+    }
+
+    // cut [begin, end) into chunks of about ChunkBytes that end after a newline
+    void planLines(ChunkKind kind, const char* begin, const char* end)
+    {
+        while (begin < end)
+        {
+            const char* cut = end;
+            if ((size_t)(end - begin) > ChunkBytes)
+            {
+                const char* newline = static_cast<const char*>(std::memchr(begin + ChunkBytes, '\n', (size_t)(end - begin - ChunkBytes)));
+                cut = newline ? newline + 1 : end;
+            }
+            addChunk(kind, begin, cut, 0);
+            begin = cut;
+        }
+    }
+
+    void addChunk(ChunkKind kind, const char* begin, const char* end, size_t records)
+    {
+        chunks.emplace_back();
+        Chunk& chunk = chunks.back();
+        chunk.kind = kind;
+        chunk.begin = begin;
+        chunk.end = end;
+        chunk.records = records;
+    }
+
+    static const char* nextLine(const char* p, const char* end)
+    {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', (size_t)(end - p)));
+        return newline ? newline + 1 : end;
+    }
+
+    // OBJ
+    // ------------------------------------------------------------------------
+    void planObj()
+    {
+        const char* begin = reinterpret_cast<const char*>(file.data());
+        planLines(ChunkKind::Obj, begin, begin + file.size());
+    }
+
+    // v, vt and f lines; everything else (normals, groups, materials, comments) is skipped
+    void parseObj(Chunk& chunk)
+    {
+        std::vector<Corner> polygon;
+        std::vector<bool> relative;     // per corner: position, texture coordinate
+        for (const char* p = chunk.begin; p < chunk.end; )
+        {
+            const char* lineEnd = nextLine(p, chunk.end);
+            while (p < lineEnd && (*p == ' ' || *p == '\t'))
+                p++;
+            if (lineEnd - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+            {
+                glm::vec3 position(0.0f);
+                const char* q = p + 1;
+                for (int i = 0; i < 3 && q; i++)
+                    q = parseFloat(q, lineEnd, position[i]);
+                chunk.positions.push_back(position);
+            }
+            else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t'))
+            {
+                glm::vec2 texCoord(0.0f);
+                const char* q = p + 2;
+                for (int i = 0; i < 2 && q; i++)
+                    q = parseFloat(q, lineEnd, texCoord[i]);
+                chunk.texCoords.push_back(texCoord);
+            }
+            else if (lineEnd - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+            {
+                // v, v/vt, v//vn or v/vt/vn per corner; negative indices count back from the last vertex so far
+                polygon.clear();
+                relative.clear();
+                const char* q = p + 1;
+                long long index = 0;
+                while ((q = parseInt(q, lineEnd, index)) != nullptr)
+                {
+                    Corner corner{ NoIndex, NoIndex };
+                    bool relativePosition = index < 0, relativeTexCoord = false;
+                    corner.position = (int32_t)(index < 0 ? (long long)chunk.positions.size() + index : index - 1);
+                    if (q < lineEnd && *q == '/')
+                    {
+                        q++;
+                        long long texCoord = 0;
+                        const char* r = parseInt(q, lineEnd, texCoord);
+                        if (r)
+                        {
+                            relativeTexCoord = texCoord < 0;
+                            corner.texCoord = (int32_t)(texCoord < 0 ? (long long)chunk.texCoords.size() + texCoord : texCoord - 1);
+                            q = r;
+                        }
+                        if (q < lineEnd && *q == '/')
+                        {
+                            long long normal = 0;
+                            const char* r2 = parseInt(q + 1, lineEnd, normal);
+                            q = r2 ? r2 : q + 1;
+                        }
+                    }
+                    polygon.push_back(corner);
+                    relative.push_back(relativePosition);
+                    relative.push_back(relativeTexCoord);
+                }
+                for (size_t i = 2; i < polygon.size(); i++)
+                {
+                    size_t fan[3] = { 0, i - 1, i };
+                    for (size_t f : fan)
+                    {
+                        if (relative[2 * f])
+                            chunk.relativePositions.push_back((uint32_t)chunk.corners.size());
+                        if (relative[2 * f + 1])
+                            chunk.relativeTexCoords.push_back((uint32_t)chunk.corners.size());
+                        chunk.corners.push_back(polygon[f]);
+                    }
+                }
+            }
+            p = lineEnd;
+        }
+    }
+
+    // PLY
+    // ------------------------------------------------------------------------
+    static PlyType plyType(const std::string& name)
+    {
+        if (name == "char" || name == "int8") return PlyType::Int8;
+        if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+        if (name == "short" || name == "int16") return PlyType::Int16;
+        if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+        if (name == "int" || name == "int32") return PlyType::Int32;
+        if (name == "uint" || name == "uint32") return PlyType::UInt32;
+        if (name == "float" || name == "float32") return PlyType::Float32;
+        if (name == "double" || name == "float64") return PlyType::Float64;
+        return PlyType::Invalid;
+    }
+
+    static size_t plySize(PlyType type)
+    {
+        static const size_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+        return sizes[(int)type];
+    }
+
+    double plyValue(const char* p, PlyType type) const
+    {
+        unsigned char bytes[8];
+        size_t size = plySize(type);
+        std::memcpy(bytes, p, size);
+        if (plyBigEndian)
+            std::reverse(bytes, bytes + size);
+        switch (type)
+        {
+        case PlyType::Int8: { int8_t v; std::memcpy(&v, bytes, 1); return v; }
+        case PlyType::UInt8: return bytes[0];
+        case PlyType::Int16: { int16_t v; std::memcpy(&v, bytes, 2); return v; }
+        case PlyType::UInt16: { uint16_t v; std::memcpy(&v, bytes, 2); return v; }
+        case PlyType::Int32: { int32_t v; std::memcpy(&v, bytes, 4); return v; }
+        case PlyType::UInt32: { uint32_t v; std::memcpy(&v, bytes, 4); return v; }
+        case PlyType::Float32: { float v; std::memcpy(&v, bytes, 4); return v; }
+        case PlyType::Float64: { double v; std::memcpy(&v, bytes, 8); return v; }
+        default: return 0.0;
+        }
+    }
+
+    // header: format, then the vertex element followed by the face element; later elements are ignored
+    void planPly()
+    {
+        const char* data = reinterpret_cast<const char*>(file.data());
+        const char* end = data + file.size();
+        if (file.size() < 4 || std::memcmp(data, "ply", 3) != 0)
+        {
+            failure = "not a PLY file";
+            return;
+        }
+        bool ascii = false;
+        std::vector<PlyElement> elements;
+        const char* p = nextLine(data, end);
+        const char* body = nullptr;
+        while (p < end)
+        {
+            const char* lineEnd = nextLine(p, end);
+            std::vector<std::string> words;
+            for (const char* q = p; q < lineEnd; )
+            {
+                while (q < lineEnd && (*q == ' ' || *q == '\t' || *q == '\r' || *q == '\n'))
+                    q++;
+                const char* wordEnd = q;
+                while (wordEnd < lineEnd && *wordEnd != ' ' && *wordEnd != '\t' && *wordEnd != '\r' && *wordEnd != '\n')
+                    wordEnd++;
+                if (wordEnd > q)
+                    words.emplace_back(q, wordEnd);
+                q = wordEnd;
+            }
+            p = lineEnd;
+            if (words.empty() || words[0] == "comment" || words[0] == "obj_info")
+                continue;
+            if (words[0] == "end_header")
+            {
+                body = p;
+                break;
+            }
+            if (words[0] == "format" && words.size() >= 2)
+            {
+                ascii = words[1] == "ascii";
+                plyBigEndian = words[1] == "binary_big_endian";
+            }
+            else if (words[0] == "element" && words.size() >= 3)
+            {
+                elements.emplace_back();
+                elements.back().name = words[1];
+                elements.back().count = (size_t)std::strtoull(words[2].c_str(), NULL, 10);
+            }
+            else if (words[0] == "property" && !elements.empty())
+            {
+                PlyProperty property;
+                if (words.size() >= 5 && words[1] == "list")
+                {
+                    property.list = true;
+                    property.countType = plyType(words[2]);
+                    property.type = plyType(words[3]);
+                    property.name = words[4];
+                }
+                else if (words.size() >= 3)
+                {
+                    property.type = plyType(words[1]);
+                    property.name = words[2];
+                }
+                if (property.type == PlyType::Invalid || (property.list && property.countType == PlyType::Invalid))
+                {
+                    failure = "unsupported PLY property type";
+                    return;
+                }
+                elements.back().properties.push_back(property);
+            }
+        }
+        if (!body || elements.size() < 2 || elements[0].name != "vertex" || elements[1].name != "face")
+        {
+            failure = "PLY files need a header with a vertex and then a face element";
+            return;
+        }
+
+        plyVertexProperties = elements[0].properties;
+        plyFaceProperties = elements[1].properties;
+        for (int i = 0; i < (int)plyVertexProperties.size(); i++)
+        {
+            const PlyProperty& property = plyVertexProperties[i];
+            if (property.list)
+            {
+                failure = "list properties in PLY vertices are not supported";
+                return;
+            }
+            const std::string& n = property.name;
+            if (n == "x") plyX = i;
+            else if (n == "y") plyY = i;
+            else if (n == "z") plyZ = i;
+            else if (n == "u" || n == "s" || n == "texture_u" || n == "texture_s") plyU = i;
+            else if (n == "v" || n == "t" || n == "texture_v" || n == "texture_t") plyV = i;
+            plyVertexStride += plySize(property.type);
+        }
+        for (int i = 0; i < (int)plyFaceProperties.size(); i++)
+        {
+            if (plyFaceProperties[i].list && (plyFaceProperties[i].name == "vertex_indices" || plyFaceProperties[i].name == "vertex_index"))
+                plyFaceList = i;
+        }
+        if (plyX < 0 || plyY < 0 || plyZ < 0 || plyFaceList < 0)
+        {
+            failure = "PLY vertices need x, y and z and faces vertex_indices";
+            return;
+        }
+
+        size_t vertexCount = elements[0].count, faceCount = elements[1].count;
+        if (ascii)
+        {
+            // the vertex lines end where the face lines start
+            const char* facesBegin = body;
+            for (size_t i = 0; i < vertexCount && facesBegin < end; i++)
+                facesBegin = nextLine(facesBegin, end);
+            const char* facesEnd = facesBegin;
+            for (size_t i = 0; i < faceCount && facesEnd < end; i++)
+                facesEnd = nextLine(facesEnd, end);
+            planLines(ChunkKind::PlyAsciiVertices, body, facesBegin);
+            planLines(ChunkKind::PlyAsciiFaces, facesBegin, facesEnd);
+            return;
+        }
+
+        // binary vertices have a fixed size; faces are walked once to find record boundaries
+        if ((size_t)(end - body) < vertexCount * plyVertexStride)
+        {
+            failure = "PLY file is truncated";
+            return;
+        }
+        size_t perChunk = std::max<size_t>(1, ChunkBytes / std::max<size_t>(plyVertexStride, 1));
+        for (size_t first = 0; first < vertexCount; first += perChunk)
+        {
+            size_t records = std::min(perChunk, vertexCount - first);
+            const char* begin = body + first * plyVertexStride;
+            addChunk(ChunkKind::PlyBinaryVertices, begin, begin + records * plyVertexStride, records);
+        }
+        const char* p2 = body + vertexCount * plyVertexStride;
+        const char* chunkBegin = p2;
+        size_t records = 0;
+        for (size_t face = 0; face < faceCount; face++)
+        {
+            // every read is bounded here, so parsePlyBinaryFaces can walk the records without checks
+            for (const PlyProperty& property : plyFaceProperties)
+            {
+                size_t left = (size_t)(end - p2);
+                size_t valueBytes = plySize(property.type);
+                if (!property.list)
+                {
+                    if (left < valueBytes)
+                    {
+                        failure = "PLY file is truncated";
+                        return;
+                    }
+                    p2 += valueBytes;
+                    continue;
+                }
+                size_t countBytes = plySize(property.countType);
+                if (left < countBytes)
+                {
+                    failure = "PLY file is truncated";
+                    return;
+                }
+                double count = plyValue(p2, property.countType);
+                if (!(count >= 0.0))
+                {
+                    failure = "PLY face has an invalid vertex count";
+                    return;
+                }
+                if (count > (double)((left - countBytes) / valueBytes))
+                {
+                    failure = "PLY file is truncated";
+                    return;
+                }
+                p2 += countBytes + (size_t)count * valueBytes;
+            }
+            records++;
+            if ((size_t)(p2 - chunkBegin) >= ChunkBytes)
+            {
+                addChunk(ChunkKind::PlyBinaryFaces, chunkBegin, p2, records);
+                chunkBegin = p2;
+                records = 0;
+            }
+        }
+        if (records)
+            addChunk(ChunkKind::PlyBinaryFaces, chunkBegin, p2, records);
+    }
+
+    void addPlyVertex(Chunk& chunk, const double* values)
+    {
+        chunk.positions.push_back(glm::vec3((float)values[plyX], (float)values[plyY], (float)values[plyZ]));
+        if (plyU >= 0 && plyV >= 0)
+            chunk.texCoords.push_back(glm::vec2((float)values[plyU], (float)values[plyV]));
+    }
+
+    // vertex n has texture coordinate n, if the file has any
+    void addPlyPolygon(Chunk& chunk, const std::vector<long long>& polygon)
+    {
+        bool textured = plyU >= 0 && plyV >= 0;
+        for (size_t i = 2; i < polygon.size(); i++)
+        {
+            long long fan[3] = { polygon[0], polygon[i - 1], polygon[i] };
+            for (long long index : fan)
+            {
+                int32_t vertex = index >= 0 && index <= INT32_MAX ? (int32_t)index : -1;
+                chunk.corners.push_back(Corner{ vertex, textured ? vertex : NoIndex });
+            }
+        }
+    }
+
+    void parsePlyAsciiVertices(Chunk& chunk)
+    {
+        std::vector<double> values(plyVertexProperties.size(), 0.0);
+        for (const char* p = chunk.begin; p < chunk.end; )
+        {
+            const char* lineEnd = nextLine(p, chunk.end);
+            const char* q = p;
+            for (size_t i = 0; i < values.size() && q; i++)
+            {
+                float value = 0.0f;
+                q = parseFloat(q, lineEnd, value);
+                values[i] = value;
+            }
+            if (q)
+                addPlyVertex(chunk, values.data());
+            p = lineEnd;
+        }
+    }
+
+    void parsePlyAsciiFaces(Chunk& chunk)
+    {
+        std::vector<long long> polygon;
+        for (const char* p = chunk.begin; p < chunk.end; )
+        {
+            const char* lineEnd = nextLine(p, chunk.end);
+            const char* q = p;
+            for (int i = 0; i < (int)plyFaceProperties.size() && q; i++)
+            {
+                float value = 0.0f;
+                if (!plyFaceProperties[i].list)
+                {
+                    q = parseFloat(q, lineEnd, value);
+                    continue;
+                }
+                long long count = 0;
+                q = parseInt(q, lineEnd, count);
+                polygon.clear();
+                for (long long k = 0; k < count && q; k++)
+                {
+                    long long index = 0;
+                    q = parseInt(q, lineEnd, index);
+                    polygon.push_back(index);
+                }
+                if (q && i == plyFaceList)
+                    addPlyPolygon(chunk, polygon);
+            }
+            p = lineEnd;
+        }
+    }
+
+    void parsePlyBinaryVertices(Chunk& chunk)
+    {
+        std::vector<double> values(plyVertexProperties.size(), 0.0);
+        chunk.positions.reserve(chunk.records);
+        for (const char* p = chunk.begin; p < chunk.end; )
+        {
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                values[i] = plyValue(p, plyVertexProperties[i].type);
+                p += plySize(plyVertexProperties[i].type);
+            }
+            addPlyVertex(chunk, values.data());
+        }
+    }
+
+    void parsePlyBinaryFaces(Chunk& chunk)
+    {
+        std::vector<long long> polygon;
+        chunk.corners.reserve(chunk.records * 3);
+        for (const char* p = chunk.begin; p < chunk.end; )
+        {
+            for (int i = 0; i < (int)plyFaceProperties.size(); i++)
+            {
+                const PlyProperty& property = plyFaceProperties[i];
+                if (!property.list)
+                {
+                    p += plySize(property.type);
+                    continue;
+                }
+                size_t count = (size_t)plyValue(p, property.countType);
+                p += plySize(property.countType);
+                if (i == plyFaceList)
+                {
+                    polygon.resize(count);
+                    for (size_t k = 0; k < count; k++)
+                        polygon[k] = (long long)plyValue(p + k * plySize(property.type), property.type);
+                    addPlyPolygon(chunk, polygon);
+                }
+                p += count * plySize(property.type);
+            }
+        }
+    }
+
+    // binary STL
+    // ------------------------------------------------------------------------
+    static const size_t StlHeaderBytes = 84, StlTriangleBytes = 50;
+
+    void planStl()
+    {
+        const char* data = reinterpret_cast<const char*>(file.data());
+        uint32_t count = 0;
+        if (file.size() >= StlHeaderBytes)
+            std::memcpy(&count, data + 80, sizeof(count));
+        if (file.size() < StlHeaderBytes || file.size() != StlHeaderBytes + (size_t)count * StlTriangleBytes)
+        {
+            failure = file.size() >= 5 && std::memcmp(data, "solid", 5) == 0 ? "ASCII STL is not supported" : "STL file size does not match its triangle count";
+            return;
+        }
+        size_t perChunk = ChunkBytes / StlTriangleBytes;
+        for (size_t first = 0; first < count; first += perChunk)
+        {
+            size_t records = std::min(perChunk, (size_t)count - first);
+            const char* begin = data + StlHeaderBytes + first * StlTriangleBytes;
+            addChunk(ChunkKind::Stl, begin, begin + records * StlTriangleBytes, records);
+        }
+    }
+
+    // normal, three corners, attribute word; STL triangles need no merging, they go straight to the output
+    void parseStl(Chunk& chunk)
+    {
+        chunk.triangles.resize(chunk.records * 3);
+        for (size_t t = 0; t < chunk.records; t++)
+        {
+            const char* record = chunk.begin + t * StlTriangleBytes + 12;
+            for (int c = 0; c < 3; c++)
+            {
+                float xyz[3];
+                std::memcpy(xyz, record + c * 12, sizeof(xyz));
+                chunk.triangles[t * 3 + c] = MeshVertex{ glm::vec3(xyz[0], xyz[1], xyz[2]), glm::vec2(0.0f) };
+            }
+        }
+    }
+};
+#endif
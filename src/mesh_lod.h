@@ -0,0 +1,604 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <glm/glm.hpp>
+
+#include "hash.h"
+#include "mapped_file.h"
+#include "mesh.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <vector>
+
+// one level of detail: a range of the chain's index buffer
+struct LodLevel
+{
+    uint32_t indexOffset;   // in indices
+    uint32_t indexCount;
+    float error;            // how far (object space) the simplified surface may be from the original one
+};
+
+// A mesh and its simplified versions. All levels share the vertices; their index lists are stored back to back,
+// finest first, so one element buffer serves every level.
+struct LodChain
+{
+    IndexedMesh mesh;
+    std::vector<LodLevel> levels;
+
+    void print(std::ostream& out) const
+    {
+        out << "lod chain: " << levels.size() << (levels.size() == 1 ? " level," : " levels,");
+        for (size_t l = 0; l < levels.size(); l++)
+            out << (l ? " ->" : "") << " " << levels[l].indexCount / 3;
+        out << " triangles, error";
+        for (size_t l = 0; l < levels.size(); l++)
+            out << (l ? " /" : "") << " " << levels[l].error;
+        out << std::endl;
+    }
+};
+
+// Garland-Heckbert quadric over (x, y, z, u, v): the area weighted squared distance to the planes, in position and
+// texture space together, of the triangles merged into a vertex. With the uv in the quadric, a collapse that
+// distorts the texture mapping costs as much as one that distorts the shape.
+struct AttributeQuadric
+{
+    static const int N = 5;
+    double a[15];   // upper triangle of the symmetric matrix A, row by row
+    double b[N];
+    double c;
+
+    static int index(int i, int j)
+    {
+        if (i > j)
+            std::swap(i, j);
+        return i * N - i * (i - 1) / 2 + (j - i);
+    }
+
+    static AttributeQuadric zero()
+    {
+        AttributeQuadric q;
+        std::memset(&q, 0, sizeof(q));
+        return q;
+    }
+
+    // for the plane through p0, p1, p2: A = I - e1 e1^T - e2 e2^T with e1, e2 an orthonormal basis of the plane
+    static AttributeQuadric fromTriangle(const double* p0, const double* p1, const double* p2)
+    {
+        double e1[N], e2[N];
+        double length1 = 0.0, along = 0.0, length2 = 0.0;
+        for (int i = 0; i < N; i++)
+        {
+            e1[i] = p1[i] - p0[i];
+            length1 += e1[i] * e1[i];
+        }
+        length1 = std::sqrt(length1);
+        if (length1 == 0.0)
+            return zero();
+        for (int i = 0; i < N; i++)
+        {
+            e1[i] /= length1;
+            along += e1[i] * (p2[i] - p0[i]);
+        }
+        for (int i = 0; i < N; i++)
+        {
+            e2[i] = p2[i] - p0[i] - along * e1[i];
+            length2 += e2[i] * e2[i];
+        }
+        length2 = std::sqrt(length2);
+        if (length2 == 0.0)
+            return zero();
+        for (int i = 0; i < N; i++)
+            e2[i] /= length2;
+
+        double area = 0.5 * length1 * length2;
+        double p0e1 = 0.0, p0e2 = 0.0, p0p0 = 0.0;
+        for (int i = 0; i < N; i++)
+        {
+            p0e1 += p0[i] * e1[i];
+            p0e2 += p0[i] * e2[i];
+            p0p0 += p0[i] * p0[i];
+        }
+        AttributeQuadric q;
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = i; j < N; j++)
+                q.a[index(i, j)] = area * ((i == j ? 1.0 : 0.0) - e1[i] * e1[j] - e2[i] * e2[j]);
+            q.b[i] = area * (p0e1 * e1[i] + p0e2 * e2[i] - p0[i]);
+        }
+        q.c = area * (p0p0 - p0e1 * p0e1 - p0e2 * p0e2);
+        return q;
+    }
+
+    void add(const AttributeQuadric& other)
+    {
+        for (int i = 0; i < 15; i++)
+            a[i] += other.a[i];
+        for (int i = 0; i < N; i++)
+            b[i] += other.b[i];
+        c += other.c;
+    }
+
+    // p^T A p + 2 b^T p + c
+    double evaluate(const double* p) const
+    {
+        double result = c;
+        for (int i = 0; i < N; i++)
+        {
+            result += 2.0 * b[i] * p[i] + a[index(i, i)] * p[i] * p[i];
+            for (int j = i + 1; j < N; j++)
+                result += 2.0 * a[index(i, j)] * p[i] * p[j];
+        }
+        return result;
+    }
+};
+
+// Build a chain of simplified index lists by greedy half-edge collapses ordered by quadric error.
+// Every level has about `reduction` times the triangles of the previous one; the chain ends after maxLevels levels,
+// when nothing can be collapsed any more, or before a level whose error exceeds maxRelativeError times the mesh size
+// (such levels no longer resemble the mesh and would only be picked for objects smaller than a pixel). Vertices on open borders and uv seams (a position shared by vertices
+// with different texture coordinates) never move, so silhouettes of open meshes and texture seams stay intact,
+// and collapses that would flip a triangle or make the mesh non-manifold are skipped.
+// Each level's error is measured afterwards: the largest distance from an original vertex to the triangles
+// around the vertex it was collapsed into.
+inline LodChain buildLodChain(const IndexedMesh& source, unsigned int maxLevels = 8, float reduction = 0.5f, float maxRelativeError = 0.05f)
+{
+    LodChain chain;
+    chain.mesh.vertices = source.vertices;
+    const size_t vertexCount = source.vertices.size();
+    const size_t triangleCount = source.indices.size() / 3;
+
+    // attribute vectors; uv is scaled to the mesh size, so stretching the texture across the whole mesh
+    // costs as much as moving a vertex across it
+    glm::vec3 low(0.0f), high(0.0f);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        low = v ? glm::min(low, source.vertices[v].position) : source.vertices[v].position;
+        high = v ? glm::max(high, source.vertices[v].position) : source.vertices[v].position;
+    }
+    double uvScale = glm::length(high - low);   // also the size the error limit is relative to
+    std::vector<double> points(vertexCount * AttributeQuadric::N);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        const MeshVertex& vertex = source.vertices[v];
+        double* p = &points[v * AttributeQuadric::N];
+        p[0] = vertex.position.x;
+        p[1] = vertex.position.y;
+        p[2] = vertex.position.z;
+        p[3] = vertex.texCoord.x * uvScale;
+        p[4] = vertex.texCoord.y * uvScale;
+    }
+
+    // locked vertices: uv seams (runs of equal positions after sorting) and edges not shared by exactly two triangles
+    std::vector<bool> locked(vertexCount, false);
+    std::vector<uint32_t> byPosition(vertexCount);
+    std::iota(byPosition.begin(), byPosition.end(), 0u);
+    auto positionLess = [&](uint32_t l, uint32_t r)
+    {
+        const glm::vec3& a = source.vertices[l].position;
+        const glm::vec3& b = source.vertices[r].position;
+        return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+    };
+    std::sort(byPosition.begin(), byPosition.end(), positionLess);
+    for (size_t i = 1; i < vertexCount; i++)
+    {
+        if (source.vertices[byPosition[i]].position == source.vertices[byPosition[i - 1]].position)
+            locked[byPosition[i]] = locked[byPosition[i - 1]] = true;
+    }
+    std::vector<uint64_t> edges;
+    edges.reserve(source.indices.size());
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int e = 0; e < 3; e++)
+        {
+            uint64_t a = source.indices[t * 3 + e], b = source.indices[t * 3 + (e + 1) % 3];
+            edges.push_back(a < b ? (a << 32 | b) : (b << 32 | a));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size(); )
+    {
+        size_t j = i + 1;
+        while (j < edges.size() && edges[j] == edges[i])
+            j++;
+        if (j - i != 2)
+            locked[edges[i] >> 32] = locked[edges[i] & 0xffffffffu] = true;
+        i = j;
+    }
+
+    // quadrics and triangle adjacency; the lists of other vertices may still name dead triangles, which are skipped
+    std::vector<AttributeQuadric> quadrics(vertexCount, AttributeQuadric::zero());
+    std::vector<uint32_t> triangles = source.indices;
+    std::vector<bool> alive(triangleCount, true);
+    std::vector<std::vector<uint32_t>> vertexTriangles(vertexCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const uint32_t* tri = &triangles[t * 3];
+        AttributeQuadric q = AttributeQuadric::fromTriangle(&points[tri[0] * AttributeQuadric::N],
+                                                            &points[tri[1] * AttributeQuadric::N], &points[tri[2] * AttributeQuadric::N]);
+        for (int k = 0; k < 3; k++)
+        {
+            quadrics[tri[k]].add(q);
+            vertexTriangles[tri[k]].push_back((uint32_t)t);
+        }
+    }
+
+    auto contains = [&](uint32_t t, uint32_t v)
+    {
+        return triangles[t * 3] == v || triangles[t * 3 + 1] == v || triangles[t * 3 + 2] == v;
+    };
+    auto position = [&](uint32_t v) { return source.vertices[v].position; };
+    auto normal = [&](uint32_t a, uint32_t b, uint32_t c) { return glm::cross(position(b) - position(a), position(c) - position(a)); };
+
+    // min-heap of candidate collapses; an entry is stale once either vertex changed after it was pushed
+    struct Collapse
+    {
+        double cost;
+        uint32_t from, to, fromVersion, toVersion;
+        bool operator<(const Collapse& other) const { return cost > other.cost; }
+    };
+    std::priority_queue<Collapse> heap;
+    std::vector<uint32_t> version(vertexCount, 0), collapsedInto(vertexCount);
+    std::iota(collapsedInto.begin(), collapsedInto.end(), 0u);
+    auto push = [&](uint32_t from, uint32_t to)
+    {
+        if (locked[from])
+            return;
+        AttributeQuadric q = quadrics[from];
+        q.add(quadrics[to]);
+        double cost = std::max(0.0, q.evaluate(&points[to * AttributeQuadric::N]));
+        heap.push(Collapse{ cost, from, to, version[from], version[to] });
+    };
+    auto pushAround = [&](uint32_t v)
+    {
+        for (uint32_t t : vertexTriangles[v])
+        {
+            if (!alive[t])
+                continue;
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t w = triangles[t * 3 + k];
+                if (w != v)
+                {
+                    push(v, w);
+                    push(w, v);
+                }
+            }
+        }
+    };
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int e = 0; e < 3; e++)
+        {
+            uint32_t a = triangles[t * 3 + e], b = triangles[t * 3 + (e + 1) % 3];
+            push(a, b);
+            push(b, a);
+        }
+    }
+
+    auto canCollapse = [&](uint32_t from, uint32_t to)
+    {
+        // the triangles that stay must keep facing the same way
+        std::vector<uint32_t> fromNeighbours, toNeighbours;
+        size_t shared = 0;
+        for (uint32_t t : vertexTriangles[from])
+        {
+            if (!alive[t])
+                continue;
+            const uint32_t* tri = &triangles[t * 3];
+            for (int k = 0; k < 3; k++)
+                if (tri[k] != from)
+                    fromNeighbours.push_back(tri[k]);
+            if (contains(t, to))
+            {
+                shared++;
+                continue;
+            }
+            glm::vec3 before = normal(tri[0], tri[1], tri[2]);
+            glm::vec3 after = normal(tri[0] == from ? to : tri[0], tri[1] == from ? to : tri[1], tri[2] == from ? to : tri[2]);
+            float lengths = glm::length(before) * glm::length(after);
+            if (lengths == 0.0f || glm::dot(before, after) < 0.25f * lengths)
+                return false;
+        }
+        // link condition: the only vertices next to both are the third corners of the triangles on the edge
+        for (uint32_t t : vertexTriangles[to])
+            for (int k = 0; k < 3 && alive[t]; k++)
+                if (triangles[t * 3 + k] != to)
+                    toNeighbours.push_back(triangles[t * 3 + k]);
+        std::sort(fromNeighbours.begin(), fromNeighbours.end());
+        fromNeighbours.erase(std::unique(fromNeighbours.begin(), fromNeighbours.end()), fromNeighbours.end());
+        std::sort(toNeighbours.begin(), toNeighbours.end());
+        toNeighbours.erase(std::unique(toNeighbours.begin(), toNeighbours.end()), toNeighbours.end());
+        size_t common = 0;
+        for (uint32_t v : fromNeighbours)
+            if (v != to && std::binary_search(toNeighbours.begin(), toNeighbours.end(), v))
+                common++;
+        return shared > 0 && common == shared;
+    };
+
+    auto snapshot = [&](size_t liveTriangles)
+    {
+        size_t previousIndexCount = chain.mesh.indices.size();
+        LodLevel level;
+        level.indexOffset = (uint32_t)chain.mesh.indices.size();
+        level.indexCount = (uint32_t)(liveTriangles * 3);
+        std::vector<uint32_t> indices;
+        indices.reserve(level.indexCount);
+        for (size_t t = 0; t < triangleCount; t++)
+            if (alive[t])
+                indices.insert(indices.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+        optimizeVertexCache(indices, vertexCount);
+        chain.mesh.indices.insert(chain.mesh.indices.end(), indices.begin(), indices.end());
+
+        float error = 0.0f;
+        for (uint32_t v = 0; v < vertexCount; v++)
+        {
+            uint32_t r = v;
+            while (collapsedInto[r] != r)
+                r = collapsedInto[r];
+            if (r == v)
+                continue;
+            collapsedInto[v] = r;
+            float nearest = -1.0f;
+            for (uint32_t t : vertexTriangles[r])
+            {
+                if (!alive[t])
+                    continue;
+                glm::vec3 n = normal(triangles[t * 3], triangles[t * 3 + 1], triangles[t * 3 + 2]);
+                float length = glm::length(n);
+                if (length == 0.0f)
+                    continue;
+                float distance = std::fabs(glm::dot(n / length, position(v) - position(r)));
+                nearest = nearest < 0.0f ? distance : std::min(nearest, distance);
+            }
+            error = std::max(error, nearest < 0.0f ? glm::length(position(v) - position(r)) : nearest);
+        }
+        if (error > maxRelativeError * uvScale)
+        {
+            chain.mesh.indices.resize(previousIndexCount);
+            return false;
+        }
+        // a coarser level is never reported as more exact than a finer one
+        level.error = chain.levels.empty() ? error : std::max(error, chain.levels.back().error);
+        chain.levels.push_back(level);
+        return true;
+    };
+
+    snapshot(triangleCount);
+    size_t liveTriangles = triangleCount;
+    size_t target = (size_t)(triangleCount * reduction);
+    while (chain.levels.size() < maxLevels && !heap.empty())
+    {
+        Collapse collapse = heap.top();
+        heap.pop();
+        uint32_t from = collapse.from, to = collapse.to;
+        if (collapse.fromVersion != version[from] || collapse.toVersion != version[to] ||
+            collapsedInto[from] != from || collapsedInto[to] != to || !canCollapse(from, to))
+            continue;
+
+        for (uint32_t t : vertexTriangles[from])
+        {
+            if (!alive[t])
+                continue;
+            if (contains(t, to))
+            {
+                alive[t] = false;
+                liveTriangles--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+                if (triangles[t * 3 + k] == from)
+                    triangles[t * 3 + k] = to;
+            vertexTriangles[to].push_back(t);
+        }
+        vertexTriangles[from].clear();
+        std::vector<uint32_t>& around = vertexTriangles[to];
+        around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return !alive[t]; }), around.end());
+        quadrics[to].add(quadrics[from]);
+        collapsedInto[from] = to;
+        version[from]++;
+        version[to]++;
+        pushAround(to);
+
+        if (liveTriangles <= target)
+        {
+            if (!snapshot(liveTriangles))
+                return chain;
+            target = (size_t)(liveTriangles * reduction);
+        }
+    }
+    // whatever was collapsed after the last level, if it is a real reduction
+    if (chain.levels.size() < maxLevels && liveTriangles * 10 < (size_t)chain.levels.back().indexCount / 3 * 9)
+        snapshot(liveTriangles);
+    return chain;
+}
+
+// Picks a level per object from the size of its simplification error on screen, with hysteresis: an object
+// refines as soon as its level's projected error exceeds the threshold, but only coarsens once the coarser
+// level's error is below (1 - hysteresis) times the threshold, so objects near a switch distance do not pop back and forth.
+struct LodSelector
+{
+    float pixelThreshold = 1.0f;
+    float hysteresis = 0.25f;
+    float pixelsPerUnit = 0.0f;     // screen pixels covered by one object space unit at distance 1
+
+    void setProjection(const glm::mat4& projection, float viewportHeight)
+    {
+        // projection[1][1] is 1 / tan(fovy / 2)
+        pixelsPerUnit = 0.5f * viewportHeight * projection[1][1];
+    }
+
+    unsigned int select(const std::vector<LodLevel>& levels, float distance, unsigned int current) const
+    {
+        unsigned int last = (unsigned int)levels.size() - 1;
+        current = std::min(current, last);
+        float scale = pixelsPerUnit / std::max(distance, 1e-3f);
+        if (levels[current].error * scale > pixelThreshold)
+        {
+            while (current > 0 && levels[current].error * scale > pixelThreshold)
+                current--;
+            return current;
+        }
+        while (current < last && levels[current + 1].error * scale <= pixelThreshold * (1.0f - hysteresis))
+            current++;
+        return current;
+    }
+};
+
+// triangles drawn against the full detail count, and how often objects changed level
+struct LodStats
+{
+    unsigned long long frames = 0;
+    unsigned long long trianglesDrawn = 0;
+    unsigned long long trianglesFull = 0;
+    unsigned long long switches = 0;
+
+    void print(std::ostream& out) const
+    {
+        double n = frames > 0 ? (double)frames : 1.0;
+        out << "lod: " << (unsigned long long)(trianglesDrawn / n) << " of " << (unsigned long long)(trianglesFull / n) << " triangles drawn per frame ("
+            << (trianglesFull ? 100.0 * trianglesDrawn / trianglesFull : 100.0) << "%), " << switches / n
+            << " level switches per frame" << std::endl;
+    }
+};
+
+// header of a .b3lod cache entry, followed by the vertices, the indices of all levels and the levels
+struct LodChainHeader
+{
+    char magic[4];          // "B3LD"
+    uint32_t version;
+    uint64_t key;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t levelCount;
+    uint32_t reserved;
+};
+
+static const uint32_t LodChainVersion = 1;
+
+// On-disk cache of built LOD chains, keyed by the FNV-1a hash of the source mesh and the build parameters,
+// so the simplification runs once per mesh instead of on every start.
+class LodChainCache
+{
+public:
+    explicit LodChainCache(const std::string& cacheDirectory) : directory(cacheDirectory)
+    {
+        if (!directory.empty())
+            mkdir(directory.c_str(), 0755);
+    }
+
+    uint64_t key(const IndexedMesh& mesh, unsigned int maxLevels, float reduction, float maxRelativeError) const
+    {
+        uint64_t hash = fnv1a64(mesh.vertices.data(), mesh.vertices.size() * sizeof(MeshVertex));
+        hash = fnv1a64(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), hash);
+        hash = fnv1a64(&maxLevels, sizeof(maxLevels), hash);
+        hash = fnv1a64(&reduction, sizeof(reduction), hash);
+        return fnv1a64(&maxRelativeError, sizeof(maxRelativeError), hash);
+    }
+
+    // the chain for mesh from the cache, or built and stored
+    LodChain build(const IndexedMesh& mesh, unsigned int maxLevels = 8, float reduction = 0.5f, float maxRelativeError = 0.05f)
+    {
+        LodChain chain;
+        uint64_t entry = key(mesh, maxLevels, reduction, maxRelativeError);
+        if (!directory.empty() && load(entry, chain))
+        {
+            hits++;
+            return chain;
+        }
+        misses++;
+        chain = buildLodChain(mesh, maxLevels, reduction, maxRelativeError);
+        if (!directory.empty())
+            store(entry, chain);
+        return chain;
+    }
+
+    unsigned int hitCount() const { return hits; }
+    unsigned int missCount() const { return misses; }
+
+private:
+    std::string directory;
+    unsigned int hits = 0, misses = 0;
+
+    std::string entryPath(uint64_t entry) const
+    {
+        return directory + "/" + hashToHex(entry) + ".b3lod";
+    }
+
+    bool load(uint64_t entry, LodChain& chain) const
+    {
+        MappedFile file;
+        LodChainHeader header;
+        if (!file.open(entryPath(entry)) || file.size() < sizeof(header))
+            return false;
+        std::memcpy(&header, file.data(), sizeof(header));
+        size_t expected = sizeof(header) + (size_t)header.vertexCount * sizeof(MeshVertex) +
+                          (size_t)header.indexCount * sizeof(uint32_t) + (size_t)header.levelCount * sizeof(LodLevel);
+        if (std::memcmp(header.magic, "B3LD", 4) != 0 || header.version != LodChainVersion || header.key != entry ||
+            header.levelCount == 0 || file.size() != expected)
+            return false;
+
+        const unsigned char* data = file.data() + sizeof(header);
+        const MeshVertex* vertices = reinterpret_cast<const MeshVertex*>(data);
+        chain.mesh.vertices.assign(vertices, vertices + header.vertexCount);
+        data += (size_t)header.vertexCount * sizeof(MeshVertex);
+        const uint32_t* indices = reinterpret_cast<const uint32_t*>(data);
+        chain.mesh.indices.assign(indices, indices + header.indexCount);
+        data += (size_t)header.indexCount * sizeof(uint32_t);
+        const LodLevel* levels = reinterpret_cast<const LodLevel*>(data);
+        chain.levels.assign(levels, levels + header.levelCount);
+
+        // the levels are drawn by GL and rasterized as occluders on the CPU, which indexes the vertices directly,
+        // so an entry whose ranges or indices point outside its own buffers is treated as missing
+        for (const LodLevel& level : chain.levels)
+        {
+            if (level.indexOffset > header.indexCount || level.indexCount > header.indexCount - level.indexOffset || level.indexCount % 3 != 0)
+                return false;
+        }
+        for (uint32_t index : chain.mesh.indices)
+        {
+            if (index >= header.vertexCount)
+                return false;
+        }
+        return true;
+    }
+
+    // written under a temporary name and renamed, so a concurrent reader never sees half an entry
+    bool store(uint64_t entry, const LodChain& chain) const
+    {
+        LodChainHeader header;
+        std::memcpy(header.magic, "B3LD", 4);
+        header.version = LodChainVersion;
+        header.key = entry;
+        header.vertexCount = (uint32_t)chain.mesh.vertices.size();
+        header.indexCount = (uint32_t)chain.mesh.indices.size();
+        header.levelCount = (uint32_t)chain.levels.size();
+        header.reserved = 0;
+
+        std::string path = entryPath(entry), temporary;
+        FILE* file = createTemporaryFile(path, temporary);
+        if (!file)
+            return false;
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        ok = ok && std::fwrite(chain.mesh.vertices.data(), sizeof(MeshVertex), chain.mesh.vertices.size(), file) == chain.mesh.vertices.size();
+        ok = ok && std::fwrite(chain.mesh.indices.data(), sizeof(uint32_t), chain.mesh.indices.size(), file) == chain.mesh.indices.size();
+        ok = ok && std::fwrite(chain.levels.data(), sizeof(LodLevel), chain.levels.size(), file) == chain.levels.size();
+        ok = (std::fclose(file) == 0) && ok;
+        if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+#endif
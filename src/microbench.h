@@ -0,0 +1,215 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include "json.h"
+
+#include <sched.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// keep the compiler from dropping a computation whose result is never used
+template <typename T>
+inline void keepValue(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Pin the calling thread, and the threads it starts later, to one CPU so the scheduler does not move the
+// measurement between cores with different clocks and caches; -1 picks the CPU it runs on now.
+// Returns the CPU, or -1 if the affinity could not be set.
+inline int pinToCpu(int cpu)
+{
+    if (cpu < 0)
+        cpu = sched_getcpu();
+    if (cpu < 0)
+        return -1;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0 ? cpu : -1;
+}
+
+// One micro-benchmark's summary: time per operation as the median over the samples and the median absolute
+// deviation from it, which one preempted or cache-cold sample does not move
+struct MicroResult
+{
+    std::string group;
+    std::string name;
+    double medianNs = 0.0;
+    double madNs = 0.0;
+    double reference = 0.0;         // median in units of the reference loop, for comparing machines
+    double bytesPerOp = 0.0;        // for throughput, 0 if it does not apply
+    size_t samples = 0;
+    size_t callsPerSample = 0;
+};
+
+inline double medianOf(std::vector<double> values)
+{
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : 0.5 * (values[middle - 1] + values[middle]);
+}
+
+// Runs micro-benchmarks: a body is called often enough that one sample takes at least minSampleSeconds, then timed
+// for the given number of samples. Results are per operation (a body may do several) and, next to nanoseconds, in
+// multiples of a fixed reference loop timed by timeReference(): a chain of dependent integer operations whose speed
+// follows the core's clock and pipeline, so the ratio stays comparable across machines where nanoseconds do not.
+class MicroBench
+{
+public:
+    unsigned int samples = 25;
+    double minSampleSeconds = 0.002;
+    std::string filter;                     // run only benchmarks whose "group/name" contains it
+    std::function<void()> sampleEnd;        // runs inside every timed sample after the calls, e.g. glFinish
+
+    // time the reference loop; call once the process is pinned and the options are set, before any run()
+    void timeReference()
+    {
+        referenceNs = 1.0;
+        MicroResult reference = measure("reference", "xorshift step, dependent chain", []()
+        {
+            uint64_t x = 88172645463325252ull;
+            for (int i = 0; i < 1000; i++)
+            {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+            }
+            keepValue(x);
+        }, 1000.0, 0.0);
+        referenceNs = reference.medianNs;
+        reference.reference = 1.0;
+        results.push_back(reference);
+    }
+
+    bool selected(const std::string& group, const std::string& name) const
+    {
+        return filter.empty() || (group + "/" + name).find(filter) != std::string::npos;
+    }
+
+    // body does ops operations of bytesPerOp bytes each per call
+    template <typename Body>
+    void run(const std::string& group, const std::string& name, const Body& body, double ops = 1.0, double bytesPerOp = 0.0)
+    {
+        if (selected(group, name))
+            results.push_back(measure(group, name, body, ops, bytesPerOp));
+    }
+
+    const std::vector<MicroResult>& all() const
+    {
+        return results;
+    }
+
+    double referenceNanoseconds() const
+    {
+        return referenceNs;
+    }
+
+    void print(std::ostream& out) const
+    {
+        std::string group;
+        for (const MicroResult& result : results)
+        {
+            if (result.group != group)
+            {
+                group = result.group;
+                out << group << std::endl;
+            }
+            double mb = result.bytesPerOp > 0.0 ? result.bytesPerOp / result.medianNs * 1e3 : 0.0;
+            out << "  " << std::left << std::setw(52) << result.name << std::right << std::setw(12) << formatTime(result.medianNs)
+                << " +- " << std::fixed << std::setprecision(1) << std::setw(5)
+                << (result.medianNs > 0.0 ? 100.0 * result.madNs / result.medianNs : 0.0) << "%" << std::setprecision(3)
+                << std::setw(12) << result.reference << " ref";
+            if (mb > 0.0)
+                out << std::setprecision(1) << std::setw(10) << mb << " MB/s";
+            out << std::defaultfloat << std::setprecision(6) << std::endl;
+        }
+    }
+
+    void writeJson(std::ostream& out, const std::string& machine) const
+    {
+        out << std::setprecision(6) << "{\n  \"machine\": \"" << jsonEscape(machine) << "\",\n  \"referenceNs\": " << referenceNs
+            << ",\n  \"results\": [\n";
+        for (size_t k = 0; k < results.size(); k++)
+        {
+            const MicroResult& r = results[k];
+            out << "    { \"group\": \"" << jsonEscape(r.group) << "\", \"name\": \"" << jsonEscape(r.name) << "\", \"medianNs\": " << r.medianNs
+                << ", \"madNs\": " << r.madNs << ", \"reference\": " << r.reference << ", \"bytesPerOp\": " << r.bytesPerOp
+                << ", \"samples\": " << r.samples << ", \"callsPerSample\": " << r.callsPerSample << " }"
+                << (k + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+    }
+
+private:
+    std::vector<MicroResult> results;
+    double referenceNs = 1.0;
+
+    template <typename Body>
+    MicroResult measure(const std::string& group, const std::string& name, const Body& body, double ops, double bytesPerOp)
+    {
+        // warm the caches and the driver, then double the calls per sample until a sample is long enough
+        body();
+        size_t calls = 1;
+        for (;;)
+        {
+            double seconds = timeSample(body, calls);
+            if (seconds >= minSampleSeconds || calls >= ((size_t)1 << 30))
+                break;
+            calls = seconds > 0.0 ? std::max(calls * 2, (size_t)(calls * minSampleSeconds / seconds * 1.2)) : calls * 2;
+        }
+        std::vector<double> perOp;
+        for (unsigned int s = 0; s < std::max(samples, 1u); s++)
+            perOp.push_back(timeSample(body, calls) * 1e9 / ((double)calls * ops));
+        MicroResult result;
+        result.group = group;
+        result.name = name;
+        result.medianNs = medianOf(perOp);
+        std::vector<double> deviations;
+        for (double ns : perOp)
+            deviations.push_back(std::fabs(ns - result.medianNs));
+        result.madNs = medianOf(deviations);
+        result.reference = result.medianNs / referenceNs;
+        result.bytesPerOp = bytesPerOp;
+        result.samples = perOp.size();
+        result.callsPerSample = calls;
+        return result;
+    }
+
+    // the body is a template parameter so the timed loop calls it directly, without a std::function in between
+    template <typename Body>
+    double timeSample(const Body& body, size_t calls)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t c = 0; c < calls; c++)
+            body();
+        if (sampleEnd)
+            sampleEnd();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static std::string formatTime(double ns)
+    {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(ns < 10.0 ? 2 : 1);
+        if (ns < 1e3)
+            out << ns << " ns";
+        else if (ns < 1e6)
+            out << ns / 1e3 << " us";
+        else
+            out << ns / 1e6 << " ms";
+        return out.str();
+    }
+};
+#endif
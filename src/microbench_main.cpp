@@ -0,0 +1,517 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "headless_context.h"
+#include "shader_s.h"
+#include "matrix_kernels.h"
+#include "microbench.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Micro-benchmarks for the pieces the viewer vendors: stb_image decoding per format and size, glm matrix math, and
+// the GL calls a frame makes per object (uniform uploads, program and texture binds). Each benchmark reports the
+// median time per operation over its samples with the median absolute deviation, and the same median in units of
+// a reference loop so runs from different machines can be set side by side.
+
+// an image to decode, kept both as a file and in memory
+struct DecodeInput
+{
+    std::string label;
+    std::string path;
+    std::vector<unsigned char> bytes;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+};
+
+bool readFile(const std::string& path, std::vector<unsigned char>& bytes)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+bool writeFile(const std::string& path, const std::vector<unsigned char>& bytes)
+{
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+    return (bool)file;
+}
+
+void putLE(std::vector<unsigned char>& out, uint32_t value, int bytes)
+{
+    for (int b = 0; b < bytes; b++)
+        out.push_back((unsigned char)(value >> (8 * b)));
+}
+
+// Encoders for the formats stb_image reads that need no compressor, so the sizes JPEG and PNG only come in as
+// shipped textures can still be measured. rgb is top-down, 3 channels.
+std::vector<unsigned char> encodeBMP(int width, int height, const std::vector<unsigned char>& rgb)
+{
+    uint32_t rowBytes = ((uint32_t)width * 3 + 3) & ~3u;
+    std::vector<unsigned char> out{ 'B', 'M' };
+    putLE(out, 54 + rowBytes * height, 4);
+    putLE(out, 0, 4);
+    putLE(out, 54, 4);
+    putLE(out, 40, 4);
+    putLE(out, width, 4);
+    putLE(out, height, 4);          // positive: bottom-up rows
+    putLE(out, 1, 2);
+    putLE(out, 24, 2);
+    for (int k = 0; k < 6; k++)
+        putLE(out, 0, 4);
+    for (int y = height - 1; y >= 0; y--)
+    {
+        const unsigned char* row = &rgb[(size_t)y * width * 3];
+        for (int x = 0; x < width; x++)
+        {
+            out.push_back(row[x * 3 + 2]);
+            out.push_back(row[x * 3 + 1]);
+            out.push_back(row[x * 3]);
+        }
+        out.resize(out.size() + rowBytes - (size_t)width * 3, 0);
+    }
+    return out;
+}
+
+std::vector<unsigned char> encodeTGA(int width, int height, const std::vector<unsigned char>& rgb)
+{
+    std::vector<unsigned char> out{ 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    putLE(out, width, 2);
+    putLE(out, height, 2);
+    out.push_back(24);
+    out.push_back(0x20);            // top-down rows
+    for (size_t p = 0; p < (size_t)width * height; p++)
+    {
+        out.push_back(rgb[p * 3 + 2]);
+        out.push_back(rgb[p * 3 + 1]);
+        out.push_back(rgb[p * 3]);
+    }
+    return out;
+}
+
+std::vector<unsigned char> encodePNM(int width, int height, const std::vector<unsigned char>& rgb)
+{
+    std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    std::vector<unsigned char> out(header.begin(), header.end());
+    out.insert(out.end(), rgb.begin(), rgb.begin() + (size_t)width * height * 3);
+    return out;
+}
+
+void benchmarkDecode(MicroBench& bench, const std::vector<DecodeInput>& inputs)
+{
+    const std::string group = "image decode";
+    for (const DecodeInput& input : inputs)
+    {
+        double bytes = (double)input.width * input.height * input.channels;
+        for (int flip = 0; flip < 2; flip++)
+        {
+            const char* flipLabel = flip ? ", flipped" : "";
+            bench.run(group, "stbi_load " + input.label + flipLabel, [&input, flip]()
+            {
+                stbi_set_flip_vertically_on_load(flip);
+                int width, height, channels;
+                unsigned char* data = stbi_load(input.path.c_str(), &width, &height, &channels, 0);
+                keepValue(data);
+                stbi_image_free(data);
+            }, 1.0, bytes);
+            bench.run(group, "stbi_load_from_memory " + input.label + flipLabel, [&input, flip]()
+            {
+                stbi_set_flip_vertically_on_load(flip);
+                int width, height, channels;
+                unsigned char* data = stbi_load_from_memory(input.bytes.data(), (int)input.bytes.size(), &width, &height, &channels, 0);
+                keepValue(data);
+                stbi_image_free(data);
+            }, 1.0, bytes);
+        }
+    }
+    stbi_set_flip_vertically_on_load(false);
+}
+
+void benchmarkMath(MicroBench& bench)
+{
+    // arrays of inputs, so neither the compiler nor the branch predictor sees one constant value
+    const size_t count = 256;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<glm::vec3> positions(count), axes(count), scales(count);
+    std::vector<glm::quat> rotations(count);
+    std::vector<float> angles(count);
+    std::vector<glm::mat4> matrices(count), products(count);
+    std::vector<glm::vec4> vectors(count);
+    for (size_t k = 0; k < count; k++)
+    {
+        positions[k] = glm::vec3(unit(random), unit(random), unit(random)) * 10.0f;
+        axes[k] = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 2.0f));
+        scales[k] = glm::vec3(1.0f) + 0.5f * glm::vec3(unit(random), unit(random), unit(random));
+        angles[k] = unit(random) * 3.0f;
+        rotations[k] = glm::angleAxis(angles[k], axes[k]);
+        matrices[k] = glm::translate(glm::mat4(1.0f), positions[k]) * glm::mat4_cast(rotations[k]);
+        vectors[k] = glm::vec4(positions[k], 1.0f);
+    }
+
+    const std::string group = "glm";
+    const double ops = (double)count;
+    bench.run(group, "mat4(scalar)", [&]()
+    {
+        for (size_t k = 0; k < count; k++)
+            products[k] = glm::mat4(angles[k]);
+        keepValue(products);
+    }, ops);
+    bench.run(group, "translate", [&]()
+    {
+        for (size_t k = 0; k < count; k++)
+            products[k] = glm::translate(matrices[k], positions[k]);
+        keepValue(products);
+    }, ops);
+    bench.run(group, "rotate", [&]()
+    {
+        for (size_t k = 0; k < count; k++)
+            products[k] = glm::rotate(matrices[k], angles[k], axes[k]);
+        keepValue(products);
+    }, ops);
+    bench.run(group, "scale", [&]()
+    {
+        for (size_t k = 0; k < count; k++)
+            products[k] = glm::scale(matrices[k], scales[k]);
+        keepValue(products);
+    }, ops);
+    bench.run(group, "translate * rotate * scale", [&]()
+    {
+        for (size_t k = 0; k < count; k++)
+            products[k] = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), positions[k]), angles[k], axes[k]), scales[k]);
+        keepValue(products);
+    }, ops);
+    bench.run(group, "composeTransform (quaternion)", [&]()
+    {
+        for (size_t k = 0; k < count; k++)
+            products[k] = composeTransform(positions[k], rotations[k], scales[k]);
+        keepValue(products);
+    }, ops);
+    bench.run(group, "perspective", [&]()
+    {
+        for (size_t k = 0; k < count; k++)
+            products[k] = glm::perspective(0.5f + 0.1f * angles[k], 1.0f + 0.1f * scales[k].x, 0.1f, 100.0f);
+        keepValue(products);
+    }, ops);
+    bench.run(group, "lookAt", [&]()
+    {
+        for (size_t k = 0; k < count; k++)
+            products[k] = glm::lookAt(positions[k], glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        keepValue(products);
+    }, ops);
+    bench.run(group, "mat4 * mat4", [&]()
+    {
+        for (size_t k = 0; k < count; k++)
+            products[k] = matrices[k] * matrices[(k + 1) % count];
+        keepValue(products);
+    }, ops);
+    bench.run(group, "mat4 * vec4", [&]()
+    {
+        for (size_t k = 0; k < count; k++)
+            vectors[k] = matrices[k] * vectors[(k + 1) % count];
+        keepValue(vectors);
+    }, ops);
+    bench.run(group, "inverse", [&]()
+    {
+        for (size_t k = 0; k < count; k++)
+            products[k] = glm::inverse(matrices[k]);
+        keepValue(products);
+    }, ops);
+}
+
+unsigned int createTexture(const std::vector<unsigned char>& rgb, int width, int height)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+    return texture;
+}
+
+// GL calls are measured as the application sees them plus a glFinish per sample, so work a driver defers to the
+// next flush is charged to the call that queued it. llvmpipe validates most state at the next draw, which is why
+// the bind benchmarks also draw a point after every bind.
+void benchmarkGL(MicroBench& bench, const std::vector<unsigned char>& rgb, int width, int height)
+{
+    Shader shader("shaders/3.3.shader.vs", "shaders/3.3.shader.fs");
+    Shader proxy("shaders/3.3.proxy.vs", "shaders/3.3.proxy.fs");
+    unsigned int textures[2] = { createTexture(rgb, width, height), createTexture(rgb, width, height) };
+    unsigned int vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    bench.sampleEnd = []() { glFinish(); };
+    const std::string group = "GL";
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 3.0f));
+    shader.use();
+    bench.run(group, "setMat4, glGetUniformLocation per call", [&]()
+    {
+        model[3][0] += 1.0f;
+        glUniformMatrix4fv(glGetUniformLocation(shader.ID, "model"), 1, GL_FALSE, &model[0][0]);
+    });
+    bench.run(group, "Shader::setMat4(name), cached location", [&]()
+    {
+        model[3][0] += 1.0f;
+        shader.setMat4("model", model);
+    });
+    UniformHandle modelHandle = shader.uniform("model");
+    bench.run(group, "Shader::setMat4(UniformHandle)", [&]()
+    {
+        model[3][0] += 1.0f;
+        shader.setMat4(modelHandle, model);
+    });
+    int location = shader.getLocation("model");
+    bench.run(group, "glUniformMatrix4fv, location held", [&]()
+    {
+        model[3][0] += 1.0f;
+        glUniformMatrix4fv(location, 1, GL_FALSE, &model[0][0]);
+    });
+
+    bench.run(group, "glUseProgram, same program", [&]()
+    {
+        glUseProgram(shader.ID);
+    });
+    unsigned int flip = 0;
+    bench.run(group, "glUseProgram, alternating programs", [&]()
+    {
+        glUseProgram((flip++ & 1) ? proxy.ID : shader.ID);
+    });
+    bench.run(group, "glBindTexture, same texture", [&]()
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[0]);
+    });
+    bench.run(group, "glBindTexture, alternating textures", [&]()
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[flip++ & 1]);
+    });
+
+    // the same binds followed by a one-point draw, where llvmpipe actually revalidates the changed state
+    shader.use();
+    bench.run(group, "draw after same program", [&]()
+    {
+        glUseProgram(shader.ID);
+        glDrawArrays(GL_POINTS, 0, 1);
+    });
+    bench.run(group, "draw after alternating programs", [&]()
+    {
+        glUseProgram((flip++ & 1) ? proxy.ID : shader.ID);
+        glDrawArrays(GL_POINTS, 0, 1);
+    });
+    shader.use();
+    bench.run(group, "draw after same texture", [&]()
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[0]);
+        glDrawArrays(GL_POINTS, 0, 1);
+    });
+    bench.run(group, "draw after alternating textures", [&]()
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[flip++ & 1]);
+        glDrawArrays(GL_POINTS, 0, 1);
+    });
+    bench.sampleEnd = nullptr;
+
+    glDeleteVertexArrays(1, &vao);
+    glDeleteTextures(2, textures);
+}
+
+std::string cpuModel()
+{
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line))
+    {
+        size_t colon = line.find(':');
+        if (line.compare(0, 10, "model name") == 0 && colon != std::string::npos && colon + 2 <= line.size())
+            return line.substr(colon + 2);
+    }
+    return "unknown CPU";
+}
+
+int main(int argc, char* argv[])
+{
+    MicroBench bench;
+    int cpu = -1;
+    bool pin = true;
+    std::string jsonPath;
+    std::vector<int> sizes = { 256, 1024, 2048 };
+    std::vector<std::string> images = { "textures/container.jpg", "textures/awesomeface.png", "textures/steve.png" };
+    bool defaultImages = true;
+
+    // command line options
+    // --------------------
+    bool usage = false;
+    for (int i = 1; i < argc && !usage; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--cpu" && i + 1 < argc)
+            cpu = std::atoi(argv[++i]);
+        else if (arg == "--no-pin")
+            pin = false;
+        else if (arg == "--samples" && i + 1 < argc)
+            bench.samples = std::max(1u, static_cast<unsigned int>(std::strtoul(argv[++i], NULL, 10)));
+        else if (arg == "--min-sample-ms" && i + 1 < argc)
+            bench.minSampleSeconds = std::strtod(argv[++i], NULL) / 1000.0;
+        else if (arg == "--filter" && i + 1 < argc)
+            bench.filter = argv[++i];
+        else if (arg == "--json" && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (arg == "--image" && i + 1 < argc)
+        {
+            if (defaultImages)
+                images.clear();
+            defaultImages = false;
+            images.push_back(argv[++i]);
+        }
+        else if (arg == "--sizes" && i + 1 < argc)
+        {
+            sizes.clear();
+            std::istringstream values(argv[++i]);
+            std::string value;
+            while (std::getline(values, value, ','))
+            {
+                if (std::atoi(value.c_str()) > 0)
+                    sizes.push_back(std::atoi(value.c_str()));
+            }
+        }
+        else
+            usage = true;
+    }
+    if (usage)
+    {
+        std::cout << "Usage: " << argv[0] << " [--cpu N] [--no-pin] [--samples N] [--min-sample-ms MS] [--filter TEXT]"
+                  << " [--image PATH]... [--sizes 256,1024,...] [--json results.json]" << std::endl;
+        return 2;
+    }
+
+    // pin before the GL context exists, so the threads llvmpipe starts for rasterizing inherit the affinity
+    if (pin)
+    {
+        cpu = pinToCpu(cpu);
+        if (cpu < 0)
+            std::cout << "Could not pin to a CPU, measuring unpinned" << std::endl;
+    }
+    HeadlessContext context;
+    if (!context.create(64, 64))
+    {
+        context.destroy();
+        return 2;
+    }
+    std::string machine = cpuModel() + ", " + context.renderer() + ", gcc " + __VERSION__;
+    std::cout << "machine: " << machine << std::endl;
+    if (pin && cpu >= 0)
+        std::cout << "pinned to CPU " << cpu << std::endl;
+
+    // decode inputs: the shipped textures as they are, and the first one tiled to each size in the formats
+    // that can be written without a compressor
+    std::vector<DecodeInput> inputs;
+    std::vector<unsigned char> sourceRgb;
+    int sourceWidth = 0, sourceHeight = 0;
+    for (const std::string& path : images)
+    {
+        DecodeInput input;
+        input.path = path;
+        int channels = 0;
+        if (!readFile(path, input.bytes) || !stbi_info_from_memory(input.bytes.data(), (int)input.bytes.size(), &input.width, &input.height, &channels))
+        {
+            std::cout << "Failed to read " << path << std::endl;
+            continue;
+        }
+        input.channels = channels;
+        size_t dot = path.find_last_of('.');
+        std::string format = dot != std::string::npos ? path.substr(dot + 1) : "image";
+        for (char& c : format)
+            c = (char)std::toupper((unsigned char)c);
+        input.label = format + " " + std::to_string(input.width) + "x" + std::to_string(input.height) + " " + std::to_string(channels) + "ch";
+        if (sourceRgb.empty())
+        {
+            int width, height, sourceChannels;
+            unsigned char* data = stbi_load_from_memory(input.bytes.data(), (int)input.bytes.size(), &width, &height, &sourceChannels, 3);
+            if (data)
+            {
+                sourceRgb.assign(data, data + (size_t)width * height * 3);
+                sourceWidth = width;
+                sourceHeight = height;
+                stbi_image_free(data);
+            }
+        }
+        inputs.push_back(input);
+    }
+
+    char directoryTemplate[] = "/tmp/viewer_microbench.XXXXXX";
+    std::string directory = !sourceRgb.empty() && mkdtemp(directoryTemplate) ? directoryTemplate : "";
+    std::vector<std::string> written;
+    for (int size : directory.empty() ? std::vector<int>() : sizes)
+    {
+        std::vector<unsigned char> rgb((size_t)size * size * 3);
+        for (int y = 0; y < size; y++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                const unsigned char* texel = &sourceRgb[((size_t)(y % sourceHeight) * sourceWidth + x % sourceWidth) * 3];
+                std::copy(texel, texel + 3, &rgb[((size_t)y * size + x) * 3]);
+            }
+        }
+        const char* formats[] = { "BMP", "TGA", "PNM" };
+        for (const char* format : formats)
+        {
+            DecodeInput input;
+            input.bytes = format[0] == 'B' ? encodeBMP(size, size, rgb) : format[0] == 'T' ? encodeTGA(size, size, rgb) : encodePNM(size, size, rgb);
+            input.width = input.height = size;
+            input.channels = 3;
+            input.label = std::string(format) + " " + std::to_string(size) + "x" + std::to_string(size) + " 3ch";
+            input.path = directory + "/" + std::to_string(size) + "." + format;
+            if (!writeFile(input.path, input.bytes))
+            {
+                std::cout << "Failed to write " << input.path << std::endl;
+                continue;
+            }
+            written.push_back(input.path);
+            inputs.push_back(input);
+        }
+    }
+
+    bench.timeReference();
+    std::cout << "reference unit: " << bench.referenceNanoseconds() << " ns" << std::endl;
+    benchmarkDecode(bench, inputs);
+    for (const std::string& path : written)
+        std::remove(path.c_str());
+    if (!directory.empty())
+        rmdir(directory.c_str());
+    benchmarkMath(bench);
+    if (!sourceRgb.empty())
+        benchmarkGL(bench, sourceRgb, sourceWidth, sourceHeight);
+    context.destroy();
+
+    bench.print(std::cout);
+    if (!jsonPath.empty())
+    {
+        std::ofstream output(jsonPath);
+        bench.writeJson(output, machine);
+        if (!output)
+        {
+            std::cout << "Failed to write " << jsonPath << std::endl;
+            return 2;
+        }
+        std::cout << "wrote " << jsonPath << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#ifndef NUMBER_PARSE_H
+#define NUMBER_PARSE_H
+
+#include <cmath>
+#include <cstdint>
+
+// Parse a decimal number at p, after optional blanks; returns the character after it, or nullptr if there is none.
+// Up to 19 significant digits are gathered in an integer that is scaled once by an exact power of ten, which is
+// within an ulp or two of double precision and exact to float precision for everything a mesh file holds;
+// no locale, no errno, no allocation, never reads past end.
+inline const char* parseDouble(const char* p, const char* end, double& value)
+{
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    uint64_t mantissa = 0;
+    int exponent = 0, digits = 0;
+    bool any = false;
+    for (; p < end && (unsigned)(*p - '0') < 10u; p++)
+    {
+        any = true;
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            digits += mantissa != 0;
+        }
+        else
+            exponent++;
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && (unsigned)(*p - '0') < 10u; p++)
+        {
+            any = true;
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (!any)
+        return nullptr;
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negativeExponent = *q++ == '-';
+        if (q < end && (unsigned)(*q - '0') < 10u)
+        {
+            int e = 0;
+            for (; q < end && (unsigned)(*q - '0') < 10u; q++)
+                e = e < 10000 ? e * 10 + (*q - '0') : e;
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+    double v = (double)mantissa;
+    if (exponent < 0)
+        v = exponent >= -22 ? v / powers[-exponent] : v * std::pow(10.0, exponent);
+    else if (exponent > 0)
+        v = exponent <= 22 ? v * powers[exponent] : v * std::pow(10.0, exponent);
+    value = negative ? -v : v;
+    return p;
+}
+
+// the same, rounded to float
+inline const char* parseFloat(const char* p, const char* end, float& value)
+{
+    double v = 0.0;
+    p = parseDouble(p, end, v);
+    if (p)
+        value = (float)v;
+    return p;
+}
+
+// Parse a decimal integer at p, after optional blanks; returns the character after it, or nullptr if there is none
+inline const char* parseInt(const char* p, const char* end, long long& value)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    if (p == end || (unsigned)(*p - '0') >= 10u)
+        return nullptr;
+    long long v = 0;
+    for (; p < end && (unsigned)(*p - '0') < 10u; p++)
+        v = v * 10 + (*p - '0');
+    value = negative ? -v : v;
+    return p;
+}
+#endif
@@ -0,0 +1,330 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE 1
+#endif
+
+// accumulated occlusion culling counters
+struct OcclusionStats
+{
+    unsigned long long frames = 0;
+    unsigned long long tested = 0, culled = 0;
+    unsigned long long occluders = 0, triangles = 0;    // triangles that reached the rasterizer
+    double rasterSeconds = 0.0;     // occluder transform, setup and rasterization
+    double testSeconds = 0.0;       // box tests
+
+    void print(std::ostream& out) const
+    {
+        if (frames == 0)
+            return;
+        double n = (double)frames;
+        out << "occlusion: avg " << culled / n << " of " << tested / n << " objects culled ("
+            << (tested ? 100.0 * culled / tested : 0.0) << "%), " << occluders / n << " occluders with "
+            << triangles / n << " triangles, raster " << rasterSeconds / n * 1000.0 << " ms + test "
+            << testSeconds / n * 1000.0 << " ms per frame" << std::endl;
+    }
+};
+
+// CPU occlusion culling against a low resolution depth buffer.
+// Every frame the caller rasterizes a few simplified occluder meshes into a Width x Height buffer of NDC depths,
+// then tests the boxes of the objects that survived frustum culling against it; objects whose box is behind the
+// occluders everywhere it projects to are dropped before they reach GL.
+// Both sides are conservative: a pixel only counts as covered if the triangle covers it completely, and it stores
+// the farthest depth of the triangle over the pixel, so occluder meshes must lie inside the objects they stand for
+// (true for any simplification of a convex mesh that keeps vertices on its surface). A box is tested with the depth
+// of its nearest corner over the pixel rectangle it projects to.
+// The buffer is split into bands of one tile row; the bands are rasterized in parallel on the job system, four
+// pixels at a time with SSE, and the boxes are tested in parallel as well. Each tile keeps the maximum depth of its pixels, so most box tests
+// resolve a whole tile with one comparison.
+class OcclusionCuller
+{
+public:
+    static const int Width = 256, Height = 128;
+    static const int TileSize = 8;
+    static const int TilesX = Width / TileSize, TilesY = Height / TileSize;
+
+    // jobs: the threads bands and box tests are spread over (null = the calling thread only)
+    explicit OcclusionCuller(JobSystem* jobSystem = nullptr)
+        : jobs(jobSystem)
+    {
+    }
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // frame usage: begin(), addOccluder()..., rasterize(), then cull() or visible()
+    // ------------------------------------------------------------------------
+    void begin(const glm::mat4& projectionView)
+    {
+        frameStart = std::chrono::steady_clock::now();
+        viewProjection = projectionView;
+        triangles.clear();
+        frameOccluders = 0;
+    }
+
+    // the triangles indices[first, first + count) of mesh, placed with model
+    void addOccluder(const glm::mat4& model, const IndexedMesh& mesh, size_t first, size_t count)
+    {
+        glm::mat4 transform = viewProjection * model;
+        clipVertices.resize(mesh.vertices.size());
+        for (size_t v = 0; v < mesh.vertices.size(); v++)
+            clipVertices[v] = transform * glm::vec4(mesh.vertices[v].position, 1.0f);
+        for (size_t k = first; k + 2 < first + count; k += 3)
+            setupTriangle(clipVertices[mesh.indices[k]], clipVertices[mesh.indices[k + 1]], clipVertices[mesh.indices[k + 2]]);
+        frameOccluders++;
+    }
+
+    // fill the depth buffer and the tile depths from the added occluders
+    void rasterize()
+    {
+        auto rasterizeBands = [this](size_t first, size_t end)
+        {
+            for (size_t band = first; band < end; band++)
+                rasterizeBand((int)band);
+        };
+        if (jobs)
+            jobs->parallelFor(TilesY, 1, rasterizeBands);
+        else
+            rasterizeBands(0, TilesY);
+
+        stats.frames++;
+        stats.occluders += frameOccluders;
+        stats.triangles += triangles.size();
+        stats.rasterSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+    }
+
+    // false if the box is certainly hidden behind the occluders
+    bool visible(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+    {
+        float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec4 p((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y, (corner & 4) ? boxMax.z : boxMin.z, 1.0f);
+            glm::vec4 clip = viewProjection * p;
+            // crosses the camera plane: too close to bother
+            if (clip.w <= NearW)
+                return true;
+            float invW = 1.0f / clip.w;
+            float x = (clip.x * invW * 0.5f + 0.5f) * Width, y = (clip.y * invW * 0.5f + 0.5f) * Height;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            minZ = std::min(minZ, clip.z * invW);
+        }
+        if (maxX < 0.0f || maxY < 0.0f || minX >= Width || minY >= Height)
+            return true;
+
+        // every pixel the box touches
+        int x0 = std::max(0, (int)std::floor(minX)), x1 = std::min(Width - 1, (int)std::floor(maxX));
+        int y0 = std::max(0, (int)std::floor(minY)), y1 = std::min(Height - 1, (int)std::floor(maxY));
+        for (int ty = y0 / TileSize; ty <= y1 / TileSize; ty++)
+        {
+            for (int tx = x0 / TileSize; tx <= x1 / TileSize; tx++)
+            {
+                // the box is behind every pixel of this tile
+                if (minZ > tileMax[ty * TilesX + tx])
+                    continue;
+                int py0 = std::max(y0, ty * TileSize), py1 = std::min(y1, ty * TileSize + TileSize - 1);
+                int px0 = std::max(x0, tx * TileSize), px1 = std::min(x1, tx * TileSize + TileSize - 1);
+                for (int y = py0; y <= py1; y++)
+                {
+                    const float* row = &depth[(size_t)y * Width];
+                    for (int x = px0; x <= px1; x++)
+                    {
+                        if (minZ <= row[x])
+                            return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    // keep only the ids whose box is visible; boxOf(id, boxMin, boxMax) gives an object's world space box
+    template <typename BoxOf>
+    void cull(std::vector<uint32_t>& ids, BoxOf boxOf)
+    {
+        auto start = std::chrono::steady_clock::now();
+        // test in parallel, then keep the visible ones in order
+        keep.resize(ids.size());
+        auto test = [&](size_t first, size_t end)
+        {
+            glm::vec3 boxMin, boxMax;
+            for (size_t k = first; k < end; k++)
+            {
+                boxOf(ids[k], boxMin, boxMax);
+                keep[k] = visible(boxMin, boxMax);
+            }
+        };
+        if (jobs)
+            jobs->parallelFor(ids.size(), TestGrain, test);
+        else
+            test(0, ids.size());
+        size_t kept = 0;
+        for (size_t k = 0; k < ids.size(); k++)
+        {
+            if (keep[k])
+                ids[kept++] = ids[k];
+        }
+        stats.tested += ids.size();
+        stats.culled += ids.size() - kept;
+        ids.resize(kept);
+        stats.testSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const OcclusionStats& occlusionStats() const
+    {
+        return stats;
+    }
+
+private:
+    static constexpr float NearW = 1e-4f;
+    static const size_t TestGrain = 1024;   // boxes per job
+
+    // Edge functions and depth plane in pixel coordinates, already made conservative: e[i] >= 0 at a pixel center
+    // means the whole pixel is inside edge i, and z is the largest depth of the plane over the pixel.
+    struct Triangle
+    {
+        float ea[3], eb[3], ec[3];
+        float za, zb, zc;
+        int minX, maxX, minY, maxY;
+    };
+
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    std::vector<glm::vec4> clipVertices;
+    std::vector<Triangle> triangles;
+    unsigned int frameOccluders = 0;
+    std::chrono::steady_clock::time_point frameStart;
+    std::vector<float> depth = std::vector<float>((size_t)Width * Height, FLT_MAX);
+    float tileMax[TilesX * TilesY];
+    OcclusionStats stats;
+
+    JobSystem* jobs;
+    std::vector<uint8_t> keep;          // box test results of cull()
+
+    void setupTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2)
+    {
+        // triangles reaching in front of the near plane are dropped, which only ever hides less
+        if (c0.z < -c0.w || c1.z < -c1.w || c2.z < -c2.w || c0.w <= NearW || c1.w <= NearW || c2.w <= NearW)
+            return;
+
+        float x[3], y[3], z[3];
+        const glm::vec4* clip[3] = { &c0, &c1, &c2 };
+        for (int i = 0; i < 3; i++)
+        {
+            float invW = 1.0f / clip[i]->w;
+            x[i] = (clip[i]->x * invW * 0.5f + 0.5f) * Width;
+            y[i] = (clip[i]->y * invW * 0.5f + 0.5f) * Height;
+            z[i] = clip[i]->z * invW;
+        }
+
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (std::fabs(area) < 1e-6f)
+            return;
+
+        Triangle t;
+        t.minX = std::max(0, (int)std::floor(std::min(x[0], std::min(x[1], x[2]))));
+        t.maxX = std::min(Width - 1, (int)std::ceil(std::max(x[0], std::max(x[1], x[2]))) - 1);
+        t.minY = std::max(0, (int)std::floor(std::min(y[0], std::min(y[1], y[2]))));
+        t.maxY = std::min(Height - 1, (int)std::ceil(std::max(y[0], std::max(y[1], y[2]))) - 1);
+        if (t.minX > t.maxX || t.minY > t.maxY)
+            return;
+
+        // both windings are rasterized: edge i is the one opposite vertex i, positive inside
+        float sign = area > 0.0f ? 1.0f : -1.0f;
+        for (int i = 0; i < 3; i++)
+        {
+            int a = (i + 1) % 3, b = (i + 2) % 3;
+            t.ea[i] = sign * (y[a] - y[b]);
+            t.eb[i] = sign * (x[b] - x[a]);
+            t.ec[i] = sign * (x[a] * y[b] - y[a] * x[b]);
+            // shift the edge inwards by half a pixel along both axes: the pixel corner farthest outside must pass
+            t.ec[i] -= 0.5f * (std::fabs(t.ea[i]) + std::fabs(t.eb[i]));
+        }
+        t.za = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+        t.zb = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+        t.zc = z[0] - t.za * x[0] - t.zb * y[0] + 0.5f * (std::fabs(t.za) + std::fabs(t.zb));
+        triangles.push_back(t);
+    }
+
+    // clear, rasterize and summarize the pixel rows of one tile row
+    void rasterizeBand(int band)
+    {
+        int y0 = band * TileSize, y1 = y0 + TileSize - 1;
+        std::fill(depth.begin() + (size_t)y0 * Width, depth.begin() + (size_t)(y1 + 1) * Width, FLT_MAX);
+
+        for (const Triangle& t : triangles)
+        {
+            if (t.maxY < y0 || t.minY > y1)
+                continue;
+            int rowFirst = std::max(t.minY, y0), rowLast = std::min(t.maxY, y1);
+            // start at a multiple of four so each group of pixels is one aligned quad of the row
+            int xStart = t.minX & ~3;
+            for (int y = rowFirst; y <= rowLast; y++)
+            {
+                float* row = &depth[(size_t)y * Width];
+                float cx = (float)xStart + 0.5f, cy = (float)y + 0.5f;
+#ifdef OCCLUSION_SSE
+                const __m128 steps = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+                __m128 e0 = _mm_add_ps(_mm_set1_ps(t.ea[0] * cx + t.eb[0] * cy + t.ec[0]), _mm_mul_ps(_mm_set1_ps(t.ea[0]), steps));
+                __m128 e1 = _mm_add_ps(_mm_set1_ps(t.ea[1] * cx + t.eb[1] * cy + t.ec[1]), _mm_mul_ps(_mm_set1_ps(t.ea[1]), steps));
+                __m128 e2 = _mm_add_ps(_mm_set1_ps(t.ea[2] * cx + t.eb[2] * cy + t.ec[2]), _mm_mul_ps(_mm_set1_ps(t.ea[2]), steps));
+                __m128 z = _mm_add_ps(_mm_set1_ps(t.za * cx + t.zb * cy + t.zc), _mm_mul_ps(_mm_set1_ps(t.za), steps));
+                const __m128 step0 = _mm_set1_ps(4.0f * t.ea[0]), step1 = _mm_set1_ps(4.0f * t.ea[1]), step2 = _mm_set1_ps(4.0f * t.ea[2]);
+                const __m128 stepZ = _mm_set1_ps(4.0f * t.za), zero = _mm_setzero_ps();
+                for (int x = xStart; x <= t.maxX; x += 4)
+                {
+                    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                    if (_mm_movemask_ps(inside))
+                    {
+                        __m128 old = _mm_loadu_ps(row + x);
+                        __m128 nearer = _mm_min_ps(old, z);
+                        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+                    }
+                    e0 = _mm_add_ps(e0, step0);
+                    e1 = _mm_add_ps(e1, step1);
+                    e2 = _mm_add_ps(e2, step2);
+                    z = _mm_add_ps(z, stepZ);
+                }
+#else
+                for (int x = xStart; x <= t.maxX; x++)
+                {
+                    float px = cx + (float)(x - xStart);
+                    if (t.ea[0] * px + t.eb[0] * cy + t.ec[0] >= 0.0f && t.ea[1] * px + t.eb[1] * cy + t.ec[1] >= 0.0f &&
+                        t.ea[2] * px + t.eb[2] * cy + t.ec[2] >= 0.0f)
+                        row[x] = std::min(row[x], t.za * px + t.zb * cy + t.zc);
+                }
+#endif
+            }
+        }
+
+        for (int tx = 0; tx < TilesX; tx++)
+        {
+            float farthest = -FLT_MAX;
+            for (int y = y0; y <= y1; y++)
+            {
+                const float* pixels = &depth[(size_t)y * Width + tx * TileSize];
+                for (int x = 0; x < TileSize; x++)
+                    farthest = std::max(farthest, pixels[x]);
+            }
+            tileMax[band * TilesX + tx] = farthest;
+        }
+    }
+};
+#endif
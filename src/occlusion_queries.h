@@ -0,0 +1,207 @@
+#ifndef OCCLUSION_QUERIES_H
+#define OCCLUSION_QUERIES_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// How objects of one class take part in hardware occlusion queries
+struct OcclusionQueryClass
+{
+    bool enabled = false;
+    unsigned int minTriangles = 256;    // objects drawn with fewer triangles are cheaper to draw than to query
+    unsigned int visibleInterval = 8;   // frames between the queries checking that a visible object still is
+};
+
+// What to do with an object this frame
+enum class QueryAction : uint8_t
+{
+    None,           // draw it
+    Visibility,     // draw it inside a query, to find out whether it became hidden
+    Proxy,          // query its bounding box, then draw it conditionally on that query
+    Reuse           // like Proxy, but its query still waits to be read, so the box goes into its second query object
+};
+
+// accumulated query counters
+struct OcclusionQueryStats
+{
+    unsigned long long frames = 0;
+    unsigned long long proxyQueries = 0, visibilityQueries = 0, conditionalDraws = 0;
+    unsigned long long resultsRead = 0, hiddenResults = 0;
+    unsigned long long deferredReads = 0;   // results not ready at the start of a frame: a stall avoided each
+
+    void print(std::ostream& out) const
+    {
+        if (frames == 0)
+            return;
+        double n = (double)frames;
+        out << "occlusion queries: avg " << proxyQueries / n << " proxy + " << visibilityQueries / n << " visibility queries, "
+            << conditionalDraws / n << " conditional draws per frame, " << resultsRead << " results read ("
+            << (resultsRead ? 100.0 * hiddenResults / resultsRead : 0.0) << "% hidden), " << deferredReads
+            << " reads deferred instead of stalling" << std::endl;
+    }
+};
+
+// Temporal coherence scheduling for GL_ANY_SAMPLES_PASSED queries, after CHC++ (Mattausch et al. 2008).
+// The CPU never waits for a query: results are collected at the start of a later frame, once available, and until
+// then every object keeps the visibility it had. Visible objects are drawn as usual and only every visibleInterval
+// frames (with a per-object offset, so the queries spread over frames) inside a query that tells whether they are
+// still visible. Hidden objects get a query on their bounding box every frame, and their real draw is wrapped in
+// glBeginConditionalRender on it: the GPU skips the draw if the box was hidden, without the CPU ever seeing the
+// result, and an object coming into view is drawn in the very frame it does.
+// The caller issues the queries and draws; classify() and issued() keep the per-object state.
+class OcclusionQueryScheduler
+{
+public:
+    void init(size_t objectCount)
+    {
+        objects.assign(objectCount, ObjectState());
+    }
+
+    // start a frame: take the results that are ready and leave the others for later
+    void beginFrame()
+    {
+        frame++;
+        stats.frames++;
+        size_t kept = 0;
+        for (uint32_t id : pending)
+        {
+            ObjectState& object = objects[id];
+            GLuint available = 0;
+            glGetQueryObjectuiv(object.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+            {
+                stats.deferredReads++;
+                pending[kept++] = id;
+                continue;
+            }
+            GLuint anySamples = 0;
+            glGetQueryObjectuiv(object.query, GL_QUERY_RESULT, &anySamples);
+            object.pending = false;
+            stats.resultsRead++;
+            if (anySamples)
+            {
+                // just came into view: check again after a full interval
+                if (!object.visible)
+                    object.nextCheck = frame + object.interval;
+                object.visible = true;
+            }
+            else
+            {
+                object.visible = false;
+                stats.hiddenResults++;
+            }
+        }
+        pending.resize(kept);
+    }
+
+    // the action for an object that passed culling this frame; nearCamera: its box reaches the near plane,
+    // where a box query could miss it
+    QueryAction classify(uint32_t id, const OcclusionQueryClass& objectClass, bool nearCamera)
+    {
+        ObjectState& object = objects[id];
+        unsigned int interval = objectClass.visibleInterval > 0 ? objectClass.visibleInterval : 1;
+        // not considered last frame (culled, or not worth a query): assume it is visible
+        if (object.lastFrame + 1 != frame)
+        {
+            object.visible = true;
+            object.nextCheck = frame + 1 + (uint32_t)(id * 2654435761u >> 16) % interval;
+        }
+        object.lastFrame = frame;
+        object.interval = interval;
+
+        if (nearCamera)
+        {
+            object.visible = true;
+            return QueryAction::None;
+        }
+        if (!object.visible)
+            return object.pending ? QueryAction::Reuse : QueryAction::Proxy;
+        if (object.pending || frame < object.nextCheck)
+            return QueryAction::None;
+        object.nextCheck = frame + interval;
+        return QueryAction::Visibility;
+    }
+
+    // the query object of an object, created on first use
+    GLuint query(uint32_t id)
+    {
+        ObjectState& object = objects[id];
+        if (!object.query)
+            glGenQueries(1, &object.query);
+        return object.query;
+    }
+
+    // the query object a Reuse box query goes into: only conditional rendering reads it, never the CPU, so the
+    // first one keeps its result for beginFrame() and the draw still depends on this frame's depth buffer
+    GLuint conditionQuery(uint32_t id)
+    {
+        ObjectState& object = objects[id];
+        if (!object.conditionQuery)
+            glGenQueries(1, &object.conditionQuery);
+        return object.conditionQuery;
+    }
+
+    // the caller ended a query of the given action on the object's query object, or for Reuse on its condition query
+    void issued(uint32_t id, QueryAction action)
+    {
+        if (action == QueryAction::Reuse)
+        {
+            stats.proxyQueries++;
+            return;
+        }
+        ObjectState& object = objects[id];
+        if (!object.pending)
+            pending.push_back(id);
+        object.pending = true;
+        if (action == QueryAction::Proxy)
+            stats.proxyQueries++;
+        else
+            stats.visibilityQueries++;
+    }
+
+    // the caller drew an object conditionally
+    void conditionalDraw()
+    {
+        stats.conditionalDraws++;
+    }
+
+    const OcclusionQueryStats& queryStats() const
+    {
+        return stats;
+    }
+
+    void destroy()
+    {
+        for (ObjectState& object : objects)
+        {
+            if (object.query)
+                glDeleteQueries(1, &object.query);
+            if (object.conditionQuery)
+                glDeleteQueries(1, &object.conditionQuery);
+            object.query = 0;
+            object.conditionQuery = 0;
+        }
+        pending.clear();
+    }
+
+private:
+    struct ObjectState
+    {
+        GLuint query = 0;
+        GLuint conditionQuery = 0;  // box queries while query is pending, see conditionQuery()
+        uint32_t lastFrame = 0;     // last frame classify() saw the object
+        uint32_t nextCheck = 0;     // frame of the next visibility query while visible
+        uint32_t interval = 1;
+        bool visible = true;
+        bool pending = false;       // a query was issued and its result not read yet
+    };
+
+    std::vector<ObjectState> objects;
+    std::vector<uint32_t> pending;
+    uint32_t frame = 1;
+    OcclusionQueryStats stats;
+};
+#endif
@@ -0,0 +1,304 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Frame profiler with named scopes. Every scope records its CPU time with std::chrono and its GPU time as the
+// difference of two GL_TIMESTAMP counters written at its start and end. Query results are only read back
+// FramesInFlight frames later, and only if they are already available, so profiling never stalls the pipeline.
+// Scopes run one after another within a frame. Timestamps rather than GL_TIME_ELAPSED, because llvmpipe does not
+// record the start of the first elapsed-time query that does GPU work and reports its end time as the duration.
+class FrameProfiler
+{
+public:
+    static const int FramesInFlight = 3;
+    static const int MaxScopes = 16;
+    static const size_t MaxHistoryFrames = 36000;   // ten minutes at 60 fps
+
+    // one scope of one frame; cpuStartMs is negative when the scope did not run that frame,
+    // gpuMs is negative when the query result never became available
+    struct Sample
+    {
+        double cpuStartMs;  // since the profiler was created
+        double cpuMs;
+        double gpuMs;
+    };
+    struct Frame
+    {
+        unsigned long long index;
+        Sample scopes[MaxScopes];
+    };
+
+    // windowFrames: number of recent frames the percentiles are computed over
+    explicit FrameProfiler(size_t windowFrames = 600)
+        : window(windowFrames), origin(std::chrono::steady_clock::now())
+    {
+        glGenQueries(FramesInFlight * MaxScopes * 2, &queries[0][0][0]);
+        for (int slot = 0; slot < FramesInFlight; slot++)
+            pending[slot].inUse = false;
+    }
+
+    ~FrameProfiler()
+    {
+        glDeleteQueries(FramesInFlight * MaxScopes * 2, &queries[0][0][0]);
+    }
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // frame boundaries
+    // ------------------------------------------------------------------------
+    void beginFrame()
+    {
+        // the slot we are about to reuse belongs to the frame FramesInFlight ago
+        collect(slot, false);
+        frameStarted = true;
+        Pending& frame = pending[slot];
+        frame.inUse = true;
+        frame.index = frameIndex;
+        for (int i = 0; i < MaxScopes; i++)
+        {
+            frame.samples[i] = Sample{ -1.0, 0.0, -1.0 };
+            frame.written[i] = false;
+        }
+    }
+
+    void endFrame()
+    {
+        frameStarted = false;
+        slot = (slot + 1) % FramesInFlight;
+        frameIndex++;
+    }
+
+    // named scopes, e.g. "input", "clear", "uniform upload", "draw", "swap"
+    // ------------------------------------------------------------------------
+    void beginScope(const char* name)
+    {
+        // scopes outside beginFrame/endFrame belong to no frame and are not recorded
+        current = frameStarted ? scopeIndex(name) : -1;
+        if (current < 0)
+            return;
+        glQueryCounter(queries[slot][current][0], GL_TIMESTAMP);
+        scopeStart = std::chrono::steady_clock::now();
+    }
+
+    void endScope()
+    {
+        if (current < 0)
+            return;
+        auto now = std::chrono::steady_clock::now();
+        glQueryCounter(queries[slot][current][1], GL_TIMESTAMP);
+        // both counters of this scope are written in this frame's slot, so collect() may read them
+        pending[slot].written[current] = true;
+        Sample& sample = pending[slot].samples[current];
+        sample.cpuStartMs = std::chrono::duration<double, std::milli>(scopeStart - origin).count();
+        sample.cpuMs = std::chrono::duration<double, std::milli>(now - scopeStart).count();
+        current = -1;
+    }
+
+    // wait for the queries still in flight; call once before reporting
+    void flush()
+    {
+        glFinish();
+        for (int i = 0; i < FramesInFlight; i++)
+            collect((slot + i) % FramesInFlight, true);
+    }
+
+    // reports
+    // ------------------------------------------------------------------------
+    // p50/p95/p99 of CPU and GPU time per scope over the rolling window
+    void printSummary(std::ostream& out) const
+    {
+        out << "profile over the last " << std::min(window, history.size()) << " frames (ms)"
+            << ", GPU results read without waiting: " << resultsReady << ", not ready in time: " << resultsMissed << std::endl;
+        out << std::left << std::setw(16) << "scope"
+            << std::right << std::setw(10) << "cpu p50" << std::setw(10) << "cpu p95" << std::setw(10) << "cpu p99"
+            << std::setw(10) << "gpu p50" << std::setw(10) << "gpu p95" << std::setw(10) << "gpu p99" << std::endl;
+        out << std::fixed << std::setprecision(3);
+        for (size_t s = 0; s < names.size(); s++)
+        {
+            std::vector<double> cpu, gpu;
+            size_t first = history.size() > window ? history.size() - window : 0;
+            for (size_t f = first; f < history.size(); f++)
+            {
+                if (history[f].scopes[s].cpuStartMs < 0.0)
+                    continue;
+                cpu.push_back(history[f].scopes[s].cpuMs);
+                if (history[f].scopes[s].gpuMs >= 0.0)
+                    gpu.push_back(history[f].scopes[s].gpuMs);
+            }
+            out << std::left << std::setw(16) << names[s] << std::right
+                << std::setw(10) << percentile(cpu, 50) << std::setw(10) << percentile(cpu, 95) << std::setw(10) << percentile(cpu, 99)
+                << std::setw(10) << percentile(gpu, 50) << std::setw(10) << percentile(gpu, 95) << std::setw(10) << percentile(gpu, 99) << std::endl;
+        }
+        out << std::defaultfloat << std::setprecision(6);
+    }
+
+    // write the recorded frames (up to MaxHistoryFrames); ".json" produces a Chrome trace (chrome://tracing, Perfetto), anything else CSV
+    bool write(const std::string& path) const
+    {
+        bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        return json ? writeChromeTrace(path) : writeCSV(path);
+    }
+
+    bool writeCSV(const std::string& path) const
+    {
+        std::ofstream file(path);
+        if (!file)
+            return false;
+        file << "frame,scope,cpu_start_ms,cpu_ms,gpu_ms\n";
+        for (const Frame& frame : history)
+        {
+            for (size_t s = 0; s < names.size(); s++)
+            {
+                const Sample& sample = frame.scopes[s];
+                if (sample.cpuStartMs < 0.0)
+                    continue;
+                file << frame.index << "," << names[s] << "," << sample.cpuStartMs << "," << sample.cpuMs << ",";
+                if (sample.gpuMs >= 0.0)
+                    file << sample.gpuMs;
+                file << "\n";
+            }
+        }
+        return bool(file);
+    }
+
+    // CPU scopes go on thread 1; GPU durations on thread 2, placed at the CPU start of their scope
+    // since GL timestamps run on a clock of their own
+    bool writeChromeTrace(const std::string& path) const
+    {
+        std::ofstream file(path);
+        if (!file)
+            return false;
+        file << "{\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+        for (const Frame& frame : history)
+        {
+            for (size_t s = 0; s < names.size(); s++)
+            {
+                const Sample& sample = frame.scopes[s];
+                if (sample.cpuStartMs < 0.0)
+                    continue;
+                file << ",\n{\"name\":\"" << names[s] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << sample.cpuStartMs * 1000.0
+                     << ",\"dur\":" << sample.cpuMs * 1000.0 << ",\"args\":{\"frame\":" << frame.index << "}}";
+                if (sample.gpuMs >= 0.0)
+                    file << ",\n{\"name\":\"" << names[s] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":" << sample.cpuStartMs * 1000.0
+                         << ",\"dur\":" << sample.gpuMs * 1000.0 << ",\"args\":{\"frame\":" << frame.index << "}}";
+            }
+        }
+        file << "\n]}\n";
+        return bool(file);
+    }
+
+private:
+    struct Pending
+    {
+        bool inUse;
+        unsigned long long index;
+        Sample samples[MaxScopes];
+        bool written[MaxScopes];   // both timestamps of the scope were issued in this frame
+    };
+
+    size_t window;
+    std::chrono::steady_clock::time_point origin, scopeStart;
+    GLuint queries[FramesInFlight][MaxScopes][2];   // start and end timestamp of each scope
+    Pending pending[FramesInFlight];
+    std::vector<const char*> names;
+    std::deque<Frame> history;
+    int slot = 0;
+    int current = -1;
+    bool frameStarted = false;
+    unsigned long long frameIndex = 0;
+    unsigned long long resultsReady = 0, resultsMissed = 0;
+
+    int scopeIndex(const char* name)
+    {
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            if (std::strcmp(names[i], name) == 0)
+                return (int)i;
+        }
+        if (names.size() == MaxScopes)
+            return -1;
+        names.push_back(name);
+        return (int)names.size() - 1;
+    }
+
+    // move a finished frame into the history; only scopes whose counters were written this frame are read, and
+    // only once GL reports them available. flushed: flush() already waited for the GPU, so results that are
+    // available then do not count as read without waiting
+    void collect(int frameSlot, bool flushed)
+    {
+        Pending& frame = pending[frameSlot];
+        if (!frame.inUse)
+            return;
+        Frame record;
+        record.index = frame.index;
+        for (int i = 0; i < MaxScopes; i++)
+        {
+            record.scopes[i] = frame.samples[i];
+            if (!frame.written[i])
+                continue;
+            GLint startAvailable = 0, endAvailable = 0;
+            glGetQueryObjectiv(queries[frameSlot][i][0], GL_QUERY_RESULT_AVAILABLE, &startAvailable);
+            glGetQueryObjectiv(queries[frameSlot][i][1], GL_QUERY_RESULT_AVAILABLE, &endAvailable);
+            if (!startAvailable || !endAvailable)
+            {
+                resultsMissed++;
+                continue;
+            }
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(queries[frameSlot][i][0], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(queries[frameSlot][i][1], GL_QUERY_RESULT, &end);
+            resultsReady += flushed ? 0 : 1;
+            if (end >= start)
+                record.scopes[i].gpuMs = (end - start) / 1.0e6;
+        }
+        history.push_back(record);
+        if (history.size() > MaxHistoryFrames)
+            history.pop_front();
+        frame.inUse = false;
+    }
+
+    static double percentile(std::vector<double>& values, double p)
+    {
+        if (values.empty())
+            return 0.0;
+        std::sort(values.begin(), values.end());
+        size_t rank = static_cast<size_t>(p / 100.0 * (values.size() - 1) + 0.5);
+        return values[std::min(rank, values.size() - 1)];
+    }
+};
+
+// Times the enclosing block as one profiler scope; does nothing when profiler is null
+class ProfileScope
+{
+public:
+    ProfileScope(FrameProfiler* frameProfiler, const char* name) : profiler(frameProfiler)
+    {
+        if (profiler)
+            profiler->beginScope(name);
+    }
+    ~ProfileScope()
+    {
+        if (profiler)
+            profiler->endScope();
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    FrameProfiler* profiler;
+};
+#endif
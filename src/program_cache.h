@@ -0,0 +1,157 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include "hash.h"
+#include "mapped_file.h"
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// header of a .b3pb program binary cache entry, followed by the binary itself
+struct ProgramBinaryHeader
+{
+    char magic[4];              // "B3PB"
+    uint32_t version;
+    uint64_t key;               // the key the file is named after, to catch truncated names and collisions
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+};
+
+static const uint32_t ProgramBinaryVersion = 1;
+
+// On-disk cache of linked programs (GL_ARB_get_program_binary, core since 4.1).
+// Entries are keyed by the FNV-1a hash of the shader sources together with GL_VENDOR, GL_RENDERER and
+// GL_VERSION, so a driver update or a different GPU simply misses instead of feeding a foreign binary
+// to glProgramBinary. The driver may still reject a binary; callers then compile from source and store again.
+class ProgramBinaryCache
+{
+public:
+    explicit ProgramBinaryCache(const std::string& cacheDirectory) : directory(cacheDirectory)
+    {
+        GLint formats = 0;
+        if (GLAD_GL_ARB_get_program_binary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        supported = formats > 0 && !directory.empty();
+        if (supported)
+            mkdir(directory.c_str(), 0755);
+
+        const char* strings[] = { (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER),
+                                  (const char*)glGetString(GL_VERSION) };
+        driverHash = fnv1a64(std::string());
+        for (const char* string : strings)
+            driverHash = fnv1a64(std::string(string ? string : "") + "\n", driverHash);
+    }
+
+    // false if the driver offers no binary formats; load() then always misses and store() does nothing
+    bool enabled() const
+    {
+        return supported;
+    }
+
+    uint64_t key(const std::string& vertexCode, const std::string& fragmentCode) const
+    {
+        // the separator keeps "ab" + "c" and "a" + "bc" apart
+        return fnv1a64(fragmentCode, fnv1a64(vertexCode + '\0', driverHash));
+    }
+
+    std::string entryPath(const std::string& vertexCode, const std::string& fragmentCode) const
+    {
+        return directory + "/" + hashToHex(key(vertexCode, fragmentCode)) + ".b3pb";
+    }
+
+    // a new linked program from the cache, or 0 if there is no valid entry
+    // ------------------------------------------------------------------------
+    GLuint load(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        if (!supported)
+            return 0;
+        MappedFile file;
+        ProgramBinaryHeader header;
+        uint64_t expected = key(vertexCode, fragmentCode);
+        if (!file.open(entryPath(vertexCode, fragmentCode)) || file.size() < sizeof(header))
+        {
+            misses++;
+            return 0;
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, "B3PB", 4) != 0 || header.version != ProgramBinaryVersion || header.key != expected ||
+            file.size() != sizeof(header) + header.binaryLength)
+        {
+            misses++;
+            return 0;
+        }
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, header.binaryFormat, file.data() + sizeof(header), (GLsizei)header.binaryLength);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            // e.g. the driver changed its binary format without changing its version string
+            glDeleteProgram(program);
+            rejected++;
+            return 0;
+        }
+        hits++;
+        return program;
+    }
+
+    // save a linked program; it must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    // written under a temporary name and renamed, so a concurrent reader never sees half an entry
+    // ------------------------------------------------------------------------
+    bool store(const std::string& vertexCode, const std::string& fragmentCode, GLuint program)
+    {
+        if (!supported)
+            return false;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+        std::vector<unsigned char> binary((size_t)length);
+        ProgramBinaryHeader header;
+        std::memcpy(header.magic, "B3PB", 4);
+        header.version = ProgramBinaryVersion;
+        header.key = key(vertexCode, fragmentCode);
+        GLenum format = 0;
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &format, binary.data());
+        if (written <= 0)
+            return false;
+        header.binaryFormat = format;
+        header.binaryLength = (uint32_t)written;
+
+        std::string path = entryPath(vertexCode, fragmentCode), temporary;
+        FILE* file = createTemporaryFile(path, temporary);
+        if (!file)
+            return false;
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        ok = ok && std::fwrite(binary.data(), 1, (size_t)written, file) == (size_t)written;
+        ok = (std::fclose(file) == 0) && ok;
+        if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        stores++;
+        return true;
+    }
+
+    unsigned int hitCount() const { return hits; }
+    unsigned int missCount() const { return misses; }
+    unsigned int rejectedCount() const { return rejected; }
+    unsigned int storeCount() const { return stores; }
+
+private:
+    std::string directory;
+    bool supported = false;
+    uint64_t driverHash = 0;
+    unsigned int hits = 0, misses = 0, rejected = 0, stores = 0;
+};
+#endif
@@ -0,0 +1,314 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+// Draw passes in submission order
+enum class RenderPass : uint32_t
+{
+    Opaque = 0,         // front to back, so hidden fragments fail the depth test early
+    Transparent = 1     // back to front, for blending
+};
+
+// One draw: a sort key and the object it draws
+struct DrawPacket
+{
+    uint64_t key;
+    uint32_t object;
+};
+
+// Binds GL state only when it differs from what this cache last bound.
+// It cannot see binds made by other code, so reset() it whenever that may have happened.
+class StateCache
+{
+public:
+    static const unsigned int MaxTextureUnits = 16;
+
+    void reset()
+    {
+        program = vertexArray = ~0u;
+        activeUnit = ~0u;
+        for (GLuint& texture : textures)
+            texture = ~0u;
+    }
+
+    void useProgram(GLuint id)
+    {
+        if (id == program)
+        {
+            skipped++;
+            return;
+        }
+        glUseProgram(id);
+        program = id;
+        changes++;
+    }
+
+    void bindTexture(GLuint unit, GLuint texture, GLenum target = GL_TEXTURE_2D)
+    {
+        if (textures[unit] == texture)
+        {
+            skipped++;
+            return;
+        }
+        if (activeUnit != unit)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            activeUnit = unit;
+        }
+        glBindTexture(target, texture);
+        textures[unit] = texture;
+        changes++;
+    }
+
+    void bindVertexArray(GLuint id)
+    {
+        if (id == vertexArray)
+        {
+            skipped++;
+            return;
+        }
+        glBindVertexArray(id);
+        vertexArray = id;
+        changes++;
+    }
+
+    unsigned long long changes = 0;     // binds issued
+    unsigned long long skipped = 0;     // redundant binds not issued
+
+private:
+    GLuint program = ~0u, vertexArray = ~0u, activeUnit = ~0u;
+    GLuint textures[MaxTextureUnits] = { ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u };
+};
+
+// Per-frame list of draw packets, sorted by a 64-bit key so that draws sharing state end up next to each other.
+// Key layout, most significant bits first:
+//   | pass 2 | program 10 | texture set 12 | mesh 8 | view depth 32 |
+// Program, texture set and mesh (vertex array and index range, e.g. one level of detail) are small indices
+// into the caller's tables, not GL names.
+// The depth is the view space distance as an order-preserving integer, inverted in the transparent pass.
+// sort() is an LSD radix sort over the key bytes that skips bytes all keys share, which in practice are most of them.
+class RenderQueue
+{
+public:
+    static const uint32_t MaxPrograms = 1u << 10;
+    static const uint32_t MaxTextureSets = 1u << 12;
+    static const uint32_t MaxMeshes = 1u << 8;
+
+    static uint64_t makeKey(RenderPass pass, uint32_t program, uint32_t textureSet, uint32_t mesh, float viewDepth)
+    {
+        uint32_t depth = sortableDepth(viewDepth);
+        if (pass == RenderPass::Transparent)
+            depth = ~depth;
+        return (uint64_t)pass << 62 | (uint64_t)(program & (MaxPrograms - 1)) << 52
+             | (uint64_t)(textureSet & (MaxTextureSets - 1)) << 40 | (uint64_t)(mesh & (MaxMeshes - 1)) << 32 | depth;
+    }
+
+    static RenderPass pass(uint64_t key) { return (RenderPass)(key >> 62); }
+    static uint32_t program(uint64_t key) { return (uint32_t)(key >> 52) & (MaxPrograms - 1); }
+    static uint32_t textureSet(uint64_t key) { return (uint32_t)(key >> 40) & (MaxTextureSets - 1); }
+    static uint32_t mesh(uint64_t key) { return (uint32_t)(key >> 32) & (MaxMeshes - 1); }
+
+    // the key without the depth: packets with equal state keys can share binds (and an instanced draw)
+    static uint64_t stateKey(uint64_t key) { return key >> 32; }
+
+    // overdraw: count the fragments that pass the depth test, which costs a query per frame; the context must be current
+    void init(bool overdraw)
+    {
+        measureOverdraw = overdraw;
+        if (measureOverdraw)
+            glGenQueries(QuerySlots, queries);
+    }
+
+    void clear()
+    {
+        queue.clear();
+    }
+
+    void push(uint64_t key, uint32_t object)
+    {
+        queue.push_back(DrawPacket{ key, object });
+    }
+
+    // replace the packets with count to be written in place, e.g. by several threads at once
+    DrawPacket* assign(size_t count)
+    {
+        queue.resize(count);
+        return queue.data();
+    }
+
+    void sort()
+    {
+        size_t count = queue.size();
+        if (count < 2)
+            return;
+        scratch.resize(count);
+
+        // one histogram pass for all eight key bytes
+        size_t histograms[8][256];
+        std::memset(histograms, 0, sizeof(histograms));
+        for (const DrawPacket& packet : queue)
+            for (int b = 0; b < 8; b++)
+                histograms[b][(packet.key >> (b * 8)) & 0xff]++;
+
+        DrawPacket* from = queue.data();
+        DrawPacket* to = scratch.data();
+        for (int b = 0; b < 8; b++)
+        {
+            size_t* histogram = histograms[b];
+            // every key has the same byte here: this pass would not move anything
+            if (histogram[(from[0].key >> (b * 8)) & 0xff] == count)
+                continue;
+
+            size_t offset = 0;
+            for (int digit = 0; digit < 256; digit++)
+            {
+                size_t n = histogram[digit];
+                histogram[digit] = offset;
+                offset += n;
+            }
+            for (size_t i = 0; i < count; i++)
+                to[histogram[(from[i].key >> (b * 8)) & 0xff]++] = from[i];
+            std::swap(from, to);
+        }
+        if (from != queue.data())
+            queue.swap(scratch);
+    }
+
+    // move the packets pred selects to out, keeping their order; pred is called once per packet, in queue order
+    template <typename Pred>
+    void extract(Pred pred, std::vector<DrawPacket>& out)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < queue.size(); i++)
+        {
+            if (pred(queue[i]))
+                out.push_back(queue[i]);
+            else
+                queue[kept++] = queue[i];
+        }
+        queue.resize(kept);
+    }
+
+    const std::vector<DrawPacket>& packets() const
+    {
+        return queue;
+    }
+
+    // the state cache draws are submitted through
+    StateCache& state()
+    {
+        return cache;
+    }
+
+    // Bracket the frame's draws: forgets the cached state and, when measuring overdraw, counts the fragments that
+    // pass the depth test with a GL_SAMPLES_PASSED query, read back QuerySlots frames later and only if already available.
+    void beginSubmit()
+    {
+        cache.reset();
+        frameChanges = cache.changes;
+        frameSkipped = cache.skipped;
+        if (measureOverdraw)
+        {
+            collect(slot);
+            glBeginQuery(GL_SAMPLES_PASSED, queries[slot]);
+        }
+    }
+
+    // pixels: size of the render target, the overdraw reference
+    void endSubmit(unsigned long long pixels)
+    {
+        if (measureOverdraw)
+        {
+            glEndQuery(GL_SAMPLES_PASSED);
+            queryPixels[slot] = pixels;
+            slot = (slot + 1) % QuerySlots;
+        }
+
+        frames++;
+        packetTotal += queue.size();
+        changeTotal += cache.changes - frameChanges;
+        skippedTotal += cache.skipped - frameSkipped;
+    }
+
+    // draw calls made for the queue's packets, the query pass included
+    void countDraws(unsigned long long count)
+    {
+        drawTotal += count;
+    }
+
+    // sums over the submitted frames
+    struct Totals
+    {
+        unsigned long long frames, packets, drawCalls, stateChanges, skipped;
+    };
+    Totals totals() const
+    {
+        return Totals{ frames, packetTotal, drawTotal, changeTotal, skippedTotal };
+    }
+
+    // per-frame averages: packets, draw calls, binds issued and skipped, depth-passed fragments per pixel
+    void printStats(std::ostream& out) const
+    {
+        double n = frames > 0 ? (double)frames : 1.0;
+        out << "render queue: " << packetTotal / n << " packets, " << drawTotal / n << " draw calls, "
+            << changeTotal / n << " state changes, " << skippedTotal / n << " redundant binds skipped per frame";
+        if (measureOverdraw)
+            out << ", overdraw " << (pixelTotal > 0 ? (double)sampleTotal / pixelTotal : 0.0) << " fragments per pixel";
+        out << std::endl;
+    }
+
+    void destroy()
+    {
+        if (measureOverdraw)
+            glDeleteQueries(QuerySlots, queries);
+        measureOverdraw = false;
+    }
+
+private:
+    static const int QuerySlots = 3;
+
+    std::vector<DrawPacket> queue, scratch;
+    StateCache cache;
+
+    bool measureOverdraw = false;
+    GLuint queries[QuerySlots] = {};
+    unsigned long long queryPixels[QuerySlots] = {};
+    int slot = 0;
+
+    unsigned long long frames = 0, packetTotal = 0, drawTotal = 0, changeTotal = 0, skippedTotal = 0;
+    unsigned long long frameChanges = 0, frameSkipped = 0;
+    unsigned long long sampleTotal = 0, pixelTotal = 0;
+
+    // float bits reordered so that unsigned comparison matches float comparison, negative values included
+    static uint32_t sortableDepth(float depth)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+    }
+
+    // add the result of the query in slot s, if it was issued and has finished
+    void collect(int s)
+    {
+        if (queryPixels[s] == 0)
+            return;
+        GLuint available = 0;
+        glGetQueryObjectuiv(queries[s], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint samples = 0;
+            glGetQueryObjectuiv(queries[s], GL_QUERY_RESULT, &samples);
+            sampleTotal += samples;
+            pixelTotal += queryPixels[s];
+        }
+        queryPixels[s] = 0;
+    }
+};
+#endif
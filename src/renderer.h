@@ -0,0 +1,1393 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader_s.h"
+#include "shader_library.h"
+#include "glb_loader.h"
+#include "job_system.h"
+#include "mesh.h"
+#include "mesh_import.h"
+#include "mesh_lod.h"
+#include "occlusion.h"
+#include "occlusion_queries.h"
+#include "scene.h"
+#include "profiler.h"
+#include "render_queue.h"
+#include "texture_arrays.h"
+#include "texture_loader.h"
+#include "transform_hierarchy.h"
+#include "stream_buffer.h"
+#include "uniform_buffers.h"
+#include "vertex_layout.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// how the cubes are submitted
+enum class DrawPath
+{
+    Legacy,         // one glDrawElements per cube, model matrix set with glUniformMatrix4fv
+    UniformBuffer,  // one glDrawElements per cube, model matrix selected in a per-object uniform buffer with glBindBufferRange
+    Instanced       // one glDrawElementsInstanced, model matrices in a per-instance vertex buffer
+};
+
+inline const char* drawPathName(DrawPath path)
+{
+    switch (path)
+    {
+    case DrawPath::UniformBuffer: return "uniform buffer";
+    case DrawPath::Instanced: return "instanced";
+    case DrawPath::Legacy:
+    default: return "legacy";
+    }
+}
+
+// the mesh every object is drawn with
+enum class MeshShape
+{
+    Cube,   // the classic 12 triangle textured cube
+    Sphere, // a finely tessellated UV sphere, where levels of detail pay off
+    File    // an OBJ, PLY or STL file, shown while it is still being imported
+};
+
+// a mesh ready to be uploaded: its levels of detail, the chain its occluders come from and what building it did
+struct PreparedMesh
+{
+    LodChain lods;
+    LodChain occluderLods;  // empty without occlusion culling
+    MeshStats stats;
+};
+
+// vertex formats of the uploaded mesh: quantized positions and half float uvs, or the original five floats
+typedef VertexLayout<Pos_Snorm16x4, UV_Half2> PackedVertexLayout;
+typedef VertexLayout<Pos_Float3, UV_Float2> FloatVertexLayout;
+
+// settings shared by the windowed viewer and the headless renderer
+struct RenderSettings
+{
+    DrawPath drawPath = DrawPath::Legacy;
+    unsigned int cubeCount = 10;
+    bool asyncTextures = true;  // decode textures on worker threads and upload them while rendering
+    std::string textureCache = "texture_cache"; // cooked texture directory used by the asynchronous loader, empty to disable
+    std::string shaderCache = "shader_cache";   // program binary directory, empty to always compile from source
+    bool culling = true;        // draw only the cubes inside the view frustum
+    unsigned int framesInFlight = 3;    // frames the CPU may run ahead of the GPU in the stream buffer
+    bool persistentMapping = true;      // map the stream buffer persistently when GL_ARB_buffer_storage is available
+    unsigned int materials = 1;         // texture sets the cubes cycle through
+    bool sortDraws = true;              // sort the render queue by state and depth
+    bool textureArrays = false;         // pack all images into one array texture and select them per object
+    MeshShape mesh = MeshShape::Cube;
+    std::string meshPath;               // MeshShape::File
+    float lodPixelError = 1.0f;         // screen-space error in pixels a level of detail may show
+    std::string meshCache = "mesh_cache";   // built LOD chains, empty to always build
+    bool packedVertices = true;         // upload the mesh as PackedVertexLayout instead of FloatVertexLayout
+    bool occlusion = true;              // drop cubes hidden behind the nearest ones (needs culling)
+    unsigned int occluders = 32;        // nearest visible cubes rasterized as occluders per frame
+    bool occlusionQueries = false;      // GPU occlusion queries with conditional rendering (needs culling)
+    // query settings per object class, indexed by MeshShape: the cube is cheaper to draw than to query
+    OcclusionQueryClass queryClasses[3] = { { false, 256, 8 }, { true, 256, 8 }, { true, 256, 8 } };
+    unsigned int jobThreads = 0;        // threads the per-frame work is spread over, the render thread included (0 = one per core)
+    bool overdrawStats = false;         // count depth-passed fragments with a query per frame (--overdraw, --profile)
+};
+
+// Parse "cube|sphere|file:off" or "cube|sphere|file:MIN_TRIANGLES[:INTERVAL]" into the query class it names
+inline bool parseQueryClass(const std::string& value, RenderSettings& settings)
+{
+    size_t colon = value.find(':');
+    std::string name = value.substr(0, colon);
+    if (colon == std::string::npos || (name != "cube" && name != "sphere" && name != "file"))
+        return false;
+    MeshShape shape = name == "sphere" ? MeshShape::Sphere : name == "file" ? MeshShape::File : MeshShape::Cube;
+    OcclusionQueryClass& queryClass = settings.queryClasses[(int)shape];
+    std::string options = value.substr(colon + 1);
+    if (options == "off")
+    {
+        queryClass.enabled = false;
+        return true;
+    }
+    // both numbers must be plain unsigned integers, anything else is left to the usage message
+    const char* start = options.c_str();
+    char* end = nullptr;
+    unsigned long minTriangles = std::strtoul(start, &end, 10);
+    if (end == start || !std::isdigit((unsigned char)*start) || (*end != '\0' && *end != ':'))
+        return false;
+    unsigned int visibleInterval = queryClass.visibleInterval;
+    if (*end == ':')
+    {
+        const char* intervalStart = end + 1;
+        visibleInterval = static_cast<unsigned int>(std::strtoul(intervalStart, &end, 10));
+        if (end == intervalStart || !std::isdigit((unsigned char)*intervalStart) || *end != '\0')
+            return false;
+    }
+    queryClass.enabled = true;
+    queryClass.minTriangles = static_cast<unsigned int>(minTriangles);
+    queryClass.visibleInterval = visibleInterval;
+    return true;
+}
+
+// Parse one of the command line options understood by every front end, advancing i past its value.
+// Returns false if argv[i] is not a render setting.
+inline bool parseRenderSetting(int argc, char* argv[], int& i, RenderSettings& settings)
+{
+    std::string arg = argv[i];
+    if (arg == "--instanced")
+        settings.drawPath = DrawPath::Instanced;
+    else if (arg == "--ubo")
+        settings.drawPath = DrawPath::UniformBuffer;
+    else if (arg == "--legacy")
+        settings.drawPath = DrawPath::Legacy;
+    else if (arg == "--cubes" && i + 1 < argc)
+        settings.cubeCount = static_cast<unsigned int>(std::strtoul(argv[++i], NULL, 10));
+    else if (arg == "--sync-textures")
+        settings.asyncTextures = false;
+    else if (arg == "--texture-cache" && i + 1 < argc)
+        settings.textureCache = argv[++i];
+    else if (arg == "--no-texture-cache")
+        settings.textureCache.clear();
+    else if (arg == "--shader-cache" && i + 1 < argc)
+        settings.shaderCache = argv[++i];
+    else if (arg == "--no-shader-cache")
+        settings.shaderCache.clear();
+    else if (arg == "--no-cull")
+        settings.culling = false;
+    else if (arg == "--frames-in-flight" && i + 1 < argc)
+        settings.framesInFlight = static_cast<unsigned int>(std::strtoul(argv[++i], NULL, 10));
+    else if (arg == "--no-persistent-map")
+        settings.persistentMapping = false;
+    else if (arg == "--materials" && i + 1 < argc)
+        settings.materials = static_cast<unsigned int>(std::strtoul(argv[++i], NULL, 10));
+    else if (arg == "--no-sort")
+        settings.sortDraws = false;
+    else if (arg == "--texture-arrays")
+        settings.textureArrays = true;
+    else if (arg == "--mesh" && i + 1 < argc)
+    {
+        std::string mesh = argv[++i];
+        settings.mesh = mesh == "sphere" ? MeshShape::Sphere : mesh == "cube" ? MeshShape::Cube : MeshShape::File;
+        settings.meshPath = settings.mesh == MeshShape::File ? mesh : std::string();
+    }
+    else if (arg == "--lod-error" && i + 1 < argc)
+        settings.lodPixelError = static_cast<float>(std::strtod(argv[++i], NULL));
+    else if (arg == "--mesh-cache" && i + 1 < argc)
+        settings.meshCache = argv[++i];
+    else if (arg == "--no-mesh-cache")
+        settings.meshCache.clear();
+    else if (arg == "--float-vertices")
+        settings.packedVertices = false;
+    else if (arg == "--no-occlusion")
+        settings.occlusion = false;
+    else if (arg == "--occluders" && i + 1 < argc)
+        settings.occluders = static_cast<unsigned int>(std::strtoul(argv[++i], NULL, 10));
+    else if (arg == "--occlusion-queries")
+        settings.occlusionQueries = true;
+    else if (arg == "--query-class" && i + 1 < argc)
+        return parseQueryClass(argv[++i], settings);
+    else if (arg == "--jobs" && i + 1 < argc)
+        settings.jobThreads = static_cast<unsigned int>(std::strtoul(argv[++i], NULL, 10));
+    else if (arg == "--overdraw")
+        settings.overdrawStats = true;
+    else
+        return false;
+    return true;
+}
+
+// usage text for the options above
+inline const char* renderSettingsUsage()
+{
+    return "[--legacy | --ubo | --instanced] [--cubes N] [--sync-textures] [--texture-cache DIR | --no-texture-cache] [--shader-cache DIR | --no-shader-cache] [--no-cull]"
+           " [--frames-in-flight N] [--no-persistent-map] [--materials N] [--no-sort] [--texture-arrays]"
+           " [--mesh cube|sphere|FILE.obj|.ply|.stl] [--lod-error PX] [--mesh-cache DIR | --no-mesh-cache] [--float-vertices] [--no-occlusion] [--occluders N]"
+           " [--occlusion-queries] [--query-class cube|sphere|file:off|MIN_TRIANGLES[:INTERVAL]] [--jobs N] [--overdraw]";
+}
+
+// whether --mesh names a binary glTF file, which is loaded as a scene instead of a mesh
+inline bool isGlbPath(const std::string& path)
+{
+    return path.size() > 4 && (path.compare(path.size() - 4, 4, ".glb") == 0 || path.compare(path.size() - 4, 4, ".GLB") == 0);
+}
+
+// World space position of the cube with the given index
+// The first ten are the classic hand-placed cubes, the rest fill a grid behind them so large counts stay in view
+inline glm::vec3 cubePosition(unsigned int index, unsigned int cubeCount)
+{
+    static const glm::vec3 classicPositions[] = {
+        glm::vec3( 0.0f,  0.0f,  0.0f),
+        glm::vec3( 2.0f,  5.0f, -15.0f),
+        glm::vec3(-1.5f, -2.2f, -2.5f),
+        glm::vec3(-3.8f, -2.0f, -12.3f),
+        glm::vec3( 2.4f, -0.4f, -3.5f),
+        glm::vec3(-1.7f,  3.0f, -7.5f),
+        glm::vec3( 1.3f, -2.0f, -2.5f),
+        glm::vec3( 1.5f,  2.0f, -2.5f),
+        glm::vec3( 1.5f,  0.2f, -1.5f),
+        glm::vec3(-1.3f,  1.0f, -1.5f)
+    };
+    if (index < 10)
+        return classicPositions[index];
+
+    // grid with a square cross-section that grows in depth, two units between cube centers
+    unsigned int side = static_cast<unsigned int>(std::ceil(std::cbrt(static_cast<double>(cubeCount))));
+    unsigned int gridIndex = index - 10;
+    float x = static_cast<float>(gridIndex % side) - side * 0.5f;
+    float y = static_cast<float>((gridIndex / side) % side) - side * 0.5f;
+    float z = static_cast<float>(gridIndex / (side * side));
+    return glm::vec3(x * 2.0f, y * 2.0f, -20.0f - z * 2.0f);
+}
+
+// Transform of the cube with the given index: at its position, rotated by 20 degrees per index
+inline Transform cubeTransform(unsigned int index, const glm::vec3& position)
+{
+    float angle = 20.0f * index;
+    return Transform{ position, glm::angleAxis(glm::radians(angle), glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f))), glm::vec3(1.0f) };
+}
+
+// The textured cube scene: owns the shader, geometry and textures and draws one frame for a given camera.
+// It only needs a current GL 3.3 core context, so the GLFW window and the headless EGL context both drive it.
+class CubeRenderer
+{
+public:
+    RenderSettings settings;
+    std::unique_ptr<ShaderLibrary> shaders;
+    Shader* shader = nullptr;   // owned by shaders, hot reloaded when its files change
+
+    // create all GL resources; the context must be current
+    // ------------------------------------------------------------------------
+    void init(const RenderSettings& renderSettings)
+    {
+        settings = renderSettings;
+        jobs.reset(new JobSystem(settings.jobThreads));
+
+        // configure global opengl state
+        // -----------------------------
+        glEnable(GL_DEPTH_TEST);
+
+        // Build and compile the shader program
+        // the instanced variant reads its model matrix from a per-instance vertex attribute, the uniform buffer
+        // variant from the ObjectData block, the legacy one from a plain uniform; all share the FrameData block
+        // the array fragment shader samples both images of the object's material from one array texture
+        // a reloaded program starts with default uniform values, so the sampler units are set again
+        const char* vertexPath = settings.drawPath == DrawPath::Instanced ? "shaders/3.3.instanced.vs"
+                               : settings.drawPath == DrawPath::UniformBuffer ? "shaders/3.3.ubo.vs" : "shaders/3.3.shader.vs";
+        const char* fragmentPath = settings.textureArrays ? "shaders/3.3.array.fs" : "shaders/3.3.shader.fs";
+        shaders.reset(new ShaderLibrary(settings.shaderCache));
+        shader = shaders->load(vertexPath, fragmentPath, [](Shader& reloaded)
+        {
+            reloaded.setInt("texture1", 0);
+            reloaded.setInt("texture2", 1);
+            reloaded.setInt("textures", 0);
+        });
+        shader->bindUniformBlock("FrameData", FrameBlockBinding);
+        shader->bindUniformBlock("ObjectData", ObjectBlockBinding);
+        shader->bindUniformBlock("MaterialData", MaterialBlockBinding);
+        shader->bindUniformBlock("MeshData", MeshBlockBinding);
+
+        // Set up vertex data (and buffer(s)) and configure vertex attributes
+        // 6 faces, 2 triangles each, position + texture coordinate per vertex
+        float vertices[] = {
+            -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+             0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
+             0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+             0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+            -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
+            -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+
+            -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+             0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+             0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
+             0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
+            -0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
+            -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+
+            -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+            -0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+            -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+            -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+            -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+            -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+
+             0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+             0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+             0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+             0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+             0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+             0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+
+            -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+             0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
+             0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+             0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+            -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+            -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+
+            -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
+             0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+             0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+             0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+            -0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
+            -0.5f,  0.5f, -0.5f,  0.0f, 1.0f
+        };
+        // or a sphere of the same size, 16k triangles, or a mesh file
+        static_assert(sizeof(MeshVertex) == 5 * sizeof(float), "MeshVertex must match the vertex data layout");
+        const MeshVertex* meshVertices = reinterpret_cast<const MeshVertex*>(vertices);
+        size_t meshVertexCount = sizeof(vertices) / sizeof(vertices[0]) / 5;
+        std::vector<MeshVertex> sphere;
+        if (settings.mesh == MeshShape::Sphere)
+        {
+            sphere = uvSphere(128, 64, 0.5f);
+            meshVertices = sphere.data();
+            meshVertexCount = sphere.size();
+        }
+        lodSelector.pixelThreshold = settings.lodPixelError;
+
+        // a .glb file brings its own scene, fitted to where the cubes would be; if it cannot be loaded, the cubes are
+        // drawn instead
+        if (settings.mesh == MeshShape::File && isGlbPath(settings.meshPath))
+        {
+            gltf.reset(new GlbScene());
+            if (!gltf->load(settings.meshPath, RenderQueue::MaxMeshes))
+            {
+                std::cout << "ERROR::GLB::" << gltf->error() << std::endl;
+                gltf.reset();
+                settings.mesh = MeshShape::Cube;
+            }
+        }
+
+        // the scene list: one object per glb instance, with the glb node hierarchy below a node that fits it to
+        // where the cubes would be, or our cubes as roots with the sphere around the unit cube and the box around the
+        // rotated cube
+        if (gltf)
+        {
+            uint32_t root = transforms.add(Transform());
+            std::vector<uint32_t> nodeIds = gltf->addNodes(transforms, root);
+            transforms.build();
+            transforms.setLocal(root, gltf->fit(transforms, nodeIds, glm::vec3(0.0f, 0.0f, -4.0f), 4.0f));
+            transforms.update();
+            for (const GlbInstance& instance : gltf->instances())
+            {
+                uint32_t node = nodeIds[instance.node];
+                glm::vec3 center, extent;
+                gltf->worldBox(instance, transforms.worldMatrix(node), center, extent);
+                objects.push_back(SceneObject{ node, center, extent, glm::length(extent), instance.primitive });
+            }
+            settings.cubeCount = (unsigned int)objects.size();
+        }
+        else
+        {
+            for (unsigned int i = 0; i < settings.cubeCount; i++)
+                transforms.add(cubeTransform(i, cubePosition(i, settings.cubeCount)));
+            transforms.build();
+            for (unsigned int i = 0; i < settings.cubeCount; i++)
+            {
+                const glm::mat4& model = transforms.worldMatrix(i);
+                glm::vec3 extent = 0.5f * (glm::abs(glm::vec3(model[0])) + glm::abs(glm::vec3(model[1])) + glm::abs(glm::vec3(model[2])));
+                objects.push_back(SceneObject{ i, glm::vec3(model[3]), extent, boundingRadius, 0 });
+            }
+        }
+
+        // bounding volumes for culling
+        if (settings.culling)
+        {
+            for (const SceneObject& object : objects)
+                scene.add(object.center, object.radius, object.center - object.extent, object.center + object.extent);
+            scene.build();
+        }
+
+        // occluders must lie inside the objects they stand for, which a simplification only guarantees for the
+        // convex built-in meshes: a mesh file may be concave, and a glb scene has no simplified versions at all
+        if (settings.culling && settings.occlusion && settings.occluders > 0 && settings.mesh != MeshShape::File)
+            occlusion.reset(new OcclusionCuller(jobs.get()));
+
+        // Generate a Vertex Array Object, a Vertex Buffer Object (VBO) and an Element Buffer Object (EBO)
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        // a glb file is drawn straight from its buffers; other mesh files are imported in the background and
+        // drawn as far as they got, until they are complete and prepared
+        if (gltf)
+            initGlbMeshes();
+        else if (settings.mesh == MeshShape::File)
+        {
+            importer.reset(new MeshImporter(settings.meshPath));
+            initStreamedMesh();
+        }
+        else
+            installMesh(prepareMesh(meshVertices, meshVertexCount));
+
+        // everything rewritten per frame (camera block, per-object blocks, visible instance matrices)
+        // streams through one ring buffer; object entries sit at the uniform offset alignment
+        uniformAlignment = uniformBufferAlignment();
+        objectStride = (sizeof(ObjectUniforms) + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+        stream.create(frameStreamBytes(settings.cubeCount), settings.framesInFlight, settings.persistentMapping);
+
+        // per-instance model matrices for the instanced path, streamed every frame in draw order
+        if (settings.drawPath == DrawPath::Instanced)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, stream.id());
+            setInstanceAttributes(0);
+            if (settings.textureArrays)
+                setMaterialAttribute(0);
+        }
+
+        // material k pairs base image k % 3 with overlay image (k / 3 + 1) % 3: material 0 is the classic
+        // container + awesomeface, the first nine are distinct and later ones repeat their textures
+        if (settings.textureArrays)
+            initArrayMaterials();
+        else
+            initTextureMaterials();
+
+        // hardware occlusion queries on bounding box proxies, if the class of the cubes' mesh wants them
+        if (settings.culling && settings.occlusionQueries && settings.queryClasses[(int)settings.mesh].enabled)
+        {
+            queries.reset(new OcclusionQueryScheduler());
+            queries->init(settings.cubeCount);
+            proxyShader = shaders->load("shaders/3.3.proxy.vs", "shaders/3.3.proxy.fs");
+            proxyShader->bindUniformBlock("FrameData", FrameBlockBinding);
+            proxyBoxMin = proxyShader->uniform("boxMin");
+            proxyBoxMax = proxyShader->uniform("boxMax");
+            initProxyBox();
+        }
+
+        queue.init(settings.overdrawStats);
+
+        // tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
+        // -------------------------------------------------------------------------------------------
+        shader->use(); // don't forget to activate/use the shader before setting uniforms!
+        shader->setInt("texture1", 0);
+        shader->setInt("texture2", 1);
+        shader->setInt("textures", 0);
+
+        // resolve the per-draw uniform once so the render loop never looks it up by name
+        modelUniform = shader->uniform("model");
+    }
+
+    // draw the scene into the currently bound framebuffer
+    // the optional profiler gets the "texture upload", "cull", "occlusion", "sort", "clear", "uniform upload" and "draw" scopes
+    // ------------------------------------------------------------------------
+    void render(const glm::mat4& projection, const glm::mat4& view, FrameProfiler* profiler = nullptr)
+    {
+        // swap in shaders that were edited and finished compiling
+        shaders->update();
+
+        // world matrices of whatever moved since the last frame; nothing for a static scene
+        transforms.update();
+
+        // append what the mesh import parsed since the last frame
+        if (importer && !meshResident())
+            pollImport();
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        if (settings.culling)
+        {
+            ProfileScope scope(profiler, "cull");
+            visible.clear();
+            scene.cull(projection * view, visible, jobs.get());
+        }
+
+        // the occluder mesh only exists once an imported mesh is complete
+        if (occlusion && !occluderLods.levels.empty())
+        {
+            ProfileScope scope(profiler, "occlusion");
+            cullOccluded(projection, view);
+        }
+
+        // results of earlier occlusion queries, as far as they are in
+        if (queries)
+            queries->beginFrame();
+
+        // one packet per drawn cube, keyed by its state (one program and vertex array, the cube's material)
+        // and its view depth, then sorted: draws sharing textures end up together, nearest first
+        {
+            ProfileScope scope(profiler, "sort");
+            glm::vec4 depthRow = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+            // the mesh field is the level of detail, picked from the projected error at the object's nearest point,
+            // or the object's primitive for a glb scene
+            lodSelector.setProjection(projection, (float)viewport[3]);
+            // packets are written by index on all threads, so the queue is the same for any thread count
+            const uint32_t* drawn = settings.culling ? visible.data() : nullptr;
+            size_t count = settings.culling ? visible.size() : settings.cubeCount;
+            DrawPacket* packets = queue.assign(count);
+            rangeLodStats.assign(jobs->rangeCount(count, PacketGrain), LodStats());
+            jobs->parallelRanges(count, PacketGrain, [&](size_t range, size_t begin, size_t end)
+            {
+                LodStats& partial = rangeLodStats[range];
+                for (size_t k = begin; k < end; k++)
+                {
+                    uint32_t i = drawn ? drawn[k] : (uint32_t)k;
+                    const SceneObject& object = objects[i];
+                    float depth = glm::dot(depthRow, glm::vec4(object.center, 1.0f));
+                    unsigned int level = object.mesh;
+                    if (!gltf)
+                    {
+                        level = lodSelector.select(lods.levels, depth - object.radius, objectLods[i]);
+                        if (level != objectLods[i])
+                        {
+                            objectLods[i] = (uint8_t)level;
+                            partial.switches++;
+                        }
+                    }
+                    partial.trianglesDrawn += lods.levels[level].indexCount / 3;
+                    partial.trianglesFull += lods.levels[gltf ? level : 0].indexCount / 3;
+                    packets[k] = DrawPacket{ RenderQueue::makeKey(RenderPass::Opaque, 0, materialTextureSets[cubeMaterial(i)], level, depth), i };
+                }
+            });
+            for (const LodStats& partial : rangeLodStats)
+            {
+                lodStatistics.switches += partial.switches;
+                lodStatistics.trianglesDrawn += partial.trianglesDrawn;
+                lodStatistics.trianglesFull += partial.trianglesFull;
+            }
+            if (settings.sortDraws)
+                queue.sort();
+            lodStatistics.frames++;
+
+            // cubes that get an occlusion query leave the queue for the query pass, still in sorted order
+            queried.clear();
+            queriedActions.clear();
+            if (queries)
+                extractQueried(view);
+        }
+        const std::vector<DrawPacket>& packets = queue.packets();
+        // stream slots: the queue's packets first, then the queried ones
+        size_t slots = packets.size() + queried.size();
+        auto slotObject = [&](size_t k) { return k < packets.size() ? packets[k].object : queried[k - packets.size()].object; };
+
+        // wait for this frame's stream buffer region (only if the GPU is framesInFlight frames behind)
+        stream.beginFrame(frameStreamBytes(slots));
+
+        if (textureLoader && !textureLoader->allResident())
+        {
+            ProfileScope scope(profiler, "texture upload");
+            textureLoader->update();
+        }
+
+        {
+            ProfileScope scope(profiler, "clear");
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+
+        {
+            ProfileScope scope(profiler, "uniform upload");
+            // pass projection and camera/view matrices to every program through the FrameData block
+            GLintptr frameOffset = 0;
+            FrameUniforms* frame = reinterpret_cast<FrameUniforms*>(stream.allocate(sizeof(FrameUniforms), uniformAlignment, frameOffset));
+            *frame = FrameUniforms{ view, projection, projection * view };
+
+            // one entry per drawn cube, in draw order, written on all threads
+            if (settings.drawPath == DrawPath::UniformBuffer)
+            {
+                unsigned char* blocks = stream.allocate(slots * objectStride, uniformAlignment, objectsOffset);
+                jobs->parallelFor(slots, GatherGrain, [&](size_t begin, size_t end)
+                {
+                    for (size_t k = begin; k < end; k++)
+                        reinterpret_cast<ObjectUniforms*>(blocks + k * objectStride)->model = transforms.worldMatrix(objects[slotObject(k)].node);
+                });
+            }
+
+            // gather the instance matrices straight into the buffer
+            if (settings.drawPath == DrawPath::Instanced)
+            {
+                glm::mat4* instances = reinterpret_cast<glm::mat4*>(stream.allocate(slots * sizeof(glm::mat4), sizeof(glm::vec4), instancesOffset));
+                uint32_t* materials = nullptr;
+                if (settings.textureArrays)
+                    materials = reinterpret_cast<uint32_t*>(stream.allocate(slots * sizeof(uint32_t), sizeof(uint32_t), materialsOffset));
+                jobs->parallelFor(slots, GatherGrain, [&](size_t begin, size_t end)
+                {
+                    for (size_t k = begin; k < end; k++)
+                    {
+                        instances[k] = transforms.worldMatrix(objects[slotObject(k)].node);
+                        if (materials)
+                            materials[k] = cubeMaterial(slotObject(k));
+                    }
+                });
+            }
+
+            stream.unmap();
+            glBindBufferRange(GL_UNIFORM_BUFFER, FrameBlockBinding, stream.id(), frameOffset, sizeof(FrameUniforms));
+        }
+
+        // render boxes: binds go through the queue's state cache, so only changes reach GL
+        ProfileScope scope(profiler, "draw");
+        queue.beginSubmit();
+        if (settings.drawPath == DrawPath::Instanced)
+            glBindBuffer(GL_ARRAY_BUFFER, stream.id());
+        for (size_t first = 0; first < packets.size(); )
+        {
+            // the run of packets sharing this state
+            uint64_t runState = RenderQueue::stateKey(packets[first].key);
+            size_t end = first + 1;
+            while (end < packets.size() && RenderQueue::stateKey(packets[end].key) == runState)
+                end++;
+            drawRun(&packets[first], end - first, first);
+            first = end;
+        }
+        // the overdraw query has to end before any occlusion query begins
+        queue.endSubmit((unsigned long long)viewport[2] * (unsigned long long)viewport[3]);
+
+        // after everything else, so the depth buffer holds as much as it will
+        if (!queried.empty())
+            submitQueried(packets.size());
+
+        // fence this frame's region; it is rewritten framesInFlight frames from now
+        stream.endFrame();
+    }
+
+    // true once every texture shows its real image instead of the placeholder
+    bool texturesResident() const
+    {
+        return !textureLoader || textureLoader->allResident();
+    }
+
+    // what the mesh building stage did to the cube
+    const MeshStats& meshStats() const
+    {
+        return stats;
+    }
+
+    // the importer of --mesh FILE, null for the built in meshes
+    const MeshImporter* meshImport() const
+    {
+        return importer.get();
+    }
+
+    // the scene of --mesh FILE.glb, null otherwise
+    const GlbScene* glbScene() const
+    {
+        return gltf.get();
+    }
+
+    // true once the mesh is complete and prepared: always for the built in meshes, and for an imported one once it
+    // replaced the partial mesh streamed in while parsing (or the import failed)
+    bool meshResident() const
+    {
+        return !importer || importResident;
+    }
+
+    // frustum culling counters, empty with --no-cull
+    const Scene& cullScene() const
+    {
+        return scene;
+    }
+
+    // occlusion culling counters, null with --no-occlusion or --no-cull
+    const OcclusionStats* occlusionStats() const
+    {
+        return occlusion ? &occlusion->occlusionStats() : nullptr;
+    }
+
+    // occlusion query counters, null unless --occlusion-queries applies to the mesh
+    const OcclusionQueryStats* queryStats() const
+    {
+        return queries ? &queries->queryStats() : nullptr;
+    }
+
+    // the ring buffer all per-frame data streams through
+    const StreamBuffer& streamBuffer() const
+    {
+        return stream;
+    }
+
+    // the levels of detail of the mesh and how they were used
+    const LodChain& lodChain() const
+    {
+        return lods;
+    }
+    const LodStats& lodStats() const
+    {
+        return lodStatistics;
+    }
+
+    // draw packets and state change / overdraw counts
+    const RenderQueue& renderQueue() const
+    {
+        return queue;
+    }
+
+    // the array textures, null without --texture-arrays
+    const TextureArrayManager* arrayTextures() const
+    {
+        return textureArrays.get();
+    }
+
+    // every object's transform
+    const TransformHierarchy& transformHierarchy() const
+    {
+        return transforms;
+    }
+
+    // the threads the per-frame work runs on
+    const JobSystem& jobSystem() const
+    {
+        return *jobs;
+    }
+
+    // the asynchronous loader, null with --sync-textures
+    const TextureLoader* textures() const
+    {
+        return textureLoader.get();
+    }
+
+    // de-allocate all resources once they've outlived their purpose
+    // ------------------------------------------------------------------------
+    void destroy()
+    {
+        textureLoader.reset();
+        // the preparation reads the importer
+        if (importedMesh.valid())
+            importedMesh.wait();
+        importer.reset();
+        if (gltf)
+            gltf->destroy();
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        stream.destroy();
+        queue.destroy();
+        if (queries)
+        {
+            queries->destroy();
+            glDeleteVertexArrays(1, &proxyVAO);
+            glDeleteBuffers(1, &proxyVBO);
+            glDeleteBuffers(1, &proxyEBO);
+        }
+        if (textureArrays)
+            textureArrays->destroy();
+        if (materialUBO)
+            glDeleteBuffers(1, &materialUBO);
+        glDeleteBuffers(1, &meshUBO);
+        for (GLuint texture : textureImages)
+        {
+            if (texture)
+                glDeleteTextures(1, &texture);
+        }
+        shader = nullptr;
+        shaders.reset();
+        occlusion.reset();
+        jobs.reset();
+    }
+
+private:
+    // the scene list: where every object is and what it is drawn with
+    struct SceneObject
+    {
+        uint32_t node;          // in transforms
+        glm::vec3 center;       // world space, of the bounding sphere and box
+        glm::vec3 extent;       // half size of the box
+        float radius;
+        uint32_t mesh;          // glb primitive; the built in meshes have one
+    };
+    std::vector<SceneObject> objects;
+    TransformHierarchy transforms;
+    std::unique_ptr<GlbScene> gltf;         // --mesh FILE.glb
+    // culling, occlusion tests, LOD selection, packet building and the stream buffer gathers run on these threads;
+    // the render thread takes part and alone talks to GL
+    std::unique_ptr<JobSystem> jobs;
+    static const size_t PacketGrain = 2048;     // objects per packet building job
+    static const size_t GatherGrain = 4096;     // matrices per gather job
+    std::vector<LodStats> rangeLodStats;        // LOD counters per packet building job
+    Scene scene;
+    std::vector<uint32_t> visible;          // ids of the cubes that passed culling this frame
+    std::unique_ptr<OcclusionCuller> occlusion;
+    LodChain occluderLods;                  // its coarsest level is the occluder mesh
+    std::vector<std::pair<float, uint32_t>> occluderCandidates;     // view depth, cube
+    std::unique_ptr<OcclusionQueryScheduler> queries;
+    std::vector<DrawPacket> queried;        // this frame's cubes drawn with an occlusion query, in draw order
+    std::vector<QueryAction> queriedActions;
+    Shader* proxyShader = nullptr;          // bounding boxes for the proxy queries
+    UniformHandle proxyBoxMin, proxyBoxMax;
+    unsigned int proxyVAO = 0, proxyVBO = 0, proxyEBO = 0;
+    std::unique_ptr<TextureLoader> textureLoader;
+    // --mesh FILE: the import, the partial mesh streamed from it so far and the complete mesh being prepared
+    std::unique_ptr<MeshImporter> importer;
+    size_t streamedChunks = 0, streamedVertices = 0, streamedCapacity = 0;
+    glm::vec3 streamedMin = glm::vec3(0.0f), streamedMax = glm::vec3(0.0f);
+    std::future<PreparedMesh> importedMesh;
+    bool importResident = false;
+    unsigned int VBO = 0, VAO = 0, EBO = 0;
+    GLenum indexType = GL_UNSIGNED_SHORT;
+    size_t indexSize = sizeof(uint16_t);
+    const float boundingRadius = std::sqrt(3.0f) * 0.5f;   // around the unit cube, and so the sphere too
+    LodChain lods;
+    LodSelector lodSelector;
+    std::vector<uint8_t> objectLods;        // current level of every cube, for the hysteresis
+    LodStats lodStatistics;
+    MeshStats stats;
+    // the textures bound to units 0 and 1 (0: unit unused) for one or more materials
+    struct TextureSet
+    {
+        GLenum target;
+        GLuint textures[2];
+    };
+    std::vector<GLuint> textureImages;      // one per image, 0 until a material uses it
+    std::vector<TextureSet> textureSets;    // indexed by the texture set field of the sort key
+    std::vector<uint32_t> materialTextureSets;  // texture set of each material
+    std::unique_ptr<TextureArrayManager> textureArrays;    // --texture-arrays only
+    GLuint materialUBO = 0;
+    GLuint meshUBO = 0;                     // MeshData
+    RenderQueue queue;
+    StreamBuffer stream;
+    size_t uniformAlignment = 256, objectStride = 256;
+    GLintptr objectsOffset = 0, instancesOffset = 0, materialsOffset = 0;  // this frame's per-slot data in the stream
+    UniformHandle modelUniform;
+
+    // stream buffer bytes a frame drawing objectCount cubes needs, including alignment padding
+    size_t frameStreamBytes(size_t objectCount) const
+    {
+        size_t bytes = sizeof(FrameUniforms);
+        if (settings.drawPath == DrawPath::UniformBuffer)
+            bytes += objectCount * objectStride;
+        if (settings.drawPath == DrawPath::Instanced)
+            bytes += objectCount * (sizeof(glm::mat4) + (settings.textureArrays ? sizeof(uint32_t) : 0));
+        return bytes + 4 * uniformAlignment;
+    }
+
+    // rasterize the nearest visible cubes, which cover the most of the screen, and drop the visible cubes
+    // whose boxes are behind them
+    void cullOccluded(const glm::mat4& projection, const glm::mat4& view)
+    {
+        glm::vec4 depthRow = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+        occluderCandidates.clear();
+        for (uint32_t i : visible)
+            occluderCandidates.emplace_back(glm::dot(depthRow, glm::vec4(objects[i].center, 1.0f)), i);
+        size_t count = std::min((size_t)settings.occluders, occluderCandidates.size());
+        std::partial_sort(occluderCandidates.begin(), occluderCandidates.begin() + count, occluderCandidates.end());
+
+        const LodLevel& level = occluderLods.levels.back();
+        occlusion->begin(projection * view);
+        for (size_t k = 0; k < count; k++)
+        {
+            uint32_t i = occluderCandidates[k].second;
+            occlusion->addOccluder(transforms.worldMatrix(objects[i].node), occluderLods.mesh, level.indexOffset, level.indexCount);
+        }
+        occlusion->rasterize();
+        occlusion->cull(visible, [this](uint32_t i, glm::vec3& boxMin, glm::vec3& boxMax) { scene.box(i, boxMin, boxMax); });
+    }
+
+    // Draw packets sharing one state key, whose per-object data starts at stream slot slot.
+    // Binds go through the queue's state cache, so only changes reach GL.
+    void drawRun(const DrawPacket* run, size_t count, size_t slot)
+    {
+        StateCache& state = queue.state();
+        const TextureSet& textureSet = textureSets[RenderQueue::textureSet(run[0].key)];
+        uint32_t mesh = RenderQueue::mesh(run[0].key);
+        const LodLevel& level = lods.levels[mesh];
+        GLsizei indexCount = (GLsizei)level.indexCount;
+        // glb primitives have a vertex array and index type each
+        GLuint vertexArray = gltf ? gltf->primitives()[mesh].vertexArray : VAO;
+        GLenum elementType = gltf ? gltf->primitives()[mesh].indices.componentType : indexType;
+        size_t elementSize = gltf ? gltf->primitives()[mesh].indexSize : indexSize;
+        const void* indices = (const void*)(uintptr_t)(level.indexOffset * elementSize);
+        state.useProgram(shader->ID);
+        for (GLuint unit = 0; unit < 2; unit++)
+        {
+            if (textureSet.textures[unit])
+                state.bindTexture(unit, textureSet.textures[unit], textureSet.target);
+        }
+        state.bindVertexArray(vertexArray);
+
+        if (settings.drawPath == DrawPath::Instanced)
+        {
+            // the whole run in one call, starting at its first matrix
+            setInstanceAttributes(instancesOffset + (GLintptr)(slot * sizeof(glm::mat4)));
+            if (settings.textureArrays)
+                setMaterialAttribute(materialsOffset + (GLintptr)(slot * sizeof(uint32_t)));
+            glDrawElementsInstanced(GL_TRIANGLES, indexCount, elementType, indices, (GLsizei)count);
+            queue.countDraws(1);
+        }
+        else if (settings.drawPath == DrawPath::UniformBuffer)
+        {
+            for (size_t k = 0; k < count; k++)
+            {
+                // select this cube's block; no uniform calls per draw
+                glBindBufferRange(GL_UNIFORM_BUFFER, ObjectBlockBinding, stream.id(), objectsOffset + (GLintptr)((slot + k) * objectStride), sizeof(ObjectUniforms));
+                if (settings.textureArrays)
+                    glVertexAttribI1ui(6, cubeMaterial(run[k].object));
+                glDrawElements(GL_TRIANGLES, indexCount, elementType, indices);
+            }
+            queue.countDraws(count);
+        }
+        else
+        {
+            for (size_t k = 0; k < count; k++)
+            {
+                // pass each object's model matrix to the shader before drawing
+                uint32_t i = run[k].object;
+                shader->setMat4(modelUniform, transforms.worldMatrix(objects[i].node));
+                if (settings.textureArrays)
+                    glVertexAttribI1ui(6, cubeMaterial(i));
+
+                glDrawElements(GL_TRIANGLES, indexCount, elementType, indices);
+            }
+            queue.countDraws(count);
+        }
+    }
+
+    // move the cubes that are heavy enough for their class's queries from the queue to queried
+    void extractQueried(const glm::mat4& view)
+    {
+        const OcclusionQueryClass& queryClass = settings.queryClasses[(int)settings.mesh];
+        glm::vec4 depthRow = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+        glm::vec3 depthAxis = glm::abs(glm::vec3(depthRow));
+        // the near plane of the FrameData projection is not known here; anything this close skips the query
+        const float nearMargin = 0.5f;
+        queue.extract([&](const DrawPacket& packet)
+        {
+            uint32_t i = packet.object;
+            if (lods.levels[RenderQueue::mesh(packet.key)].indexCount / 3 < queryClass.minTriangles)
+                return false;
+            glm::vec3 boxMin, boxMax;
+            scene.box(i, boxMin, boxMax);
+            glm::vec3 center = 0.5f * (boxMin + boxMax), extent = 0.5f * (boxMax - boxMin);
+            float nearest = glm::dot(depthRow, glm::vec4(center, 1.0f)) - glm::dot(depthAxis, extent);
+            QueryAction action = queries->classify(i, queryClass, nearest < nearMargin);
+            if (action == QueryAction::None)
+                return false;
+            queriedActions.push_back(action);
+            return true;
+        }, queried);
+    }
+
+    // the query pass: proxy boxes of the hidden cubes first, without writing color or depth so they do not hide
+    // each other, then the queried cubes themselves, conditionally on their box or inside a visibility query
+    void submitQueried(size_t firstSlot)
+    {
+        StateCache& state = queue.state();
+        bool proxies = std::any_of(queriedActions.begin(), queriedActions.end(), [](QueryAction action)
+        {
+            return action == QueryAction::Proxy || action == QueryAction::Reuse;
+        });
+        if (proxies)
+        {
+            state.useProgram(proxyShader->ID);
+            state.bindVertexArray(proxyVAO);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            glDepthMask(GL_FALSE);
+            for (size_t k = 0; k < queried.size(); k++)
+            {
+                QueryAction action = queriedActions[k];
+                if (action != QueryAction::Proxy && action != QueryAction::Reuse)
+                    continue;
+                uint32_t i = queried[k].object;
+                glm::vec3 boxMin, boxMax;
+                scene.box(i, boxMin, boxMax);
+                proxyShader->setVec3(proxyBoxMin, boxMin);
+                proxyShader->setVec3(proxyBoxMax, boxMax);
+                glBeginQuery(GL_ANY_SAMPLES_PASSED, action == QueryAction::Reuse ? queries->conditionQuery(i) : queries->query(i));
+                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, (void*)0);
+                glEndQuery(GL_ANY_SAMPLES_PASSED);
+                queue.countDraws(1);
+                queries->issued(i, action);
+            }
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthMask(GL_TRUE);
+        }
+
+        for (size_t k = 0; k < queried.size(); k++)
+        {
+            uint32_t i = queried[k].object;
+            if (queriedActions[k] == QueryAction::Visibility)
+            {
+                glBeginQuery(GL_ANY_SAMPLES_PASSED, queries->query(i));
+                drawRun(&queried[k], 1, firstSlot + k);
+                glEndQuery(GL_ANY_SAMPLES_PASSED);
+                queries->issued(i, QueryAction::Visibility);
+            }
+            else
+            {
+                // the GPU waits for its own query result, the CPU does not; both were issued above, this frame
+                GLuint condition = queriedActions[k] == QueryAction::Reuse ? queries->conditionQuery(i) : queries->query(i);
+                glBeginConditionalRender(condition, GL_QUERY_WAIT);
+                drawRun(&queried[k], 1, firstSlot + k);
+                glEndConditionalRender();
+                queries->conditionalDraw();
+            }
+        }
+    }
+
+    // a unit cube, corners at 0 and 1, that the proxy shader stretches over a bounding box
+    void initProxyBox()
+    {
+        static const float corners[] = {
+            0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 1.0f,  1.0f, 0.0f, 1.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 1.0f
+        };
+        static const unsigned char faces[] = {
+            0, 1, 2, 2, 3, 0,   4, 5, 6, 6, 7, 4,   0, 4, 7, 7, 3, 0,
+            1, 5, 6, 6, 2, 1,   0, 1, 5, 5, 4, 0,   3, 2, 6, 6, 7, 3
+        };
+        glGenVertexArrays(1, &proxyVAO);
+        glGenBuffers(1, &proxyVBO);
+        glGenBuffers(1, &proxyEBO);
+        glBindVertexArray(proxyVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, proxyVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, proxyEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(VAO);
+    }
+
+    // Everything about a mesh that needs no GL: welded, ordered for the vertex cache and simplified.
+    // Imported meshes are prepared on a worker thread, so this only reads the settings.
+    PreparedMesh prepareMesh(const MeshVertex* vertices, size_t vertexCount) const
+    {
+        PreparedMesh prepared;
+        // weld the shared corners and order the triangles for the vertex cache
+        IndexedMesh mesh = buildIndexedMesh(vertices, vertexCount, &prepared.stats);
+
+        // levels of detail, simplified once per mesh and kept in the mesh cache; they share the vertices,
+        // so every level is a range of one index buffer
+        LodChainCache lodCache(settings.meshCache);
+        prepared.lods = lodCache.build(mesh);
+
+        // occluders are the objects themselves, simplified much further than any drawn level: the coarsest level of
+        // a chain allowed five times the error still keeps its vertices on the surface, so for the convex cube and
+        // sphere it stays inside; imported meshes get none (see init)
+        if (settings.culling && settings.occlusion && settings.occluders > 0 && settings.mesh != MeshShape::File)
+            prepared.occluderLods = lodCache.build(mesh, 16, 0.5f, 0.25f);
+        return prepared;
+    }
+
+    // make a prepared mesh the one every object is drawn with
+    void installMesh(PreparedMesh&& prepared)
+    {
+        lods = std::move(prepared.lods);
+        occluderLods = std::move(prepared.occluderLods);
+        stats = prepared.stats;
+        indexType = lods.mesh.indexType();
+        indexSize = lods.mesh.indexSize();
+        objectLods.assign(settings.cubeCount, 0);
+
+        // Bind the Vertex Array Object first, then bind and set vertex buffer(s)
+        glBindVertexArray(VAO);
+
+        // Bind the buffer to the GL_ARRAY_BUFFER target
+        // This tells OpenGL that we want to use the buffer as a vertex buffer
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        // Copy the vertex data into the buffer's memory in the chosen layout and set the vertex attribute pointers
+        // from it; the MeshData block tells the vertex shaders how to undo the position quantization
+        if (settings.packedVertices)
+            uploadVertices<PackedVertexLayout>(lods.mesh.vertices);
+        else
+            uploadVertices<FloatVertexLayout>(lods.mesh.vertices);
+        // the element buffer binding is part of the VAO state
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        uploadIndices(lods.mesh);
+    }
+
+    // Upload the glb primitives straight from the file mapping; each becomes a level of the chain with its own
+    // vertex array, so the draw code finds its index range where it finds the levels of detail
+    void initGlbMeshes()
+    {
+        gltf->upload<FloatVertexLayout>();
+        lods = LodChain();
+        stats = MeshStats();
+        bool layout = true;
+        stats.index16 = true;
+        for (const GlbPrimitive& primitive : gltf->primitives())
+        {
+            lods.levels.push_back(LodLevel{ primitive.firstIndex, (uint32_t)primitive.indices.count, 0.0f });
+            stats.inputVertices += primitive.position.count;
+            stats.triangles += primitive.indices.count / 3;
+            stats.index16 = stats.index16 && primitive.indexSize <= sizeof(uint16_t);
+            layout = layout && primitive.matchesLayout;
+        }
+        stats.weldedVertices = stats.inputVertices;
+        stats.vertexFormat = layout ? FloatVertexLayout::name() : std::string("glTF accessors");
+        stats.vertexStride = layout ? FloatVertexLayout::stride : 0;
+        objectLods.assign(settings.cubeCount, 0);
+        MeshUniforms mesh = { glm::vec4(1.0f), glm::vec4(0.0f) };
+        setMeshUniforms(mesh);
+        glBindVertexArray(VAO);
+    }
+
+    // The mesh drawn while a file is imported: the triangles merged so far, unwelded, in FloatVertexLayout (which
+    // is MeshVertex itself), with an index buffer counting up so the draw paths need no special case. It has one
+    // level of detail that grows as chunks come in, and starts out empty.
+    void initStreamedMesh()
+    {
+        static_assert(FloatVertexLayout::stride == sizeof(MeshVertex), "streamed vertices are uploaded unconverted");
+        lods = LodChain();
+        lods.levels.push_back(LodLevel{ 0, 0, 0.0f });
+        indexType = GL_UNSIGNED_INT;
+        indexSize = sizeof(uint32_t);
+        objectLods.assign(settings.cubeCount, 0);
+        stats.index16 = false;
+        stats.vertexFormat = FloatVertexLayout::name();
+        stats.vertexStride = FloatVertexLayout::stride;
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        FloatVertexLayout::setAttributes();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        MeshUniforms mesh = { glm::vec4(1.0f), glm::vec4(0.0f) };
+        setMeshUniforms(mesh);
+    }
+
+    // room for at least vertexCount streamed vertices: both buffers double, the vertices streamed so far are
+    // copied over on the GPU and the identity indices regenerated
+    void growStreamedMesh(size_t vertexCount)
+    {
+        size_t capacity = std::max<size_t>(streamedCapacity * 2, 65536);
+        while (capacity < vertexCount)
+            capacity *= 2;
+
+        GLuint grown = 0;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity * sizeof(MeshVertex), NULL, GL_STATIC_DRAW);
+        if (streamedVertices > 0)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, streamedVertices * sizeof(MeshVertex));
+        }
+        glDeleteBuffers(1, &VBO);
+        VBO = grown;
+
+        std::vector<uint32_t> identity(capacity);
+        for (size_t i = 0; i < capacity; i++)
+            identity[i] = (uint32_t)i;
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        FloatVertexLayout::setAttributes();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, capacity * sizeof(uint32_t), identity.data(), GL_STATIC_DRAW);
+        streamedCapacity = capacity;
+    }
+
+    // Take what the importer merged since the last frame. While it runs, the new triangles are appended to the
+    // streamed mesh, scaled by the MeshData block to fit the unit cube as far as the bounds are known. Once it
+    // finished, the mesh is prepared like the built in ones on a worker thread and replaces the streamed one.
+    void pollImport()
+    {
+        // read before the merged count: once finished, every chunk is merged
+        bool finished = importer->finished();
+        size_t merged = importer->mergedChunks();
+        if (streamedChunks < merged)
+        {
+            size_t added = 0;
+            for (size_t k = streamedChunks; k < merged; k++)
+                added += importer->chunkTriangles(k).size();
+            if (streamedVertices + added > streamedCapacity)
+                growStreamedMesh(streamedVertices + added);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            for (; streamedChunks < merged; streamedChunks++)
+            {
+                const std::vector<MeshVertex>& triangles = importer->chunkTriangles(streamedChunks);
+                if (triangles.empty())
+                    continue;
+                glBufferSubData(GL_ARRAY_BUFFER, streamedVertices * sizeof(MeshVertex), triangles.size() * sizeof(MeshVertex), triangles.data());
+                if (streamedVertices == 0)
+                    streamedMin = streamedMax = triangles[0].position;
+                for (const MeshVertex& vertex : triangles)
+                {
+                    streamedMin = glm::min(streamedMin, vertex.position);
+                    streamedMax = glm::max(streamedMax, vertex.position);
+                }
+                streamedVertices += triangles.size();
+            }
+            lods.levels[0].indexCount = (uint32_t)streamedVertices;
+            stats.inputVertices = stats.weldedVertices = streamedVertices;
+            stats.triangles = streamedVertices / 3;
+
+            glm::vec3 extent = streamedMax - streamedMin;
+            float scale = 1.0f / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+            MeshUniforms mesh = { glm::vec4(scale), glm::vec4(-0.5f * (streamedMin + streamedMax) * scale, 0.0f) };
+            setMeshUniforms(mesh);
+        }
+
+        if (finished && !importedMesh.valid())
+        {
+            if (!importer->error().empty())
+            {
+                std::cout << "ERROR::MESH_IMPORT::" << importer->error() << std::endl;
+                importResident = true;
+                return;
+            }
+            importedMesh = std::async(std::launch::async, [this]()
+            {
+                std::vector<MeshVertex> triangles = importer->takeTriangles();
+                fitUnitCube(triangles, !importer->hasTexCoords());
+                return prepareMesh(triangles.data(), triangles.size());
+            });
+        }
+        if (importedMesh.valid() && importedMesh.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            installMesh(importedMesh.get());
+            importResident = true;
+        }
+    }
+
+    // pack the vertices into Layout, upload them to the bound GL_ARRAY_BUFFER (GL_STATIC_DRAW: the data will not
+    // change) and point the vertex attributes at them
+    template <typename Layout>
+    void uploadVertices(const std::vector<MeshVertex>& vertices)
+    {
+        VertexBounds bounds = VertexBounds::of(vertices);
+        std::vector<typename Layout::Vertex> packed = packVertices<Layout>(vertices, bounds);
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(typename Layout::Vertex), packed.data(), GL_STATIC_DRAW);
+        Layout::setAttributes();
+        stats.vertexFormat = Layout::name();
+        stats.vertexStride = Layout::stride;
+
+        MeshUniforms mesh = { glm::vec4(1.0f), glm::vec4(0.0f) };
+        if (Layout::quantizesPosition())
+            mesh = MeshUniforms{ glm::vec4(bounds.halfExtent, 0.0f), glm::vec4(bounds.center, 0.0f) };
+        setMeshUniforms(mesh);
+    }
+
+    // the MeshData block, created on first use
+    void setMeshUniforms(const MeshUniforms& mesh)
+    {
+        if (!meshUBO)
+            glGenBuffers(1, &meshUBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, meshUBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(mesh), &mesh, GL_STATIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, MeshBlockBinding, meshUBO);
+    }
+
+    // point the model matrix attribute at the bound GL_ARRAY_BUFFER, starting at offset
+    // a mat4 attribute occupies four consecutive vec4 locations (2..5)
+    // divisor 1 advances the attribute once per instance instead of once per vertex
+    void setInstanceAttributes(GLintptr offset)
+    {
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + column * sizeof(glm::vec4)));
+            glEnableVertexAttribArray(2 + column);
+            glVertexAttribDivisor(2 + column, 1);
+        }
+    }
+
+    // the texture of one of the material images, loaded on first use
+    GLuint textureImage(unsigned int image)
+    {
+        static const char* paths[] = { "textures/container.jpg", "textures/awesomeface.png", "textures/steve.png" };
+        static const GLint minFilters[] = { GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR };
+        if (!textureImages[image])
+            textureImages[image] = textureLoader ? textureLoader->load(paths[image], minFilters[image]).id
+                                                 : loadTexture(paths[image], minFilters[image]);
+        return textureImages[image];
+    }
+
+    // the per-instance material index at location 6, read from the bound GL_ARRAY_BUFFER at offset
+    void setMaterialAttribute(GLintptr offset)
+    {
+        glVertexAttribIPointer(6, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)offset);
+        glEnableVertexAttribArray(6);
+        glVertexAttribDivisor(6, 1);
+    }
+
+    uint32_t cubeMaterial(uint32_t cube) const
+    {
+        return cube % static_cast<uint32_t>(materialTextureSets.size());
+    }
+
+    // one 2D texture pair per material, bound to units 0 and 1
+    void initTextureMaterials()
+    {
+        // asynchronously they start out as placeholders and are swapped in by render() once decoded
+        if (settings.asyncTextures)
+            textureLoader.reset(new TextureLoader(0, 16 * 1024 * 1024, settings.textureCache));
+        else
+            stbi_set_flip_vertically_on_load(true);
+
+        unsigned int materialCount = std::min(std::max(settings.materials, 1u), RenderQueue::MaxTextureSets);
+        textureImages.assign(3, 0);
+        for (unsigned int k = 0; k < materialCount; k++)
+        {
+            textureSets.push_back(TextureSet{ GL_TEXTURE_2D, { textureImage(k % 3), textureImage((k / 3 + 1) % 3) } });
+            materialTextureSets.push_back(k);
+        }
+    }
+
+    // every image in one array texture; the materials only differ in the regions they sample,
+    // listed in the MaterialData block, so all of them share one texture set and can be drawn in one batch
+    void initArrayMaterials()
+    {
+        static const char* paths[] = { "textures/container.jpg", "textures/awesomeface.png", "textures/steve.png" };
+        unsigned int materialCount = std::min(std::max(settings.materials, 1u), MaxArrayMaterials);
+        stbi_set_flip_vertically_on_load(true);
+        textureArrays.reset(new TextureArrayManager());
+        int images[3] = { -1, -1, -1 };
+        auto image = [&](unsigned int index)
+        {
+            if (images[index] < 0)
+                images[index] = textureArrays->add(paths[index]);
+            return images[index] < 0 ? TextureRegion() : textureArrays->region((unsigned int)images[index]);
+        };
+        for (unsigned int k = 0; k < materialCount; k++)
+        {
+            image(k % 3);
+            image((k / 3 + 1) % 3);
+        }
+        textureArrays->build(1);
+
+        std::vector<MaterialUniforms> materials(materialCount);
+        for (unsigned int k = 0; k < materialCount; k++)
+        {
+            TextureRegion base = image(k % 3), overlay = image((k / 3 + 1) % 3);
+            materials[k] = MaterialUniforms{ base.rect, overlay.rect, glm::vec4((float)base.layer, (float)overlay.layer, 0.0f, 0.0f) };
+            materialTextureSets.push_back(base.array);
+        }
+        for (unsigned int a = 0; a < textureArrays->arrayCount(); a++)
+            textureSets.push_back(TextureSet{ GL_TEXTURE_2D_ARRAY, { textureArrays->array(a), 0 } });
+
+        glGenBuffers(1, &materialUBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, materialUBO);
+        glBufferData(GL_UNIFORM_BUFFER, materials.size() * sizeof(MaterialUniforms), materials.data(), GL_STATIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, MaterialBlockBinding, materialUBO);
+    }
+
+    // load an image into a new GL_REPEAT texture with mipmaps
+    // ------------------------------------------------------------------------
+    unsigned int loadTexture(const char* path, GLint minFilter)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture); // all upcoming GL_TEXTURE_2D operations now have effect on this texture object
+        // set the texture wrapping parameters
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        // set texture filtering parameters
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // load image, create texture and generate mipmaps
+        int width, height, nrChannels;
+        unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 0);
+        if (data && nrChannels >= 1 && nrChannels <= 4)
+        {
+            // grey and grey+alpha images keep one and two channels and are spread back over RGB by a swizzle
+            GLenum format = pixelFormat(nrChannels);
+            setChannelSwizzle(nrChannels);
+            // rows are tightly packed, whatever their length
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        else
+        {
+            std::cout << "Failed to load texture" << std::endl;
+        }
+        stbi_image_free(data);
+        return texture;
+    }
+};
+#endif
@@ -0,0 +1,279 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Static scene objects with bounding spheres and AABBs, organized in a bounding volume hierarchy for frustum culling.
+// Objects are added once, then build() creates the BVH; cull() walks it every frame. A subtree whose box is outside
+// one plane is skipped as a whole and a subtree completely inside the frustum is emitted without any further tests,
+// so the cost of culling grows with the number of visible objects and the frustum border, not with the scene size.
+class Scene
+{
+public:
+    static const uint32_t LeafSize = 8;
+
+    // per-frame and accumulated culling counters
+    struct CullStats
+    {
+        size_t visible = 0;         // last frame
+        size_t nodesVisited = 0;    // last frame
+        size_t spheresTested = 0;   // last frame
+        unsigned long long frames = 0;
+        unsigned long long visibleTotal = 0;
+        double seconds = 0.0;       // total time spent in cull()
+
+        void print(std::ostream& out, size_t objectCount) const
+        {
+            if (frames == 0)
+                return;
+            double visibleAverage = (double)visibleTotal / frames;
+            out << "culling: " << objectCount << " objects, avg " << visibleAverage << " visible ("
+                << (objectCount ? 100.0 * visibleAverage / objectCount : 0.0) << "%), avg cull time "
+                << seconds / frames * 1000.0 << " ms" << std::endl;
+        }
+    };
+
+    // add an object; returns its id, which cull() reports for visible objects
+    uint32_t add(const glm::vec3& sphereCenter, float sphereRadius, const glm::vec3& boxMin, const glm::vec3& boxMax)
+    {
+        spheres.push_back(glm::vec4(sphereCenter, sphereRadius));
+        boxes.push_back(Box{ boxMin, boxMax });
+        return (uint32_t)spheres.size() - 1;
+    }
+
+    size_t size() const
+    {
+        return spheres.size();
+    }
+
+    // the box an object was added with
+    void box(uint32_t id, glm::vec3& boxMin, glm::vec3& boxMax) const
+    {
+        boxMin = boxes[id].min;
+        boxMax = boxes[id].max;
+    }
+
+    // build the hierarchy over everything added so far
+    // ------------------------------------------------------------------------
+    void build()
+    {
+        nodes.clear();
+        ids.resize(spheres.size());
+        for (uint32_t i = 0; i < ids.size(); i++)
+            ids[i] = i;
+        if (!ids.empty())
+        {
+            nodes.reserve(2 * (ids.size() / LeafSize + 1));
+            nodes.push_back(Node());
+            buildNode(0, 0, (uint32_t)ids.size());
+        }
+
+        // spheres in leaf order as separate arrays for the 4-wide tests, padded so the last group can be loaded whole
+        size_t padded = ids.size() + 3;
+        sphereX.assign(padded, 0.0f);
+        sphereY.assign(padded, 0.0f);
+        sphereZ.assign(padded, 0.0f);
+        sphereRadius.assign(padded, 0.0f);
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            const glm::vec4& sphere = spheres[ids[i]];
+            sphereX[i] = sphere.x;
+            sphereY[i] = sphere.y;
+            sphereZ[i] = sphere.z;
+            sphereRadius[i] = sphere.w;
+        }
+    }
+
+    // append the ids of all objects intersecting the frustum of projection * view to visible, in the same order
+    // with or without jobs; with jobs the subtrees below the top levels are walked in parallel
+    // ------------------------------------------------------------------------
+    void cull(const glm::mat4& viewProjection, std::vector<uint32_t>& visible, JobSystem* jobs = nullptr)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Frustum frustum = extractFrustum(viewProjection);
+        size_t firstVisible = visible.size();
+        stats.nodesVisited = 0;
+        stats.spheresTested = 0;
+
+        if (!nodes.empty() && jobs && jobs->threads() > 1 && ids.size() >= ParallelObjects)
+        {
+            // split the top of the tree into subtrees in left to right order, which is the order a single walk
+            // emits them in. The split nodes are not tested: a child is outside (or inside) wherever its parent is,
+            // so the walks below arrive at the same results.
+            size_t target = (size_t)jobs->threads() * 4;
+            frontier.assign(1, 0);
+            for (bool split = true; split && frontier.size() < target; )
+            {
+                split = false;
+                next.clear();
+                for (uint32_t node : frontier)
+                {
+                    if (nodes[node].left != 0)
+                    {
+                        next.push_back(nodes[node].left);
+                        next.push_back(nodes[node].left + 1);
+                        split = true;
+                    }
+                    else
+                        next.push_back(node);
+                }
+                frontier.swap(next);
+            }
+
+            partial.resize(frontier.size());
+            jobs->parallelFor(frontier.size(), 1, [&](size_t begin, size_t end)
+            {
+                for (size_t k = begin; k < end; k++)
+                {
+                    partial[k].visible.clear();
+                    partial[k].nodesVisited = partial[k].spheresTested = 0;
+                    walk(frustum, frontier[k], partial[k].visible, partial[k].nodesVisited, partial[k].spheresTested);
+                }
+            });
+            for (size_t k = 0; k < frontier.size(); k++)
+            {
+                visible.insert(visible.end(), partial[k].visible.begin(), partial[k].visible.end());
+                stats.nodesVisited += partial[k].nodesVisited;
+                stats.spheresTested += partial[k].spheresTested;
+            }
+        }
+        else if (!nodes.empty())
+            walk(frustum, 0, visible, stats.nodesVisited, stats.spheresTested);
+
+        stats.visible = visible.size() - firstVisible;
+        stats.frames++;
+        stats.visibleTotal += stats.visible;
+        stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const CullStats& cullStats() const
+    {
+        return stats;
+    }
+
+private:
+    struct Box
+    {
+        glm::vec3 min, max;
+    };
+    // internal nodes have their children at left and left + 1, leaves have left == 0 (the root is never a child);
+    // either way the node covers ids[first, first + count)
+    struct Node
+    {
+        glm::vec3 center;
+        uint32_t first;
+        glm::vec3 extent;
+        uint32_t count;
+        uint32_t left;
+    };
+
+    std::vector<glm::vec4> spheres;     // in id order
+    std::vector<Box> boxes;             // in id order
+    std::vector<uint32_t> ids;          // object ids in leaf order
+    std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;    // in leaf order
+    std::vector<Node> nodes;
+    CullStats stats;
+
+    // parallel culling: scenes smaller than this are culled on the calling thread
+    static const size_t ParallelObjects = 4096;
+    struct Partial
+    {
+        std::vector<uint32_t> visible;
+        size_t nodesVisited, spheresTested;
+    };
+    std::vector<uint32_t> frontier, next;   // subtrees walked by the jobs
+    std::vector<Partial> partial;           // what each walked
+
+    // append the visible objects below node to out, leftmost first
+    void walk(const Frustum& frustum, uint32_t root, std::vector<uint32_t>& out, size_t& nodesVisited, size_t& spheresTested) const
+    {
+        struct Entry
+        {
+            uint32_t node;
+            uint32_t planeMask;
+        };
+        Entry stack[64];
+        int top = 0;
+        stack[top++] = Entry{ root, Frustum::AllPlanes };
+        while (top > 0)
+        {
+            Entry entry = stack[--top];
+            const Node& node = nodes[entry.node];
+            nodesVisited++;
+            uint32_t planeMask = entry.planeMask;
+            if (!intersectBox(frustum, node.center, node.extent, planeMask))
+                continue;
+            if (planeMask == 0)
+            {
+                // completely inside: the whole subtree is one contiguous range of objects
+                out.insert(out.end(), ids.begin() + node.first, ids.begin() + node.first + node.count);
+                continue;
+            }
+            if (node.left == 0)
+            {
+                for (uint32_t i = node.first; i < node.first + node.count; i += 4)
+                {
+                    uint32_t inside = intersectSpheres4(frustum, &sphereX[i], &sphereY[i], &sphereZ[i], &sphereRadius[i], planeMask);
+                    uint32_t valid = std::min(4u, node.first + node.count - i);
+                    inside &= (1u << valid) - 1;
+                    for (uint32_t k = 0; k < valid; k++)
+                    {
+                        if (inside & (1u << k))
+                            out.push_back(ids[i + k]);
+                    }
+                    spheresTested += valid;
+                }
+                continue;
+            }
+            stack[top++] = Entry{ node.left + 1, planeMask };
+            stack[top++] = Entry{ node.left, planeMask };
+        }
+    }
+
+    // median split along the longest axis of the sphere centers, until at most LeafSize objects remain;
+    // the depth stays around log2(n / LeafSize), well within the traversal stack
+    void buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count)
+    {
+        glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY), centersMin(INFINITY), centersMax(-INFINITY);
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            const Box& box = boxes[ids[i]];
+            boundsMin = glm::min(boundsMin, box.min);
+            boundsMax = glm::max(boundsMax, box.max);
+            glm::vec3 center = glm::vec3(spheres[ids[i]]);
+            centersMin = glm::min(centersMin, center);
+            centersMax = glm::max(centersMax, center);
+        }
+        Node& node = nodes[nodeIndex];
+        node.center = (boundsMin + boundsMax) * 0.5f;
+        node.extent = (boundsMax - boundsMin) * 0.5f;
+        node.first = first;
+        node.count = count;
+        node.left = 0;
+        if (count <= LeafSize)
+            return;
+
+        glm::vec3 size = centersMax - centersMin;
+        int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+        uint32_t half = count / 2;
+        std::nth_element(ids.begin() + first, ids.begin() + first + half, ids.begin() + first + count,
+                         [&](uint32_t a, uint32_t b) { return spheres[a][axis] < spheres[b][axis]; });
+
+        uint32_t left = (uint32_t)nodes.size();
+        nodes[nodeIndex].left = left;  // node may dangle once nodes grows
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        buildNode(left, first, half);
+        buildNode(left + 1, first + half, count - half);
+    }
+};
+#endif
@@ -0,0 +1,290 @@
+#ifndef SHADER_LIBRARY_H
+#define SHADER_LIBRARY_H
+
+#include <glad/glad.h>
+
+#include "shader_s.h"
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Owns the shader programs and rebuilds them when their source files change on disk.
+// The directories of all loaded shaders are watched with inotify; update(), called once per frame, submits a
+// rebuild for every program whose files were written. With GL_KHR/ARB_parallel_shader_compile the driver compiles
+// on its own threads and update() only polls GL_COMPLETION_STATUS, so the render loop never waits for a compile;
+// without it the rebuild is compiled synchronously inside update(). A rebuilt program replaces the old one only
+// after a successful link, a failed build keeps the last good program running.
+// Given a cache directory, linked programs are also kept as driver binaries (see ProgramBinaryCache), so later
+// launches skip compiling entirely; reloaded programs are stored as well.
+class ShaderLibrary
+{
+public:
+    // compile time and reload counters of one program
+    struct ProgramStats
+    {
+        std::string name;       // "vertex path + fragment path"
+        double compileMs = 0.0; // last successful build, from submission until the program was ready
+        unsigned int reloads = 0;
+        unsigned int failures = 0;
+    };
+
+    // binaryCacheDirectory: where program binaries are cached, empty to always compile from source
+    explicit ShaderLibrary(const std::string& binaryCacheDirectory = "")
+    {
+        if (!binaryCacheDirectory.empty())
+            binaries.reset(new ProgramBinaryCache(binaryCacheDirectory));
+
+        parallel = GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+        // let the driver pick the number of compiler threads
+        if (GLAD_GL_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        else if (GLAD_GL_ARB_parallel_shader_compile)
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+
+        watchDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (watchDescriptor < 0)
+            std::cout << "ShaderLibrary: inotify unavailable, shaders will not hot reload" << std::endl;
+    }
+
+    ~ShaderLibrary()
+    {
+        for (Program& program : programs)
+        {
+            if (program.pending.program)
+                discard(program.pending);
+        }
+        if (watchDescriptor >= 0)
+            close(watchDescriptor);
+    }
+
+    ShaderLibrary(const ShaderLibrary&) = delete;
+    ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+    // Compile a program now (the first build always blocks) and keep it up to date from then on.
+    // onReload runs after every successful reload with the new program in use, to restore uniform values
+    // that are set once at startup such as sampler units. The returned shader lives as long as the library.
+    // ------------------------------------------------------------------------
+    Shader* load(const std::string& vertexPath, const std::string& fragmentPath, std::function<void(Shader&)> onReload = nullptr)
+    {
+        auto start = std::chrono::steady_clock::now();
+        programs.emplace_back();
+        Program& program = programs.back();
+        program.vertexPath = vertexPath;
+        program.fragmentPath = fragmentPath;
+        program.onReload = onReload;
+        program.shader.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), binaries.get()));
+        program.stats.name = vertexPath + " + " + fragmentPath;
+        program.stats.compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        watch(vertexPath);
+        watch(fragmentPath);
+        return program.shader.get();
+    }
+
+    // Once per frame: pick up file changes, submit rebuilds and swap in the finished ones
+    // ------------------------------------------------------------------------
+    void update()
+    {
+        readEvents();
+        for (Program& program : programs)
+        {
+            if (program.dirty)
+                submit(program);
+            if (program.pending.program)
+                poll(program);
+        }
+    }
+
+    // true if rebuilds compile in the background (GL_KHR/ARB_parallel_shader_compile)
+    bool parallelCompile() const
+    {
+        return parallel;
+    }
+
+    // the program binary cache, null without a cache directory
+    const ProgramBinaryCache* binaryCache() const
+    {
+        return binaries.get();
+    }
+
+    // number of rebuilds submitted and not yet finished
+    size_t pendingCount() const
+    {
+        size_t count = 0;
+        for (const Program& program : programs)
+            count += program.pending.program ? 1 : 0;
+        return count;
+    }
+
+    std::vector<ProgramStats> stats() const
+    {
+        std::vector<ProgramStats> result;
+        for (const Program& program : programs)
+            result.push_back(program.stats);
+        return result;
+    }
+
+    void printStats(std::ostream& out) const
+    {
+        out << "shader programs (" << (parallel ? "parallel" : "synchronous") << " compile):" << std::endl;
+        for (const Program& program : programs)
+        {
+            out << "  " << program.stats.name << ": " << std::fixed << std::setprecision(2) << program.stats.compileMs
+                << std::defaultfloat << std::setprecision(6) << " ms, " << program.stats.reloads << " reloads, "
+                << program.stats.failures << " failed" << std::endl;
+        }
+    }
+
+private:
+    struct Program
+    {
+        std::string vertexPath, fragmentPath;
+        std::string vertexCode, fragmentCode;   // sources of the build in flight, for the binary cache
+        std::function<void(Shader&)> onReload;
+        std::unique_ptr<Shader> shader;
+        ProgramStats stats;
+        bool dirty = false;
+        Shader::PendingProgram pending;  // program == 0 if no rebuild is in flight
+        std::chrono::steady_clock::time_point submitted;
+    };
+    struct Watch
+    {
+        int descriptor;
+        std::string directory;
+    };
+
+    std::vector<Program> programs;
+    std::unique_ptr<ProgramBinaryCache> binaries;
+    std::vector<Watch> watches;
+    int watchDescriptor = -1;
+    bool parallel = false;
+
+    static std::string directoryOf(const std::string& path)
+    {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? "." : path.substr(0, slash);
+    }
+
+    static std::string joinPath(const std::string& directory, const std::string& name)
+    {
+        return directory == "." ? name : directory + "/" + name;
+    }
+
+    void watch(const std::string& path)
+    {
+        if (watchDescriptor < 0)
+            return;
+        std::string directory = directoryOf(path);
+        for (const Watch& existing : watches)
+        {
+            if (existing.directory == directory)
+                return;
+        }
+        // editors either rewrite the file in place (close after write) or write a new file and rename it over the old one
+        int descriptor = inotify_add_watch(watchDescriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (descriptor < 0)
+        {
+            std::cout << "ShaderLibrary: cannot watch " << directory << std::endl;
+            return;
+        }
+        watches.push_back(Watch{ descriptor, directory });
+    }
+
+    // drain the inotify queue without blocking and mark the programs using a changed file
+    void readEvents()
+    {
+        if (watchDescriptor < 0)
+            return;
+        alignas(inotify_event) char buffer[4096];
+        for (;;)
+        {
+            ssize_t length = read(watchDescriptor, buffer, sizeof(buffer));
+            if (length <= 0)
+                break;  // EAGAIN: nothing more queued
+            for (char* cursor = buffer; cursor < buffer + length;)
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(cursor);
+                cursor += sizeof(inotify_event) + event->len;
+                if (event->len == 0)
+                    continue;
+                for (const Watch& watched : watches)
+                {
+                    if (watched.descriptor != event->wd)
+                        continue;
+                    std::string path = joinPath(watched.directory, event->name);
+                    for (Program& program : programs)
+                    {
+                        if (program.vertexPath == path || program.fragmentPath == path)
+                            program.dirty = true;
+                    }
+                }
+            }
+        }
+    }
+
+    void submit(Program& program)
+    {
+        program.dirty = false;
+        std::string& vertexCode = program.vertexCode;
+        std::string& fragmentCode = program.fragmentCode;
+        if (!Shader::readSource(program.vertexPath.c_str(), vertexCode) || !Shader::readSource(program.fragmentPath.c_str(), fragmentCode))
+        {
+            program.stats.failures++;
+            return;
+        }
+        // a newer edit supersedes a build still in flight
+        if (program.pending.program)
+            discard(program.pending);
+        program.submitted = std::chrono::steady_clock::now();
+        program.pending = Shader::beginProgram(vertexCode, fragmentCode, binaries && binaries->enabled());
+    }
+
+    void poll(Program& program)
+    {
+        if (parallel)
+        {
+            GLint complete = GL_FALSE;
+            glGetProgramiv(program.pending.program, GL_COMPLETION_STATUS_KHR, &complete);
+            if (!complete)
+                return;
+        }
+        double compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - program.submitted).count();
+        if (!Shader::finishProgram(program.pending))
+        {
+            std::cout << "ShaderLibrary: " << program.stats.name << " failed to build, keeping the last good program" << std::endl;
+            glDeleteProgram(program.pending.program);
+            program.pending.program = 0;
+            program.stats.failures++;
+            return;
+        }
+        if (binaries)
+            binaries->store(program.vertexCode, program.fragmentCode, program.pending.program);
+        program.shader->replaceProgram(program.pending.program);
+        program.pending.program = 0;
+        program.stats.compileMs = compileMs;
+        program.stats.reloads++;
+        if (program.onReload)
+        {
+            program.shader->use();
+            program.onReload(*program.shader);
+        }
+        std::cout << "ShaderLibrary: reloaded " << program.stats.name << " in " << compileMs << " ms" << std::endl;
+    }
+
+    static void discard(Shader::PendingProgram& pending)
+    {
+        glDeleteShader(pending.vertex);
+        glDeleteShader(pending.fragment);
+        glDeleteProgram(pending.program);
+        pending = Shader::PendingProgram();
+    }
+};
+#endif
@@ -4,71 +4,141 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "program_cache.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// typed handle to a uniform, resolved once with Shader::uniform() so hot loops never hash a name
+struct UniformHandle
+{
+    int slot = -1;
+};
 
 class Shader
 {
 public:
     unsigned int ID;
     // constructor generates the shader on the fly
+    // with a binary cache the linked program is taken from it when possible and stored into it otherwise
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
+    Shader(const char* vertexPath, const char* fragmentPath, ProgramBinaryCache* binaryCache = nullptr)
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
+        readSource(vertexPath, vertexCode);
+        readSource(fragmentPath, fragmentCode);
+        // 2. load the program binary, or compile shaders and link the program
+        ID = binaryCache ? binaryCache->load(vertexCode, fragmentCode) : 0;
+        if (!ID)
+        {
+            bool cacheable = binaryCache && binaryCache->enabled();
+            PendingProgram pending = beginProgram(vertexCode, fragmentCode, cacheable);
+            if (finishProgram(pending) && cacheable)
+                binaryCache->store(vertexCode, fragmentCode, pending.program);
+            ID = pending.program;
+        }
+        // 3. cache the locations of all active uniforms
+        cacheUniformLocations();
+    }
+    ~Shader()
+    {
+        glDeleteProgram(ID);
+    }
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+    // program building in two steps, so a caller can submit a build and collect it later
+    // ------------------------------------------------------------------------
+    // a program whose shaders were submitted for compilation and linking
+    struct PendingProgram
+    {
+        GLuint program = 0;
+        GLuint vertex = 0;
+        GLuint fragment = 0;
+    };
+    // read a whole file; prints an error and leaves code empty if it cannot be read
+    static bool readSource(const char* path, std::string& code)
+    {
+        std::ifstream shaderFile;
         // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        shaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         try 
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
+            shaderFile.open(path);
+            std::stringstream shaderStream;
             // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
+            shaderStream << shaderFile.rdbuf();
+            shaderFile.close();
             // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            code = shaderStream.str();
         }
         catch (std::ifstream::failure& e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << ": " << e.what() << std::endl;
+            code.clear();
+            return false;
         }
+        return true;
+    }
+    // submit compile and link; with GL_KHR_parallel_shader_compile the driver works on it in the background
+    // and GL_COMPLETION_STATUS_KHR tells when finishProgram() will not block.
+    // retrievable asks the driver to keep the binary around for ProgramBinaryCache::store()
+    static PendingProgram beginProgram(const std::string& vertexCode, const std::string& fragmentCode, bool retrievable = false)
+    {
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
+        PendingProgram pending;
         // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
+        pending.vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(pending.vertex, 1, &vShaderCode, NULL);
+        glCompileShader(pending.vertex);
         // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        pending.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(pending.fragment, 1, &fShaderCode, NULL);
+        glCompileShader(pending.fragment);
         // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        pending.program = glCreateProgram();
+        glAttachShader(pending.program, pending.vertex);
+        glAttachShader(pending.program, pending.fragment);
+        if (retrievable)
+            glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(pending.program);
+        return pending;
+    }
+    // print compile and link errors and release the shader objects; returns false if linking failed
+    static bool finishProgram(PendingProgram& pending)
+    {
+        checkCompileErrors(pending.vertex, "VERTEX");
+        checkCompileErrors(pending.fragment, "FRAGMENT");
+        bool linked = checkCompileErrors(pending.program, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-
+        glDeleteShader(pending.vertex);
+        glDeleteShader(pending.fragment);
+        pending.vertex = pending.fragment = 0;
+        return linked;
+    }
+    // swap in a newly linked program; uniform locations, handles and block bindings are re-resolved,
+    // uniform values start over
+    void replaceProgram(GLuint program)
+    {
+        glDeleteProgram(ID);
+        ID = program;
+        cacheUniformLocations();
+        for (const auto& block : blockBindings)
+            applyUniformBlockBinding(block.first, block.second);
+    }
+    // uniform blocks
+    // ------------------------------------------------------------------------
+    // connect a uniform block to a binding point (GLSL 3.30 has no layout(binding = N)); kept across relinks
+    void bindUniformBlock(const std::string &blockName, GLuint binding)
+    {
+        blockBindings.emplace_back(blockName, binding);
+        applyUniformBlockBinding(blockName, binding);
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -76,69 +146,177 @@ public:
     { 
         glUseProgram(ID); 
     }
+    // uniform location lookup
+    // ------------------------------------------------------------------------
+    // location of a uniform from the cache filled after linking, -1 if it is not active; names the active uniform
+    // list does not spell out ("arr[1]", "light.color") are asked of GL once and cached with the answer, even -1
+    int getLocation(const std::string &name) const
+    {
+        auto it = uniformLocations.find(name);
+        if (it != uniformLocations.end())
+            return it->second;
+        int location = glGetUniformLocation(ID, name.c_str());
+        uniformLocations.emplace(name, location);
+        return location;
+    }
+    // resolve a handle for the set*(UniformHandle, ...) overloads; do this once at setup, not per frame
+    UniformHandle uniform(const std::string &name)
+    {
+        for (size_t i = 0; i < handleNames.size(); i++)
+        {
+            if (handleNames[i] == name)
+                return UniformHandle{ (int)i };
+        }
+        handleNames.push_back(name);
+        handleLocations.push_back(getLocation(name));
+        return UniformHandle{ (int)handleNames.size() - 1 };
+    }
+    int getLocation(UniformHandle handle) const
+    {
+        return handle.slot >= 0 ? handleLocations[handle.slot] : -1;
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(getLocation(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(getLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(getLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(getLocation(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(getLocation(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(getLocation(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(getLocation(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(getLocation(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) const
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(getLocation(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
+    }
+    // handle overloads: no string hashing, just an index into the resolved locations
+    // ------------------------------------------------------------------------
+    void setBool(UniformHandle handle, bool value) const
+    {
+        glUniform1i(getLocation(handle), (int)value);
+    }
+    void setInt(UniformHandle handle, int value) const
+    {
+        glUniform1i(getLocation(handle), value);
+    }
+    void setFloat(UniformHandle handle, float value) const
+    {
+        glUniform1f(getLocation(handle), value);
+    }
+    void setVec2(UniformHandle handle, const glm::vec2 &value) const
+    {
+        glUniform2fv(getLocation(handle), 1, &value[0]);
+    }
+    void setVec3(UniformHandle handle, const glm::vec3 &value) const
+    {
+        glUniform3fv(getLocation(handle), 1, &value[0]);
+    }
+    void setVec4(UniformHandle handle, const glm::vec4 &value) const
+    {
+        glUniform4fv(getLocation(handle), 1, &value[0]);
+    }
+    void setMat2(UniformHandle handle, const glm::mat2 &mat) const
+    {
+        glUniformMatrix2fv(getLocation(handle), 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat3(UniformHandle handle, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(getLocation(handle), 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(UniformHandle handle, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(getLocation(handle), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    mutable std::unordered_map<std::string, int> uniformLocations;
+    std::vector<std::string> handleNames;
+    std::vector<int> handleLocations;
+    std::vector<std::pair<std::string, GLuint>> blockBindings;
+
+    void applyUniformBlockBinding(const std::string &blockName, GLuint binding)
+    {
+        GLuint index = glGetUniformBlockIndex(ID, blockName.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+
+    // query every active uniform once after linking instead of calling glGetUniformLocation per set
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        uniformLocations.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> nameBuffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+            // members of uniform blocks have no location
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0)
+                continue;
+            uniformLocations[name] = location;
+            // arrays are reported as "name[0]" but are usually set by their bare name
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+                uniformLocations[name.substr(0, name.size() - 3)] = location;
+        }
+        for (size_t i = 0; i < handleNames.size(); i++)
+            handleLocations[i] = getLocation(handleNames[i]);
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    static bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -160,6 +338,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
 #endif
\ No newline at end of file
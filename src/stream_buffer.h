@@ -0,0 +1,169 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Ring buffer for data the CPU rewrites every frame (instance matrices, uniform blocks).
+// The buffer is split into one region per frame in flight. A frame writes only its own region and fences it
+// when its draws are submitted; the region is reused framesInFlight frames later, after that fence signaled.
+// So the CPU fills frame N+1 while the GPU still reads frame N, without orphaning and without waiting.
+// With GL_ARB_buffer_storage the buffer is mapped once, persistently and coherently; otherwise each frame maps its
+// region with GL_MAP_UNSYNCHRONIZED_BIT (the fences already did the synchronization) and unmaps it before drawing.
+// Any bind target works: GL_UNIFORM_BUFFER ranges and GL_ARRAY_BUFFER offsets can come from the same buffer.
+class StreamBuffer
+{
+public:
+    // frame usage: beginFrame(bytes), allocate()... and write, unmap(), bind and draw, endFrame()
+    // ------------------------------------------------------------------------
+    void create(size_t initialFrameBytes, unsigned int frames = 3, bool allowPersistent = true)
+    {
+        framesInFlight = frames > 0 ? frames : 1;
+        persistent = allowPersistent && GLAD_GL_ARB_buffer_storage;
+        fences.assign(framesInFlight, nullptr);
+        allocateStorage(initialFrameBytes);
+    }
+
+    // Wait until this frame's region is free and make sure it holds at least bytes
+    void beginFrame(size_t bytes)
+    {
+        if (bytes > frameBytes)
+        {
+            // a new buffer object; the driver keeps the old one alive for draws still using it
+            size_t grown = frameBytes * 2;
+            allocateStorage(grown > bytes ? grown : bytes);
+        }
+
+        GLsync& fence = fences[region];
+        if (fence)
+        {
+            GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if (status == GL_TIMEOUT_EXPIRED)
+            {
+                // the GPU is still reading the region from framesInFlight frames ago
+                stalls++;
+                auto start = std::chrono::steady_clock::now();
+                while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+                    ;
+                stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+
+        regionStart = (size_t)region * frameBytes;
+        used = 0;
+        if (!persistent)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+            mapping = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr)regionStart, (GLsizeiptr)frameBytes,
+                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT));
+        }
+    }
+
+    // Reserve bytes in this frame's region; returns where to write them and their offset in the buffer.
+    // The caller reserved enough in beginFrame(), so this never fails.
+    unsigned char* allocate(size_t bytes, size_t alignment, GLintptr& offset)
+    {
+        size_t start = (regionStart + used + alignment - 1) / alignment * alignment;
+        used = start + bytes - regionStart;
+        offset = (GLintptr)start;
+        return persistent ? mapping + start : mapping + (start - regionStart);
+    }
+
+    // finish writing; must be called before the frame's draws read the buffer
+    void unmap()
+    {
+        if (persistent || !mapping)
+            return;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        if (used > 0)
+            glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)used);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        mapping = nullptr;
+    }
+
+    // fence the region after the frame's draws were submitted and move on to the next one
+    void endFrame()
+    {
+        unmap();
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        peakBytes = used > peakBytes ? used : peakBytes;
+        region = (region + 1) % framesInFlight;
+    }
+
+    GLuint id() const { return ID; }
+    bool isPersistent() const { return persistent; }
+    unsigned long long stallCount() const { return stalls; }
+
+    void printStats(std::ostream& out) const
+    {
+        out << "stream buffer: " << (persistent ? "persistent" : "unsynchronized map") << ", " << framesInFlight
+            << " frames in flight, " << frameBytes / 1024.0 << " KB per frame (peak " << peakBytes / 1024.0 << " KB), "
+            << stalls << " stalls (" << stallSeconds * 1000.0 << " ms waited)" << std::endl;
+    }
+
+    void destroy()
+    {
+        releaseStorage();
+    }
+
+private:
+    GLuint ID = 0;
+    unsigned char* mapping = nullptr;   // whole buffer when persistent, else the current region while mapped
+    bool persistent = false;
+    unsigned int framesInFlight = 3;
+    unsigned int region = 0;
+    size_t frameBytes = 0, regionStart = 0, used = 0, peakBytes = 0;
+    std::vector<GLsync> fences;
+    unsigned long long stalls = 0;
+    double stallSeconds = 0.0;
+
+    void allocateStorage(size_t bytes)
+    {
+        releaseStorage();
+        // keep regions aligned for any uniform buffer offset alignment
+        frameBytes = (bytes + 255) / 256 * 256;
+        GLsizeiptr total = (GLsizeiptr)(frameBytes * framesInFlight);
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        if (persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_COPY_WRITE_BUFFER, total, NULL, flags);
+            mapping = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags));
+        }
+        else
+        {
+            glBufferData(GL_COPY_WRITE_BUFFER, total, NULL, GL_STREAM_DRAW);
+        }
+        region = 0;
+    }
+
+    void releaseStorage()
+    {
+        for (GLsync& fence : fences)
+        {
+            if (fence)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+        if (ID)
+        {
+            if (mapping)
+            {
+                glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+                glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            }
+            glDeleteBuffers(1, &ID);
+        }
+        ID = 0;
+        mapping = nullptr;
+    }
+};
+#endif
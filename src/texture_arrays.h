@@ -0,0 +1,267 @@
+#ifndef TEXTURE_ARRAYS_H
+#define TEXTURE_ARRAYS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Where an image ended up: array texture, layer, and the part of the layer it covers.
+// Sample it at vec3(uv * rect.xy + rect.zw, layer).
+struct TextureRegion
+{
+    unsigned int array = 0;
+    unsigned int layer = 0;
+    glm::vec4 rect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);   // xy: scale, zw: offset in layer texture coordinates
+};
+
+// Packs images into GL_TEXTURE_2D_ARRAY textures so that objects with different images share one bind and one draw.
+// Images are bucketed by size class, the power of two square that holds them. An image of exactly its class size
+// takes a whole layer; any other size is shelf-packed with a gutter of replicated edge texels into atlas layers of
+// its class. Classes that would exceed maxArrays are merged into the next larger one, so with maxArrays = 1
+// everything lands in one array and the shader picks images with a layer index and a rect.
+// Images are decoded with stb_image as RGBA8 and respect stbi_set_flip_vertically_on_load.
+class TextureArrayManager
+{
+public:
+    static const int Gutter = 16;           // texels around atlas entries
+    static const int MinClassSize = 64;
+
+    // decode an image; returns its index for region(), or -1 if it could not be loaded
+    int add(const std::string& path)
+    {
+        Image image;
+        int channels = 0;
+        unsigned char* data = stbi_load(path.c_str(), &image.width, &image.height, &channels, 4);
+        if (!data)
+        {
+            std::cout << "ERROR::TEXTURE_ARRAYS::FAILED_TO_LOAD " << path << std::endl;
+            return -1;
+        }
+        image.pixels.assign(data, data + (size_t)image.width * image.height * 4);
+        stbi_image_free(data);
+        images.push_back(std::move(image));
+        regions.push_back(TextureRegion());
+        return (int)images.size() - 1;
+    }
+
+    // pack the added images and upload them; the decoded pixels are released afterwards
+    void build(unsigned int maxArrays = 1)
+    {
+        // bucket by size class, smallest first
+        std::map<int, std::vector<unsigned int>> buckets;
+        for (unsigned int i = 0; i < images.size(); i++)
+            buckets[sizeClass(images[i])].push_back(i);
+        while (buckets.size() > std::max(maxArrays, 1u))
+        {
+            auto smallest = buckets.begin();
+            std::vector<unsigned int>& larger = std::next(smallest)->second;
+            larger.insert(larger.end(), smallest->second.begin(), smallest->second.end());
+            buckets.erase(smallest);
+        }
+
+        for (auto& bucket : buckets)
+            buildArray(bucket.first, bucket.second);
+
+        for (Image& image : images)
+            std::vector<unsigned char>().swap(image.pixels);
+    }
+
+    const TextureRegion& region(unsigned int image) const
+    {
+        return regions[image];
+    }
+
+    size_t arrayCount() const
+    {
+        return arrays.size();
+    }
+
+    GLuint array(unsigned int index) const
+    {
+        return arrays[index].id;
+    }
+
+    // images, arrays with their layer size and count, and how much of the atlas layers the packed images cover
+    void printStats(std::ostream& out) const
+    {
+        out << "texture arrays: " << images.size() << " images in " << arrays.size() << (arrays.size() == 1 ? " array" : " arrays");
+        for (const Array& a : arrays)
+            out << ", " << a.size << "x" << a.size << " x " << a.layers << " layers (" << a.exactImages << " whole, "
+                << a.atlasImages << " packed, " << (a.atlasLayers ? 100.0 * a.atlasArea / ((double)a.atlasLayers * a.size * a.size) : 0.0)
+                << "% of atlas area used)";
+        out << std::endl;
+    }
+
+    void destroy()
+    {
+        for (Array& a : arrays)
+            glDeleteTextures(1, &a.id);
+        arrays.clear();
+    }
+
+private:
+    struct Image
+    {
+        int width = 0, height = 0;
+        std::vector<unsigned char> pixels;  // RGBA8
+    };
+    struct Array
+    {
+        GLuint id = 0;
+        int size = 0;
+        int layers = 0, atlasLayers = 0;
+        unsigned int exactImages = 0, atlasImages = 0;
+        double atlasArea = 0.0;
+    };
+    // a row of the atlas, filled left to right
+    struct Shelf
+    {
+        int y, height, x;
+    };
+
+    std::vector<Image> images;
+    std::vector<TextureRegion> regions;
+    std::vector<Array> arrays;
+
+    static bool exactFit(const Image& image, int size)
+    {
+        return image.width == size && image.height == size;
+    }
+
+    // the smallest power of two square that holds the image, with the gutter unless it fills a layer exactly
+    static int sizeClass(const Image& image)
+    {
+        int size = MinClassSize;
+        while (size < image.width || size < image.height)
+            size *= 2;
+        if (exactFit(image, size))
+            return size;
+        while (size < image.width + 2 * Gutter || size < image.height + 2 * Gutter)
+            size *= 2;
+        return size;
+    }
+
+    void buildArray(int size, std::vector<unsigned int> members)
+    {
+        Array a;
+        a.size = size;
+        std::vector<std::vector<unsigned char>> layers;
+        auto newLayer = [&]()
+        {
+            layers.push_back(std::vector<unsigned char>((size_t)size * size * 4, 0));
+            return (int)layers.size() - 1;
+        };
+
+        // whole layers first, then the atlas entries tallest first so the shelves stay tight
+        std::stable_sort(members.begin(), members.end(), [&](unsigned int l, unsigned int r)
+        {
+            bool le = exactFit(images[l], size), re = exactFit(images[r], size);
+            if (le != re)
+                return le;
+            return images[l].height > images[r].height;
+        });
+
+        std::vector<Shelf> shelves;
+        int atlasLayer = -1;
+        for (unsigned int index : members)
+        {
+            const Image& image = images[index];
+            TextureRegion& region = regions[index];
+            region.array = (unsigned int)arrays.size();
+            if (exactFit(image, size))
+            {
+                region.layer = (unsigned int)newLayer();
+                region.rect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+                copyImage(layers[region.layer], size, image, 0, 0, 0);
+                a.exactImages++;
+                continue;
+            }
+
+            int w = image.width + 2 * Gutter, h = image.height + 2 * Gutter;
+            int x = -1, y = -1;
+            if (atlasLayer >= 0)
+            {
+                for (Shelf& shelf : shelves)
+                {
+                    if (h <= shelf.height && shelf.x + w <= size)
+                    {
+                        x = shelf.x;
+                        y = shelf.y;
+                        shelf.x += w;
+                        break;
+                    }
+                }
+                int top = shelves.empty() ? 0 : shelves.back().y + shelves.back().height;
+                if (x < 0 && top + h <= size)
+                {
+                    shelves.push_back(Shelf{ top, h, w });
+                    x = 0;
+                    y = top;
+                }
+            }
+            if (x < 0)
+            {
+                // start a new atlas layer
+                atlasLayer = newLayer();
+                a.atlasLayers++;
+                shelves.assign(1, Shelf{ 0, h, w });
+                x = 0;
+                y = 0;
+            }
+
+            region.layer = (unsigned int)atlasLayer;
+            region.rect = glm::vec4((float)image.width / size, (float)image.height / size,
+                                    (float)(x + Gutter) / size, (float)(y + Gutter) / size);
+            copyImage(layers[atlasLayer], size, image, x + Gutter, y + Gutter, Gutter);
+            a.atlasImages++;
+            a.atlasArea += (double)image.width * image.height;
+        }
+
+        a.layers = (int)layers.size();
+        glGenTextures(1, &a.id);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, a.id);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, a.layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        for (int layer = 0; layer < a.layers; layer++)
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, layers[layer].data());
+        // atlas neighbours start bleeding into each other once a mip texel spans more than the gutter
+        if (a.atlasLayers > 0)
+        {
+            int maxLevel = 0;
+            while ((1 << (maxLevel + 1)) <= Gutter)
+                maxLevel++;
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, maxLevel);
+        }
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        arrays.push_back(a);
+    }
+
+    // copy the image to (x, y) of a layer and fill a border of the given width with its edge texels
+    static void copyImage(std::vector<unsigned char>& layer, int size, const Image& image, int x, int y, int border)
+    {
+        for (int row = -border; row < image.height + border; row++)
+        {
+            int srcRow = std::min(std::max(row, 0), image.height - 1);
+            const unsigned char* src = &image.pixels[(size_t)srcRow * image.width * 4];
+            unsigned char* dst = &layer[((size_t)(y + row) * size + x) * 4];
+            for (int col = -border; col < 0; col++)
+                std::memcpy(dst + col * 4, src, 4);
+            std::memcpy(dst, src, (size_t)image.width * 4);
+            for (int col = image.width; col < image.width + border; col++)
+                std::memcpy(dst + col * 4, src + (image.width - 1) * 4, 4);
+        }
+    }
+};
+#endif
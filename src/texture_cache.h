@@ -0,0 +1,276 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include "hash.h"
+#include "mapped_file.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Cooked texture container (.b3tx): a header, a level table and every mip level already laid out
+// as the GL internal format expects it, so a mapped file can be handed to glTexImage2D level by level
+// with no decode and no copy. Entries live in a cache directory next to textures/, one file per source
+// image, and record the size, modification time and FNV-1a content hash of the image they were cooked from.
+
+const uint32_t CookedTextureVersion = 2;
+const int CookedTextureMaxLevels = 16;
+
+struct CookedTextureLevel
+{
+    uint64_t offset;    // from the start of the file
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct CookedTextureHeader
+{
+    char magic[4];              // "B3TX"
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t sourceModified;     // modification time of the source image in nanoseconds, see modifiedNanoseconds()
+    uint64_t sourceHash;        // FNV-1a of the source image bytes
+    uint32_t flipped;           // rows were flipped vertically at cook time
+    uint32_t channels;
+    uint32_t internalFormat, format, type;
+    uint32_t levelCount;
+    CookedTextureLevel levels[CookedTextureMaxLevels];
+};
+
+// st_mtim with its nanoseconds: a source edited within the second it was cooked in must not look up to date
+inline int64_t modifiedNanoseconds(const struct stat& info)
+{
+    return (int64_t)info.st_mtim.tv_sec * 1000000000 + (int64_t)info.st_mtim.tv_nsec;
+}
+
+// GL format and sized internal format of an 8-bit image with 1 to 4 channels; grey and grey+alpha images keep
+// their one and two channels, setChannelSwizzle() spreads them back over RGB when they are sampled
+inline GLenum pixelFormat(int channels)
+{
+    static const GLenum formats[] = { GL_RED, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    return formats[channels];
+}
+
+inline GLenum pixelInternalFormat(int channels)
+{
+    static const GLenum internalFormats[] = { GL_R8, GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+    return internalFormats[channels];
+}
+
+// swizzle for the texture bound to GL_TEXTURE_2D so it samples as grey, grey+alpha, RGB or RGBA
+inline void setChannelSwizzle(int channels)
+{
+    static const GLint swizzles[][4] = {
+        { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA }, { GL_RED, GL_RED, GL_RED, GL_ONE }, { GL_RED, GL_RED, GL_RED, GL_GREEN },
+        { GL_RED, GL_GREEN, GL_BLUE, GL_ONE }, { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA }
+    };
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzles[channels]);
+}
+
+// cache file for a source image; keyed by path and flip so both variants can coexist
+inline std::string cookedTexturePath(const std::string& cacheDirectory, const std::string& sourcePath, bool flip)
+{
+    uint64_t key = fnv1a64(sourcePath + (flip ? "#flip" : ""));
+    return cacheDirectory + "/" + hashToHex(key) + ".b3tx";
+}
+
+inline bool readFileBytes(const std::string& path, std::vector<unsigned char>& bytes)
+{
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    bytes.resize(size > 0 ? (size_t)size : 0);
+    size_t read = bytes.empty() ? 0 : std::fread(bytes.data(), 1, bytes.size(), file);
+    std::fclose(file);
+    return read == bytes.size();
+}
+
+// A mapped cooked texture. valid() is false when the file is missing, corrupt or stale.
+class CookedTexture
+{
+public:
+    // map the entry for sourcePath and check it against the current source image:
+    // size and modification time are compared first, the content hash only if the time changed
+    bool open(const std::string& cacheDirectory, const std::string& sourcePath, bool flip)
+    {
+        header = nullptr;
+        std::string path = cookedTexturePath(cacheDirectory, sourcePath, flip);
+        if (!file.open(path) || file.size() < sizeof(CookedTextureHeader))
+            return false;
+        const CookedTextureHeader* candidate = reinterpret_cast<const CookedTextureHeader*>(file.data());
+        if (std::memcmp(candidate->magic, "B3TX", 4) != 0 || candidate->version != CookedTextureVersion
+            || candidate->flipped != (flip ? 1u : 0u) || !hasValidLevels(*candidate, file.size()))
+            return false;
+
+        struct stat info;
+        if (stat(sourcePath.c_str(), &info) != 0 || (uint64_t)info.st_size != candidate->sourceSize)
+            return false;
+        if (modifiedNanoseconds(info) != candidate->sourceModified)
+        {
+            // touched but possibly unchanged (e.g. a fresh checkout)
+            std::vector<unsigned char> bytes;
+            if (!readFileBytes(sourcePath, bytes) || fnv1a64(bytes.data(), bytes.size()) != candidate->sourceHash)
+                return false;
+            // unchanged: stamp the new time so the next launch skips the hash
+            restamp(path, modifiedNanoseconds(info));
+        }
+        header = candidate;
+        return true;
+    }
+
+    bool valid() const { return header != nullptr; }
+    const CookedTextureHeader& info() const { return *header; }
+    const unsigned char* level(uint32_t index) const { return file.data() + header->levels[index].offset; }
+    size_t size() const { return file.size(); }
+
+private:
+    // The level table must describe exactly the mip chain cookTexture writes: 8-bit levels in the format of the
+    // channel count, each half the size of the one before and wholly inside the file. glTexImage2D reads as many
+    // bytes as the dimensions ask for, so anything else would read past the mapping.
+    static bool hasValidLevels(const CookedTextureHeader& candidate, size_t fileSize)
+    {
+        if (candidate.channels < 1 || candidate.channels > 4 || candidate.levelCount == 0 || candidate.levelCount > CookedTextureMaxLevels
+            || candidate.format != pixelFormat((int)candidate.channels) || candidate.internalFormat != pixelInternalFormat((int)candidate.channels)
+            || candidate.type != GL_UNSIGNED_BYTE)
+            return false;
+        for (uint32_t i = 0; i < candidate.levelCount; i++)
+        {
+            const CookedTextureLevel& level = candidate.levels[i];
+            if (level.width == 0 || level.height == 0 || level.offset < sizeof(CookedTextureHeader)
+                || level.offset > fileSize || level.size > fileSize - level.offset
+                || level.size % candidate.channels != 0 || level.size / candidate.channels != (uint64_t)level.width * level.height)
+                return false;
+            if (i > 0)
+            {
+                const CookedTextureLevel& previous = candidate.levels[i - 1];
+                if ((previous.width == 1 && previous.height == 1)
+                    || level.width != std::max(1u, previous.width / 2) || level.height != std::max(1u, previous.height / 2))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // rewrite sourceModified in place; the entry stays valid either way, so a failure only costs the next launch a hash
+    static void restamp(const std::string& path, int64_t modified)
+    {
+        FILE* out = std::fopen(path.c_str(), "r+b");
+        if (!out)
+            return;
+        if (std::fseek(out, (long)offsetof(CookedTextureHeader, sourceModified), SEEK_SET) == 0)
+            std::fwrite(&modified, sizeof(modified), 1, out);
+        std::fclose(out);
+    }
+
+    MappedFile file;
+    const CookedTextureHeader* header = nullptr;
+};
+
+// halve an 8-bit image with a box filter; odd edges reuse the last row/column
+inline std::vector<unsigned char> downsampleBox(const unsigned char* pixels, int width, int height, int channels, int& outWidth, int& outHeight)
+{
+    outWidth = std::max(1, width / 2);
+    outHeight = std::max(1, height / 2);
+    std::vector<unsigned char> result((size_t)outWidth * outHeight * channels);
+    for (int y = 0; y < outHeight; y++)
+    {
+        int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+        for (int x = 0; x < outWidth; x++)
+        {
+            int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            for (int c = 0; c < channels; c++)
+            {
+                int sum = pixels[((size_t)y0 * width + x0) * channels + c] + pixels[((size_t)y0 * width + x1) * channels + c]
+                        + pixels[((size_t)y1 * width + x0) * channels + c] + pixels[((size_t)y1 * width + x1) * channels + c];
+                result[((size_t)y * outWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return result;
+}
+
+// Write the cache entry for sourcePath from its decoded pixels, building the full mip chain; pixels becomes level 0.
+// The file is written under a temporary name and renamed, so concurrent readers never see a partial entry.
+inline bool cookTexture(const std::string& cacheDirectory, const std::string& sourcePath, bool flip,
+                        std::vector<unsigned char> pixels, int width, int height, int channels)
+{
+    struct stat info;
+    std::vector<unsigned char> source;
+    if (channels < 1 || channels > 4 || stat(sourcePath.c_str(), &info) != 0 || !readFileBytes(sourcePath, source))
+        return false;
+    mkdir(cacheDirectory.c_str(), 0755);
+
+    CookedTextureHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "B3TX", 4);
+    header.version = CookedTextureVersion;
+    header.sourceSize = (uint64_t)info.st_size;
+    header.sourceModified = modifiedNanoseconds(info);
+    header.sourceHash = fnv1a64(source.data(), source.size());
+    header.flipped = flip ? 1 : 0;
+    header.channels = (uint32_t)channels;
+    header.internalFormat = pixelInternalFormat(channels);
+    header.format = pixelFormat(channels);
+    header.type = GL_UNSIGNED_BYTE;
+
+    // level 0 is the decoded image, every further level halves the previous one down to 1x1
+    std::vector<std::vector<unsigned char>> levels;
+    levels.push_back(std::move(pixels));
+    uint64_t offset = sizeof(CookedTextureHeader);
+    int levelWidth = width, levelHeight = height;
+    while (true)
+    {
+        CookedTextureLevel& level = header.levels[header.levelCount++];
+        level.offset = offset;
+        level.size = levels.back().size();
+        level.width = (uint32_t)levelWidth;
+        level.height = (uint32_t)levelHeight;
+        offset += (level.size + 15) & ~uint64_t(15);
+        if ((levelWidth == 1 && levelHeight == 1) || header.levelCount == CookedTextureMaxLevels)
+            break;
+        int nextWidth, nextHeight;
+        levels.push_back(downsampleBox(levels.back().data(), levelWidth, levelHeight, channels, nextWidth, nextHeight));
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+
+    std::string path = cookedTexturePath(cacheDirectory, sourcePath, flip), temporary;
+    FILE* file = createTemporaryFile(path, temporary);
+    if (!file)
+        return false;
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    const unsigned char padding[16] = {};
+    for (uint32_t i = 0; i < header.levelCount && ok; i++)
+    {
+        ok = std::fwrite(levels[i].data(), 1, levels[i].size(), file) == levels[i].size();
+        size_t pad = ((levels[i].size() + 15) & ~size_t(15)) - levels[i].size();
+        ok = ok && std::fwrite(padding, 1, pad, file) == pad;
+    }
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+inline bool cookTexture(const std::string& cacheDirectory, const std::string& sourcePath, bool flip,
+                        const unsigned char* pixels, int width, int height, int channels)
+{
+    return cookTexture(cacheDirectory, sourcePath, flip, std::vector<unsigned char>(pixels, pixels + (size_t)width * height * channels),
+                       width, height, channels);
+}
+#endif
@@ -0,0 +1,346 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include "texture_cache.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// handle to a texture managed by TextureLoader; id is a valid GL texture name from the moment load() returns
+struct TextureHandle
+{
+    unsigned int id = 0;
+    int index = -1;
+};
+
+// Asynchronous texture loading service.
+// Worker threads read and decode images with stbi_load_from_memory. The GL thread calls update() once per frame,
+// which copies decoded pixels into a pixel-buffer-object ring and uploads them from there. Until its image has
+// been uploaded every texture shows a 1x1 grey placeholder, so rendering can start before anything is decoded.
+// With a cache directory, images that have an up-to-date cooked entry (texture_cache.h) skip the workers
+// entirely and are uploaded straight from the mapped file; the others are cooked by the worker after decoding.
+class TextureLoader
+{
+public:
+    // workers: decode threads (0 = one per hardware thread, minus the GL thread)
+    // ringBytes: size of the pixel unpack buffer ring
+    // cacheDirectory: where cooked textures are looked up and written, empty to disable the cache
+    explicit TextureLoader(unsigned int workers = 0, size_t ringBytes = 16 * 1024 * 1024, const std::string& cacheDirectory = "")
+        : cacheDirectory(cacheDirectory), ringSize(ringBytes)
+    {
+        if (workers == 0)
+            workers = std::max(1u, std::thread::hardware_concurrency() - 1);
+        for (unsigned int i = 0; i < workers; i++)
+            threads.emplace_back(&TextureLoader::workerLoop, this);
+
+        glGenBuffers(1, &pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, ringSize, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    ~TextureLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeWorkers.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+        for (InFlight& upload : inFlight)
+            glDeleteSync(upload.fence);
+        for (Decoded& image : decoded)
+            stbi_image_free(image.pixels);
+        glDeleteBuffers(1, &pbo);
+    }
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // create the texture with its placeholder and queue the image for decoding; call on the GL thread
+    // ------------------------------------------------------------------------
+    TextureHandle load(const std::string& path, GLint minFilter = GL_LINEAR_MIPMAP_LINEAR, bool flipVertically = true)
+    {
+        TextureHandle handle;
+        glGenTextures(1, &handle.id);
+        glBindTexture(GL_TEXTURE_2D, handle.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+
+        handle.index = (int)resident.size();
+        resident.push_back(false);
+        textures.push_back(handle.id);
+        outstanding++;
+
+        if (!cacheDirectory.empty())
+        {
+            std::unique_ptr<CookedTexture> cookedTexture(new CookedTexture());
+            if (cookedTexture->open(cacheDirectory, path, flipVertically))
+            {
+                cacheHits++;
+                cooked.push_back(Cooked{ handle.index, std::move(cookedTexture) });
+                return handle;
+            }
+            cacheMisses++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back(Request{ path, handle.index, flipVertically });
+        }
+        wakeWorkers.notify_one();
+        return handle;
+    }
+
+    // upload decoded images, at most uploadBudget bytes per call (but always at least one image)
+    // returns the number of textures that became resident; call once per frame on the GL thread
+    // ------------------------------------------------------------------------
+    unsigned int update(size_t uploadBudget = 8 * 1024 * 1024)
+    {
+        // cooked textures first, they cost no more than the copy inside the driver
+        size_t bytes = 0;
+        unsigned int uploaded = 0;
+        while (!cooked.empty() && (uploaded == 0 || bytes + cooked.front().texture->size() <= uploadBudget))
+        {
+            bytes += cooked.front().texture->size();
+            uploadCooked(cooked.front());
+            resident[cooked.front().index] = true;
+            outstanding--;
+            uploaded++;
+            cooked.pop_front();
+        }
+
+        std::vector<Decoded> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!decoded.empty() && (uploaded + ready.size() == 0 || bytes + decoded.front().size() <= uploadBudget))
+            {
+                bytes += decoded.front().size();
+                ready.push_back(decoded.front());
+                decoded.pop_front();
+            }
+        }
+
+        for (Decoded& image : ready)
+        {
+            if (image.pixels)
+                upload(image);
+            else
+                std::cout << "Failed to load texture " << image.path << std::endl;
+            stbi_image_free(image.pixels);
+            resident[image.index] = true;
+            outstanding--;
+        }
+        retireUploads();
+        return uploaded + (unsigned int)ready.size();
+    }
+
+    bool isResident(TextureHandle handle) const
+    {
+        return handle.index >= 0 && resident[handle.index];
+    }
+
+    // true once every requested texture has been decoded and uploaded (or failed to load)
+    bool allResident() const
+    {
+        return outstanding.load() == 0;
+    }
+
+    // number of times the PBO ring was full and had to wait for the GPU to finish reading it
+    unsigned int ringStalls() const
+    {
+        return stalls;
+    }
+
+    // textures served from the cooked cache and textures that had to be decoded
+    unsigned int cacheHitCount() const { return cacheHits; }
+    unsigned int cacheMissCount() const { return cacheMisses; }
+
+private:
+    struct Request
+    {
+        std::string path;
+        int index;
+        bool flip;
+    };
+    struct Decoded
+    {
+        std::string path;
+        int index;
+        int width, height, channels;
+        unsigned char* pixels;
+        size_t size() const { return (size_t)width * height * channels; }
+    };
+    struct InFlight
+    {
+        size_t offset, size;
+        GLsync fence;
+    };
+    struct Cooked
+    {
+        int index;
+        std::unique_ptr<CookedTexture> texture;
+    };
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::deque<Request> requests;
+    std::deque<Decoded> decoded;
+    bool stopping = false;
+    std::atomic<unsigned int> outstanding{ 0 };
+
+    std::vector<bool> resident;
+    std::vector<unsigned int> textures;
+
+    std::string cacheDirectory;
+    std::deque<Cooked> cooked;
+    unsigned int cacheHits = 0, cacheMisses = 0;
+
+    unsigned int pbo = 0;
+    size_t ringSize;
+    size_t ringCursor = 0;
+    std::deque<InFlight> inFlight;
+    unsigned int stalls = 0;
+
+    // worker thread: read the file and decode it, flip state is per thread
+    // ------------------------------------------------------------------------
+    void workerLoop()
+    {
+        while (true)
+        {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeWorkers.wait(lock, [this]() { return stopping || !requests.empty(); });
+                if (stopping)
+                    return;
+                request = requests.front();
+                requests.pop_front();
+            }
+
+            Decoded image{ request.path, request.index, 0, 0, 0, NULL };
+            std::ifstream file(request.path, std::ios::binary);
+            std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            if (!bytes.empty())
+            {
+                stbi_set_flip_vertically_on_load_thread(request.flip);
+                image.pixels = stbi_load_from_memory(bytes.data(), (int)bytes.size(), &image.width, &image.height, &image.channels, 0);
+            }
+            // hand the image to the uploads first, the render thread may free it from then on, so the cook
+            // works on a copy and the texture does not wait for the disk write
+            std::vector<unsigned char> pixels;
+            if (image.pixels && !cacheDirectory.empty())
+                pixels.assign(image.pixels, image.pixels + image.size());
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                decoded.push_back(image);
+            }
+
+            // refresh the cache entry so the next launch can skip the decode
+            if (!pixels.empty())
+                cookTexture(cacheDirectory, request.path, request.flip, std::move(pixels), image.width, image.height, image.channels);
+        }
+    }
+
+    // copy the pixels into the ring and upload from there
+    // ------------------------------------------------------------------------
+    void upload(const Decoded& image)
+    {
+        GLenum format = pixelFormat(image.channels);
+        glBindTexture(GL_TEXTURE_2D, textures[image.index]);
+        setChannelSwizzle(image.channels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        size_t size = image.size();
+        if (size > ringSize)
+        {
+            // larger than the whole ring, upload straight from client memory
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+        }
+        else
+        {
+            size_t offset = allocate(size);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+            // unsynchronized: the fences below guarantee the GPU is done with this range
+            void* destination = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            std::copy(image.pixels, image.pixels + size, (unsigned char*)destination);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, (void*)offset);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            inFlight.push_back(InFlight{ offset, size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+        }
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // upload every mip level straight from the mapped cache entry
+    // ------------------------------------------------------------------------
+    void uploadCooked(const Cooked& entry)
+    {
+        const CookedTextureHeader& info = entry.texture->info();
+        glBindTexture(GL_TEXTURE_2D, textures[entry.index]);
+        setChannelSwizzle((int)info.channels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (uint32_t level = 0; level < info.levelCount; level++)
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, info.internalFormat, info.levels[level].width, info.levels[level].height, 0,
+                         info.format, info.type, entry.texture->level(level));
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, info.levelCount - 1);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // reserve size bytes of the ring, waiting for the oldest uploads if they still overlap
+    size_t allocate(size_t size)
+    {
+        if (ringCursor + size > ringSize)
+            ringCursor = 0;
+        while (!inFlight.empty())
+        {
+            const InFlight& oldest = inFlight.front();
+            bool overlaps = ringCursor < oldest.offset + oldest.size && oldest.offset < ringCursor + size;
+            if (!overlaps)
+                break;
+            if (glClientWaitSync(oldest.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                stalls++;
+                glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            }
+            glDeleteSync(oldest.fence);
+            inFlight.pop_front();
+        }
+        size_t offset = ringCursor;
+        ringCursor += size;
+        return offset;
+    }
+
+    // drop fences of uploads the GPU has already consumed
+    void retireUploads()
+    {
+        while (!inFlight.empty() && glClientWaitSync(inFlight.front().fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+        {
+            glDeleteSync(inFlight.front().fence);
+            inFlight.pop_front();
+        }
+    }
+};
+#endif
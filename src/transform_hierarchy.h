@@ -0,0 +1,250 @@
+#ifndef TRANSFORM_HIERARCHY_H
+#define TRANSFORM_HIERARCHY_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "matrix_kernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// A local transform: scale first, then rotation, then translation
+struct Transform
+{
+    glm::vec3 translation = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// The TRS of an affine matrix without shear (glTF requires node matrices to be one); a mirroring matrix gets a
+// negative x scale
+inline Transform decomposeTransform(const glm::mat4& m)
+{
+    Transform transform;
+    transform.translation = glm::vec3(m[3]);
+    glm::mat3 basis(m);
+    transform.scale = glm::vec3(glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2]));
+    if (glm::determinant(basis) < 0.0f)
+        transform.scale.x = -transform.scale.x;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (transform.scale[axis] != 0.0f)
+            basis[axis] /= transform.scale[axis];
+    }
+    transform.rotation = glm::normalize(glm::quat_cast(basis));
+    return transform;
+}
+
+// what update() did, accumulated
+struct TransformStats
+{
+    unsigned long long updates = 0;         // calls
+    unsigned long long dirtyUpdates = 0;    // calls that found something to recompute
+    unsigned long long recomputed = 0;      // world matrices
+    double seconds = 0.0;
+
+    void print(std::ostream& out, size_t nodeCount) const
+    {
+        if (updates == 0)
+            return;
+        out << "transforms: " << nodeCount << " nodes (" << matrixKernelName(bestMatrixKernel()) << " kernel), " << dirtyUpdates
+            << " of " << updates << " updates had changes, avg "
+            << (double)recomputed / updates << " world matrices recomputed per update, "
+            << seconds / updates * 1000.0 << " ms" << std::endl;
+    }
+};
+
+// Scene graph transforms in structure-of-arrays form: local translations, rotations and scales, parents and world
+// matrices in separate arrays, all in depth-first order. Every node comes after its parent and every subtree is one
+// contiguous range, so a world matrix only ever reads a parent computed before it and recomputing a changed subtree
+// is one linear pass over its range.
+// All nodes are added first, each with the id of an earlier parent, then build() orders them once; ids stay valid
+// and map to slots in that order. setLocal() only marks the node dirty; update() recomputes the dirty subtrees,
+// skipping everything before the first and after the last, and returns at once when nothing changed, so static
+// scenes cost nothing.
+//   uint32_t root = transforms.add(rootTransform);
+//   uint32_t child = transforms.add(childTransform, root);
+//   transforms.build();
+//   transforms.setLocal(root, moved); transforms.update();    // child follows
+class TransformHierarchy
+{
+public:
+    static constexpr uint32_t NoParent = ~0u;
+
+    // a node below parent (an id returned earlier, or NoParent for a root); returns its id
+    uint32_t add(const Transform& local, uint32_t parent = NoParent)
+    {
+        uint32_t id = (uint32_t)addedParents.size();
+        addedParents.push_back(parent < id ? parent : NoParent);
+        addedLocals.push_back(local);
+        return id;
+    }
+
+    size_t size() const
+    {
+        return world.size();
+    }
+
+    // order the added nodes depth first and compute every world matrix
+    void build()
+    {
+        size_t n = addedParents.size();
+        // children of every node in the order they were added, as ranges of one array
+        std::vector<uint32_t> childStart(n + 3, 0), children(n);
+        for (uint32_t parent : addedParents)
+            childStart[(parent == NoParent ? n : parent) + 2]++;
+        for (size_t k = 2; k < n + 3; k++)
+            childStart[k] += childStart[k - 1];
+        for (uint32_t id = 0; id < n; id++)
+            children[childStart[(addedParents[id] == NoParent ? n : addedParents[id]) + 1]++] = id;
+        // childStart[k] .. childStart[k + 1] now holds the children of k, and n stands for the roots
+
+        // depth first with an explicit stack, children in the order they were added
+        slotOf.assign(n, 0);
+        std::vector<uint32_t> idOf(n), stack;
+        stack.reserve(64);
+        for (uint32_t c = childStart[n + 1]; c-- > childStart[n]; )
+            stack.push_back(children[c]);
+        uint32_t next = 0;
+        while (!stack.empty())
+        {
+            uint32_t id = stack.back();
+            stack.pop_back();
+            slotOf[id] = next;
+            idOf[next++] = id;
+            for (uint32_t c = childStart[id + 1]; c-- > childStart[id]; )
+                stack.push_back(children[c]);
+        }
+
+        parents.resize(n);
+        translations.resize(n);
+        rotations.resize(n);
+        scales.resize(n);
+        for (uint32_t slot = 0; slot < n; slot++)
+        {
+            uint32_t id = idOf[slot];
+            parents[slot] = addedParents[id] == NoParent ? NoParent : slotOf[addedParents[id]];
+            translations[slot] = addedLocals[id].translation;
+            rotations[slot] = addedLocals[id].rotation;
+            scales[slot] = addedLocals[id].scale;
+        }
+        // children have larger slots than their parent, so walking backwards finishes every subtree before its parent
+        subtreeEnd.resize(n);
+        for (uint32_t slot = 0; slot < n; slot++)
+            subtreeEnd[slot] = slot + 1;
+        for (uint32_t slot = (uint32_t)n; slot-- > 0; )
+        {
+            if (parents[slot] != NoParent)
+                subtreeEnd[parents[slot]] = std::max(subtreeEnd[parents[slot]], subtreeEnd[slot]);
+        }
+
+        addedParents = std::vector<uint32_t>();
+        addedLocals = std::vector<Transform>();
+
+        world.resize(n);
+        dirty.assign(n, 0);
+        recompute(0, (uint32_t)n);
+        firstDirty = (uint32_t)n;
+        dirtyEnd = 0;
+    }
+
+    // replace a node's local transform; its subtree is recomputed by the next update()
+    void setLocal(uint32_t id, const Transform& local)
+    {
+        uint32_t slot = slotOf[id];
+        translations[slot] = local.translation;
+        rotations[slot] = local.rotation;
+        scales[slot] = local.scale;
+        dirty[slot] = 1;
+        firstDirty = std::min(firstDirty, slot);
+        dirtyEnd = std::max(dirtyEnd, subtreeEnd[slot]);
+    }
+
+    Transform local(uint32_t id) const
+    {
+        uint32_t slot = slotOf[id];
+        return Transform{ translations[slot], rotations[slot], scales[slot] };
+    }
+
+    const glm::mat4& worldMatrix(uint32_t id) const
+    {
+        return world[slotOf[id]];
+    }
+
+    // recompute the world matrices of every dirty subtree; returns how many were recomputed
+    size_t update()
+    {
+        stats.updates++;
+        if (firstDirty >= dirtyEnd)
+            return 0;
+        auto start = std::chrono::steady_clock::now();
+        size_t recomputed = 0;
+        for (uint32_t slot = firstDirty; slot < dirtyEnd; )
+        {
+            if (!dirty[slot])
+            {
+                slot++;
+                continue;
+            }
+            // the whole subtree changes with it, including nodes marked dirty themselves
+            uint32_t end = subtreeEnd[slot];
+            recompute(slot, end);
+            recomputed += end - slot;
+            slot = end;
+        }
+        firstDirty = (uint32_t)world.size();
+        dirtyEnd = 0;
+        stats.dirtyUpdates++;
+        stats.recomputed += recomputed;
+        stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return recomputed;
+    }
+
+    const TransformStats& transformStats() const
+    {
+        return stats;
+    }
+
+private:
+    // as added, by id, until build()
+    std::vector<uint32_t> addedParents;
+    std::vector<Transform> addedLocals;
+
+    // by slot
+    std::vector<uint32_t> parents;          // slot of the parent, NoParent for roots
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> world;
+    std::vector<uint32_t> subtreeEnd;       // one past the last slot of the node's subtree
+    std::vector<uint8_t> dirty;
+    std::vector<uint32_t> slotOf;           // by id
+
+    uint32_t firstDirty = 0, dirtyEnd = 0;  // slots that may hold dirty nodes and their subtrees
+    TransformStats stats;
+
+    static const uint32_t RecomputeBlock = 256;    // 16 KB of matrices
+
+    // the local matrices of a block with the batch kernel, then the parent products while the block is in cache; a
+    // parent in the same block comes earlier and is done first
+    void recompute(uint32_t first, uint32_t end)
+    {
+        for (uint32_t block = first; block < end; block += RecomputeBlock)
+        {
+            uint32_t blockEnd = std::min(end, block + RecomputeBlock);
+            composeMatrices(blockEnd - block, &translations[block], &rotations[block], &scales[block], nullptr, &world[block],
+                            sizeof(glm::mat4));
+            for (uint32_t slot = block; slot < blockEnd; slot++)
+            {
+                if (parents[slot] != NoParent)
+                    world[slot] = world[parents[slot]] * world[slot];
+                dirty[slot] = 0;
+            }
+        }
+    }
+};
+#endif
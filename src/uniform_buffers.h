@@ -0,0 +1,61 @@
+#ifndef UNIFORM_BUFFERS_H
+#define UNIFORM_BUFFERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Uniform block binding points, the same for every program (see Shader::bindUniformBlock)
+enum UniformBlockBinding : GLuint
+{
+    FrameBlockBinding = 0,  // FrameData: camera matrices, once per frame
+    ObjectBlockBinding = 1, // ObjectData: one entry per draw, selected with glBindBufferRange
+    MaterialBlockBinding = 2,   // MaterialData: texture array regions of every material, written once
+    MeshBlockBinding = 3        // MeshData: how to dequantize the mesh's vertex positions, written once
+};
+
+// CPU mirror of the std140 FrameData block in the vertex shaders; mat4 members need no padding
+struct FrameUniforms
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;   // precomputed once instead of multiplied per vertex
+};
+static_assert(sizeof(FrameUniforms) == 3 * 64, "FrameUniforms must match the std140 FrameData layout");
+
+// CPU mirror of the std140 ObjectData block in shaders/3.3.ubo.vs
+struct ObjectUniforms
+{
+    glm::mat4 model;
+};
+static_assert(sizeof(ObjectUniforms) == 64, "ObjectUniforms must match the std140 ObjectData layout");
+
+// CPU mirror of one entry of the std140 MaterialData block in shaders/3.3.array.fs
+struct MaterialUniforms
+{
+    glm::vec4 baseRect;     // xy scale, zw offset within the layer
+    glm::vec4 overlayRect;
+    glm::vec4 layers;       // x base layer, y overlay layer
+};
+static_assert(sizeof(MaterialUniforms) == 48, "MaterialUniforms must match the std140 MaterialRegions layout");
+
+// CPU mirror of the std140 MeshData block in the vertex shaders: position = aPos.xyz * scale + offset
+struct MeshUniforms
+{
+    glm::vec4 positionScale;
+    glm::vec4 positionOffset;
+};
+static_assert(sizeof(MeshUniforms) == 32, "MeshUniforms must match the std140 MeshData layout");
+
+// length of the materials array in MaterialData
+const unsigned int MaxArrayMaterials = 256;
+
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT: glBindBufferRange offsets for uniform blocks must be multiples of it
+inline size_t uniformBufferAlignment()
+{
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment > 0 ? (size_t)alignment : 256;
+}
+#endif
@@ -0,0 +1,273 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "mesh.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// What an attribute is encoded from: the mesh vertex and, for layouts with normals, its normal
+struct VertexSource
+{
+    glm::vec3 position;
+    glm::vec2 texCoord;
+    glm::vec3 normal;
+};
+
+// Box the quantized positions are relative to: stored = (position - center) / halfExtent, in [-1, 1].
+// The vertex shader undoes it with the MeshData block (position = stored * scale + offset).
+struct VertexBounds
+{
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 halfExtent = glm::vec3(1.0f);
+
+    static VertexBounds of(const std::vector<MeshVertex>& vertices)
+    {
+        VertexBounds bounds;
+        if (vertices.empty())
+            return bounds;
+        glm::vec3 lo = vertices[0].position, hi = vertices[0].position;
+        for (const MeshVertex& v : vertices)
+        {
+            lo = glm::min(lo, v.position);
+            hi = glm::max(hi, v.position);
+        }
+        bounds.center = 0.5f * (lo + hi);
+        bounds.halfExtent = glm::max(0.5f * (hi - lo), glm::vec3(1e-6f));
+        return bounds;
+    }
+};
+
+// Attribute formats. Each one names its shader location, how GL reads it and how a source vertex is encoded into it.
+// Locations follow the shaders: 0 position, 1 texture coordinate, 2..5 instance matrix, 6 material, 7 normal.
+
+// position as three floats, 12 bytes
+struct Pos_Float3
+{
+    static const GLuint location = 0;
+    static const GLint components = 3;
+    static const GLenum type = GL_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+    static const bool integer = false;
+    static const size_t size = 3 * sizeof(float);
+    static bool quantizesPosition() { return false; }
+    static const char* name() { return "Pos_Float3"; }
+    static void encode(unsigned char* out, const VertexSource& source, const VertexBounds&)
+    {
+        std::memcpy(out, &source.position, size);
+    }
+};
+
+// position relative to the mesh bounds as four normalized shorts (w unused), 8 bytes; 1/65535 of the mesh size
+struct Pos_Snorm16x4
+{
+    static const GLuint location = 0;
+    static const GLint components = 4;
+    static const GLenum type = GL_SHORT;
+    static const GLboolean normalized = GL_TRUE;
+    static const bool integer = false;
+    static const size_t size = 4 * sizeof(int16_t);
+    static bool quantizesPosition() { return true; }
+    static const char* name() { return "Pos_Snorm16x4"; }
+    static void encode(unsigned char* out, const VertexSource& source, const VertexBounds& bounds)
+    {
+        glm::vec3 unit = (source.position - bounds.center) / bounds.halfExtent;
+        glm::uint64 packed = glm::packSnorm4x16(glm::vec4(unit, 0.0f));
+        std::memcpy(out, &packed, size);
+    }
+};
+
+// texture coordinate as two floats, 8 bytes
+struct UV_Float2
+{
+    static const GLuint location = 1;
+    static const GLint components = 2;
+    static const GLenum type = GL_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+    static const bool integer = false;
+    static const size_t size = 2 * sizeof(float);
+    static bool quantizesPosition() { return false; }
+    static const char* name() { return "UV_Float2"; }
+    static void encode(unsigned char* out, const VertexSource& source, const VertexBounds&)
+    {
+        std::memcpy(out, &source.texCoord, size);
+    }
+};
+
+// texture coordinate as two half floats, 4 bytes; exact to 1/2048 in [0.5, 1], finer below
+struct UV_Half2
+{
+    static const GLuint location = 1;
+    static const GLint components = 2;
+    static const GLenum type = GL_HALF_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+    static const bool integer = false;
+    static const size_t size = 2 * sizeof(uint16_t);
+    static bool quantizesPosition() { return false; }
+    static const char* name() { return "UV_Half2"; }
+    static void encode(unsigned char* out, const VertexSource& source, const VertexBounds&)
+    {
+        glm::uint packed = glm::packHalf2x16(source.texCoord);
+        std::memcpy(out, &packed, size);
+    }
+};
+
+// unit normal in octahedral encoding as two normalized bytes, 2 bytes; decode in the shader with
+// n = vec3(e, 1 - |e.x| - |e.y|), n.xy = n.z < 0 ? (1 - |n.yx|) * sign(n.xy) : n.xy, normalize(n)
+struct Normal_Oct16
+{
+    static const GLuint location = 7;
+    static const GLint components = 2;
+    static const GLenum type = GL_BYTE;
+    static const GLboolean normalized = GL_TRUE;
+    static const bool integer = false;
+    static const size_t size = 2 * sizeof(int8_t);
+    static bool quantizesPosition() { return false; }
+    static const char* name() { return "Normal_Oct16"; }
+    static void encode(unsigned char* out, const VertexSource& source, const VertexBounds&)
+    {
+        glm::vec3 n = source.normal / (std::fabs(source.normal.x) + std::fabs(source.normal.y) + std::fabs(source.normal.z) + 1e-20f);
+        glm::vec2 e(n.x, n.y);
+        if (n.z < 0.0f)
+            e = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+        uint16_t packed = glm::packSnorm2x8(e);
+        std::memcpy(out, &packed, size);
+    }
+};
+
+// bytes before attribute index in a vertex of the given attributes
+template <typename... Attributes>
+constexpr size_t vertexAttributeOffset(size_t index)
+{
+    const size_t sizes[] = { Attributes::size..., 0 };
+    size_t bytes = 0;
+    for (size_t i = 0; i < index; i++)
+        bytes += sizes[i];
+    return bytes;
+}
+
+template <typename... Attributes>
+constexpr bool uniqueAttributeLocations()
+{
+    const GLuint locations[] = { Attributes::location... };
+    for (size_t i = 0; i < sizeof...(Attributes); i++)
+        for (size_t j = i + 1; j < sizeof...(Attributes); j++)
+            if (locations[i] == locations[j])
+                return false;
+    return true;
+}
+
+// A vertex format assembled from attribute formats at compile time: the packed vertex type, the offset of every
+// attribute and the attribute pointer setup all follow from the list, so none of it is written by hand.
+// The stride is rounded up to four bytes, which GL implementations want for attribute fetches.
+//   using Layout = VertexLayout<Pos_Snorm16x4, UV_Half2>;
+//   std::vector<Layout::Vertex> packed = packVertices<Layout>(mesh.vertices, bounds);
+//   glBufferData(...packed...); Layout::setAttributes();
+template <typename... Attributes>
+struct VertexLayout
+{
+    static constexpr size_t count = sizeof...(Attributes);
+    static constexpr size_t stride = (vertexAttributeOffset<Attributes...>(count) + 3) / 4 * 4;
+    static_assert(uniqueAttributeLocations<Attributes...>(), "two attributes of a vertex layout share a shader location");
+
+    // bytes before attribute index
+    static constexpr size_t offset(size_t index)
+    {
+        return vertexAttributeOffset<Attributes...>(index);
+    }
+
+    // one packed vertex
+    struct Vertex
+    {
+        unsigned char bytes[stride];
+    };
+    static_assert(sizeof(Vertex) == stride, "packed vertices must not be padded");
+
+    static Vertex encode(const VertexSource& source, const VertexBounds& bounds)
+    {
+        Vertex vertex;
+        std::memset(vertex.bytes, 0, stride);
+        encodeAttributes(vertex, source, bounds, std::index_sequence_for<Attributes...>());
+        return vertex;
+    }
+
+    // point the attributes at the bound GL_ARRAY_BUFFER, vertices starting at base, and enable them
+    static void setAttributes(GLintptr base = 0)
+    {
+        setAttributePointers(base, std::index_sequence_for<Attributes...>());
+    }
+
+    // whether positions need the MeshData bounds to be dequantized
+    static bool quantizesPosition()
+    {
+        return (Attributes::quantizesPosition() || ...);
+    }
+
+    // whether attribute index reads components values of type from location, e.g. to check that existing data fits
+    static bool attributeIs(size_t index, GLuint location, GLint components, GLenum type, GLboolean normalized)
+    {
+        return attributeIs(index, location, components, type, normalized, std::index_sequence_for<Attributes...>());
+    }
+
+    // e.g. "Pos_Snorm16x4 + UV_Half2"
+    static std::string name()
+    {
+        std::string result;
+        ((result += (result.empty() ? "" : " + ") + std::string(Attributes::name())), ...);
+        return result;
+    }
+
+private:
+    template <size_t... I>
+    static bool attributeIs(size_t index, GLuint location, GLint components, GLenum type, GLboolean normalized, std::index_sequence<I...>)
+    {
+        return ((I == index && Attributes::location == location && Attributes::components == components &&
+                 Attributes::type == type && Attributes::normalized == normalized) || ...);
+    }
+
+    template <size_t... I>
+    static void encodeAttributes(Vertex& vertex, const VertexSource& source, const VertexBounds& bounds, std::index_sequence<I...>)
+    {
+        (Attributes::encode(vertex.bytes + offset(I), source, bounds), ...);
+    }
+
+    template <typename Attribute>
+    static void setAttributePointer(GLintptr at)
+    {
+        if (Attribute::integer)
+            glVertexAttribIPointer(Attribute::location, Attribute::components, Attribute::type, (GLsizei)stride, (void*)at);
+        else
+            glVertexAttribPointer(Attribute::location, Attribute::components, Attribute::type, Attribute::normalized, (GLsizei)stride, (void*)at);
+        glEnableVertexAttribArray(Attribute::location);
+    }
+
+    template <size_t... I>
+    static void setAttributePointers(GLintptr base, std::index_sequence<I...>)
+    {
+        (setAttributePointer<Attributes>(base + (GLintptr)offset(I)), ...);
+    }
+};
+
+// encode vertices into a layout; normals (one per vertex) only matter for layouts with a normal attribute
+template <typename Layout>
+std::vector<typename Layout::Vertex> packVertices(const std::vector<MeshVertex>& vertices, const VertexBounds& bounds,
+                                                  const std::vector<glm::vec3>* normals = nullptr)
+{
+    std::vector<typename Layout::Vertex> packed(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        VertexSource source{ vertices[i].position, vertices[i].texCoord, normals ? (*normals)[i] : glm::vec3(0.0f, 0.0f, 1.0f) };
+        packed[i] = Layout::encode(source, bounds);
+    }
+    return packed;
+}
+#endif
@@ -0,0 +1,98 @@
+#include "texture_cache.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <dirent.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Offline cooker for the texture cache: decodes images once and writes them, with their full mip chain,
+// as .b3tx entries that the viewer maps and uploads without decoding.
+//
+//   texture_cooker [--cache DIR] [--no-flip] <image or directory>...
+//
+// Directories are scanned (not recursively) for .png, .jpg, .jpeg, .bmp and .tga files.
+
+static bool hasImageExtension(const std::string& name)
+{
+    static const char* extensions[] = { ".png", ".jpg", ".jpeg", ".bmp", ".tga" };
+    for (const char* extension : extensions)
+    {
+        size_t length = std::strlen(extension);
+        if (name.size() > length && name.compare(name.size() - length, length, extension) == 0)
+            return true;
+    }
+    return false;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string cacheDirectory = "texture_cache";
+    bool flip = true;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--cache" && i + 1 < argc)
+            cacheDirectory = argv[++i];
+        else if (arg == "--no-flip")
+            flip = false;
+        else if (!arg.empty() && arg[0] != '-')
+            inputs.push_back(arg);
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--cache DIR] [--no-flip] <image or directory>..." << std::endl;
+            return -1;
+        }
+    }
+    if (inputs.empty())
+    {
+        std::cout << "Usage: " << argv[0] << " [--cache DIR] [--no-flip] <image or directory>..." << std::endl;
+        return -1;
+    }
+
+    // expand directories, keeping the paths exactly as the viewer will ask for them (e.g. "textures/container.jpg")
+    std::vector<std::string> images;
+    for (const std::string& input : inputs)
+    {
+        DIR* directory = opendir(input.c_str());
+        if (!directory)
+        {
+            images.push_back(input);
+            continue;
+        }
+        std::string prefix = input.back() == '/' ? input : input + "/";
+        while (dirent* entry = readdir(directory))
+        {
+            if (hasImageExtension(entry->d_name))
+                images.push_back(prefix + entry->d_name);
+        }
+        closedir(directory);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int failed = 0;
+    stbi_set_flip_vertically_on_load(flip);
+    for (const std::string& image : images)
+    {
+        int width, height, channels;
+        unsigned char* pixels = stbi_load(image.c_str(), &width, &height, &channels, 0);
+        if (!pixels || !cookTexture(cacheDirectory, image, flip, pixels, width, height, channels))
+        {
+            std::cout << "Failed to cook " << image << std::endl;
+            failed++;
+        }
+        else
+        {
+            std::cout << image << " -> " << cookedTexturePath(cacheDirectory, image, flip)
+                      << " (" << width << "x" << height << ", " << channels << " channels)" << std::endl;
+        }
+        stbi_image_free(pixels);
+    }
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "cooked " << images.size() - failed << " of " << images.size() << " textures in " << elapsed << " ms" << std::endl;
+    return failed == 0 ? 0 : 1;
+}